@@ -0,0 +1,107 @@
+#ifndef PA3ANALYTICPLACEMENT_BINGRID_HPP
+#define PA3ANALYTICPLACEMENT_BINGRID_HPP
+
+#include <utility>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Uniform grid of binsX x binsY equally sized bins covering the chip, [0, width] x [0, height].
+     * Bin (column, row) has index row * binsX + column, so the bins of a row are consecutive.
+     *
+     * The bin of a point is computed arithmetically and assignCells buckets the cells with a counting sort,
+     * so binning is linear in the number of cells whatever the resolution of the grid.
+     */
+    class BinGrid
+    {
+    public:
+        BinGrid(int binsX = 5, int binsY = 5);
+
+        /**
+         * Changes the number of bins in each direction. Clears the cells assigned to the bins.
+         */
+        void setResolution(int binsX, int binsY);
+
+        /**
+         * Sets the chip area covered by the grid. Clears the cells assigned to the bins.
+         */
+        void setChipDimensions(double width, double height);
+
+        int getBinsX() const { return this->binsX; }
+        int getBinsY() const { return this->binsY; }
+        int getBinCount() const { return this->binsX * this->binsY; }
+
+        double getBinWidth() const { return this->binWidth; }
+        double getBinHeight() const { return this->binHeight; }
+        double getBinArea() const { return this->binWidth * this->binHeight; }
+
+        double getLowerX(int column) const { return column * this->binWidth; }
+        double getUpperX(int column) const { return column == this->binsX - 1 ? this->width : (column + 1) * this->binWidth; }
+        double getLowerY(int row) const { return row * this->binHeight; }
+        double getUpperY(int row) const { return row == this->binsY - 1 ? this->height : (row + 1) * this->binHeight; }
+
+        /**
+         * Column or row of a coordinate. Coordinates outside the chip map to the nearest column or row.
+         */
+        int getColumn(double x) const;
+        int getRow(double y) const;
+
+        int getBinIndex(double x, double y) const { return this->getRow(y) * this->binsX + this->getColumn(x); }
+
+        /**
+         * Buckets the cells [0, count) by the bin their location falls in, replacing the previous assignment.
+         * @param sizes Area of every cell, added to the cell area of its bin
+         */
+        void assignCells(const std::vector<std::pair<double, double>> &locations, int count, const int *sizes);
+
+        /**
+         * The cells of a bin, in increasing order, are [getCellsBegin(bin), getCellsEnd(bin))
+         */
+        const int* getCellsBegin(int bin) const { return this->binCells.data() + this->binStart[bin]; }
+        const int* getCellsEnd(int bin) const { return this->binCells.data() + this->binStart[bin + 1]; }
+        int getCellCount(int bin) const { return this->binStart[bin + 1] - this->binStart[bin]; }
+
+        /**
+         * Bin index of every assigned cell, indexed by cell
+         */
+        const int* getCellBins() const { return this->cellBin.data(); }
+
+        /**
+         * Total area of the cells in a bin
+         */
+        double getCellArea(int bin) const { return this->binCellArea[bin]; }
+
+        /**
+         * Total area of all assigned cells
+         */
+        double getTotalCellArea() const { return this->totalCellArea; }
+
+        /**
+         * Cell area of a bin divided by the bin area
+         */
+        double getUtilization(int bin) const { return this->binCellArea[bin] / this->getBinArea(); }
+
+    private:
+        int binsX;
+        int binsY;
+
+        double width = 0;
+        double height = 0;
+        double binWidth = 0;
+        double binHeight = 0;
+
+        // Cells of bin b are binCells[binStart[b]] to binCells[binStart[b + 1] - 1]
+        std::vector<int> binStart;
+        std::vector<int> binCells;
+        std::vector<double> binCellArea;
+        double totalCellArea = 0;
+
+        // Bin of every assigned cell
+        std::vector<int> cellBin;
+
+        void clearCells();
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_BINGRID_HPP
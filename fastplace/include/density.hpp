@@ -0,0 +1,181 @@
+#ifndef PA3ANALYTICPLACEMENT_DENSITY_HPP
+#define PA3ANALYTICPLACEMENT_DENSITY_HPP
+
+#include "threadpool.hpp"
+
+#include <complex>
+#include <functional>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Real to real transforms of length n (a power of two) through a complex FFT of length 2n:
+     *  - dct:        X[u] = sum_j x[j] cos(pi u (2j + 1) / 2n)
+     *  - cosineSum:  y[j] = sum_u b[u] cos(pi u (2j + 1) / 2n)
+     *  - sineSum:    y[j] = sum_u b[u] sin(pi u (2j + 1) / 2n)
+     *
+     * None of them are normalized. The transform itself holds no work memory, so one object can
+     * be used by several threads as long as each passes its own scratch buffer.
+     */
+    class CosineTransform
+    {
+    public:
+        explicit CosineTransform(int length = 1);
+
+        int getLength() const { return this->length; }
+
+        /**
+         * Scratch buffer size required by the transforms, in complex numbers
+         */
+        int getScratchSize() const { return 2 * this->length; }
+
+        void dct(const double *x, double *X, std::complex<double> *scratch) const;
+        void cosineSum(const double *b, double *y, std::complex<double> *scratch) const;
+        void sineSum(const double *b, double *y, std::complex<double> *scratch) const;
+
+    private:
+        int length;
+
+        // Bit reversal permutation and twiddle factors exp(-2 pi i k / 2n) of the 2n point FFT
+        std::vector<int> bitReverse;
+        std::vector<std::complex<double>> twiddles;
+        // exp(-i pi u / 2n), u in [0, n)
+        std::vector<std::complex<double>> halfShift;
+
+        /**
+         * In place FFT of length 2n, with exp(-2 pi i jk / 2n) if inverse is false and exp(+2 pi i jk / 2n) otherwise
+         */
+        void fft(std::complex<double> *data, bool inverse) const;
+
+        void sums(const double *b, std::complex<double> *scratch) const;
+    };
+
+    /**
+     * Electrostatic model of the cell density (as in ePlace): every cell is a positive charge equal to its area,
+     * the density of the grid bins is a charge distribution and the potential follows from the Poisson equation
+     * laplacian(psi) = -rho with zero gradient on the chip boundary. The field E = -grad(psi) points from dense
+     * regions to sparse ones, so moving cells along it spreads them.
+     *
+     * The equation is solved spectrally with cosine transforms, so an update costs O(B log B) for B bins
+     * plus one linear pass over the cells to rasterize them.
+     *
+     * Cells are rasterized by area weighting (cloud in cell): the area of a cell is split over the four bins
+     * whose centers surround it, and the field at a cell is interpolated from the same four bins.
+     *
+     * With a target density above the average density, the free space of every bin is filled up to the target,
+     * as ePlace does with filler cells: the charge of a bin is the larger of its cell density and the target density.
+     * Cells then only push each other apart where a bin is fuller than the target, instead of spreading over the whole chip.
+     */
+    class ElectrostaticDensity
+    {
+    public:
+        /**
+         * @param binsX Number of bins in X, rounded up to a power of two
+         * @param binsY Number of bins in Y, rounded up to a power of two
+         * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+         */
+        ElectrostaticDensity(int binsX, int binsY, ThreadPool *threadPool = nullptr);
+
+        /**
+         * Sets the chip area covered by the grid, [0, width] x [0, height]
+         */
+        void setChipDimensions(double width, double height);
+
+        /**
+         * Sets the density (cell area over bin area) the bins may be filled to, 0 for none. Charge and overflow use it from
+         * the next update. Designs whose cells fill more than this of the chip are measured against their average density.
+         */
+        void setTargetDensity(double targetDensity);
+
+        int getBinsX() const { return this->binsX; }
+        int getBinsY() const { return this->binsY; }
+        double getBinWidth() const { return this->binWidth; }
+        double getBinHeight() const { return this->binHeight; }
+
+        /**
+         * Rasterizes the cells [0, count) and solves for the potential and field.
+         * @param sizes Area of every cell
+         * @return The electrostatic energy, 1/2 sum of rho * psi over the chip. 0 when the density is uniform
+         */
+        double update(const double *x, const double *y, const int *sizes, long count);
+
+        /**
+         * Force on each cell from the last update, its area times the field at its location
+         */
+        void calculateForces(const double *x, const double *y, const int *sizes, long count, double *forceX, double *forceY) const;
+
+        /**
+         * Largest magnitude of the field over the bins, from the last update
+         */
+        double getMaximumField() const;
+
+        /**
+         * Cell area above the target density of each bin divided by the total cell area, from the last update. Measured
+         * against the average density when that is higher, so 0 when the cells are spread evenly over the chip.
+         */
+        double getOverflow() const;
+
+    private:
+        int binsX;
+        int binsY;
+        double width = 0;
+        double height = 0;
+        double binWidth = 0;
+        double binHeight = 0;
+        double targetDensity = 0;
+
+        ThreadPool *threadPool;
+
+        CosineTransform transformX;
+        CosineTransform transformY;
+
+        // Grids of binsY rows of binsX bins, bin (column, row) at row * binsX + column. density is the cell density only
+        std::vector<double> density;
+        std::vector<double> coefficients;
+        std::vector<double> potential;
+        std::vector<double> fieldX;
+        std::vector<double> fieldY;
+        // Rasterized area of every thread, summed in thread order so results do not depend on timing
+        std::vector<std::vector<double>> threadArea;
+        // Density the free space of the bins was filled up to in the last update, 0 when the cells fill more than the target
+        double fillDensity = 0;
+
+        /**
+         * Bins around a coordinate and their weights
+         */
+        struct Stencil
+        {
+            int lower;
+            int upper;
+            double upperWeight;
+        };
+
+        static Stencil stencil(double coordinate, double binSize, int bins);
+
+        /**
+         * Runs function(begin, end) over [0, count), on the thread pool if there is one
+         */
+        void parallelFor(long count, const std::function<void(long, long)> &function) const;
+
+        enum class Transform
+        {
+            DCT,
+            COSINE_SUM,
+            SINE_SUM
+        };
+
+        /**
+         * Applies a transform along X (every row) or Y (every column) of a grid, in place
+         */
+        void transformRows(std::vector<double> &grid, Transform transform) const;
+        void transformColumns(std::vector<double> &grid, Transform transform) const;
+
+        /**
+         * grid = inverse transform of coefficients scaled per frequency by scale(u, v)
+         */
+        void synthesize(std::vector<double> &grid, Transform alongX, Transform alongY, const std::function<double(int, int)> &scale) const;
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_DENSITY_HPP
@@ -0,0 +1,132 @@
+#ifndef PA3ANALYTICPLACEMENT_DETAILED_HPP
+#define PA3ANALYTICPLACEMENT_DETAILED_HPP
+
+#include "hypergraph.hpp"
+#include "threadpool.hpp"
+#include "wirelength.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Information about a finished detailed placement
+     */
+    struct DetailedPlacementStatistics
+    {
+        double initialHPWL = 0;
+        double finalHPWL = 0;
+        // Accepted moves of every kind
+        long swaps = 0;
+        long matchedCells = 0;
+        long reorders = 0;
+    };
+
+    /**
+     * Detailed placement of a legal row placement, improving the half perimeter wirelength with
+     *  - global swap: moving a cell to its optimal region by swapping it with a cell of the same width there
+     *  - independent set matching: reassigning the positions of up to 8 same width cells that share no nets
+     *    (a linear assignment problem, solved exactly)
+     *  - local reordering: the best order of every 3 adjacent cells of a row
+     * Every move keeps the placement legal. Moves are evaluated by recomputing only the nets of the moved cells.
+     *
+     * The chip is cut into square windows that are processed in parallel. Cells only move inside their window, and
+     * a window sees the cells of other windows where they were at the start of the pass, so concurrent windows never
+     * read what another one writes and the result does not depend on the thread count. Every other pass shifts the
+     * windows by half their size so cells near a window boundary can move across it.
+     */
+    class DetailedPlacer
+    {
+    public:
+        /**
+         * @param pinLocations Locations of the I/O pads, pad p is cell numCellsNoPads + p
+         * @param cellWidths Width of every cell in sites
+         * @param wirelengthEvaluator Measures the HPWL before and after detailed placement. Not owned.
+         * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+         */
+        DetailedPlacer(int numCellsNoPads, int numHyperedges, const int *cellPinArray, const int *hEdgesToFirstMemberCellArray,
+                       const int *hEdgeWeights, const SPinLocation *pinLocations, const int *cellWidths, WirelengthEvaluator &wirelengthEvaluator,
+                       ThreadPool *threadPool = nullptr);
+
+        /**
+         * Improves a legal placement in place.
+         * @param x Cell center X coordinates (numCellsNoPads)
+         * @param y Cell center Y coordinates, at row centers
+         * @param passes Number of passes, each running all three kinds of moves over all windows
+         */
+        DetailedPlacementStatistics place(double *x, double *y, double rowHeight, int passes);
+
+    private:
+        int numCellsNoPads;
+        int numHyperedges;
+        const int *cellPinArray;
+        const int *hEdgesToFirstMemberCellArray;
+        const int *hEdgeWeights;
+        const SPinLocation *pinLocations;
+        const int *cellWidths;
+        WirelengthEvaluator *wirelengthEvaluator;
+        ThreadPool *threadPool;
+
+        // Nets of cell i are cellNets[cellNetStart[i]] to cellNets[cellNetStart[i + 1] - 1]
+        std::vector<int> cellNetStart;
+        std::vector<int> cellNets;
+
+        // Current placement and row height while place runs
+        double *x = nullptr;
+        double *y = nullptr;
+        double rowHeight = 1;
+
+        // Placement at the start of the current pass and the window of every cell in it
+        std::vector<double> passX;
+        std::vector<double> passY;
+        std::vector<int> cellWindow;
+
+        /**
+         * Cells of one window, sorted by row and then by x. Rows are contiguous ranges of cells.
+         */
+        struct Window
+        {
+            int index = 0;
+            std::vector<int> cells;
+            // Row of the first range and the start of every row range, one more entry than there are rows
+            int firstRow = 0;
+            std::vector<int> rowStart;
+        };
+
+        struct MoveCounts
+        {
+            long swaps = 0;
+            long matchedCells = 0;
+            long reorders = 0;
+        };
+
+        void parallelFor(long count, const std::function<void(long, long)> &function) const;
+
+        int getRow(double y) const;
+
+        /**
+         * Location of a cell or pad as seen from a window
+         */
+        void getPinLocation(int cell, int window, double &pinX, double &pinY) const;
+        double getNetHPWL(int net, int window) const;
+
+        /**
+         * HPWL of the union of the nets of the given cells, as seen from their window. nets is scratch space.
+         */
+        double getCellsHPWL(const int *cells, int count, int window, std::vector<int> &nets) const;
+
+        /**
+         * Builds the windows of one pass, windowSize x windowSize with the grid shifted by offset
+         */
+        void buildWindows(double windowSize, double offset, std::vector<Window> &windows);
+
+        void sortWindow(Window &window) const;
+
+        long globalSwap(Window &window);
+        long independentSetMatching(Window &window);
+        long localReordering(Window &window);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_DETAILED_HPP
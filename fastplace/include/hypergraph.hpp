@@ -0,0 +1,55 @@
+#ifndef PA3ANALYTICPLACEMENT_HYPERGRAPH_HPP
+#define PA3ANALYTICPLACEMENT_HYPERGRAPH_HPP
+
+#include "nametable.hpp"
+
+#include <vector>
+
+struct SPinLocation {
+	int x, y;
+};
+
+namespace PA3Placement
+{
+    /**
+     * A placement problem: the netlist as a hypergraph of movable cells and I/O pads, the cell sizes and the
+     * fixed pad locations. Filled by parseIbmFile, or built directly in memory (see sfqplace's Netlist).
+     *
+     * Cells are numbered 0 to numCells_noPads - 1, followed by the I/O pads. Every placer only reads the
+     * hypergraph, so any number of placements can run on their own hypergraphs at the same time.
+     */
+    struct Hypergraph
+    {
+        // Number of all terminals connected to the end points of (hyper) edges
+        int numCellPins = 0;
+        // Number of edges and hyperedges
+        int numhyper = 0;
+        // Total number of movable cells (generally with names starting with a) and I/O pads (generally starting with p)
+        int numCellsAndPads = 0;
+        // Total number of movable cells
+        int numCells_noPads = 0;
+
+        // Cells used as endpoints of (hyper) edges, numCellPins entries
+        std::vector<int> cellPinArray;
+
+        // (Hyper)edge i has the pins cellPinArray[hEdge_idxToFirstEntryInPinArray[i]] up to (not including)
+        // cellPinArray[hEdge_idxToFirstEntryInPinArray[i + 1]]. numhyper + 1 entries, the last one is numCellPins
+        std::vector<int> hEdge_idxToFirstEntryInPinArray;
+
+        // (Hyper) edge weights, numhyper entries
+        std::vector<int> hyperwts;
+        // Cell and I/O pad sizes, numCellsAndPads entries
+        std::vector<int> vertexSize;
+
+        // Locations of the I/O pads, numCellsAndPads - numCells_noPads entries.
+        // pinLocations[p] is the location of pad p, which is cell numCells_noPads + p
+        std::vector<SPinLocation> pinLocations;
+
+        // Cell and I/O pad name --> cell number, only filled by parseIbmFile
+        NameTable nodeNameToNodeNum_map;
+
+        int getPadCount() const { return this->numCellsAndPads - this->numCells_noPads; }
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_HYPERGRAPH_HPP
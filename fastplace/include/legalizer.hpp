@@ -0,0 +1,119 @@
+#ifndef PA3ANALYTICPLACEMENT_LEGALIZER_HPP
+#define PA3ANALYTICPLACEMENT_LEGALIZER_HPP
+
+#include <string>
+#include <vector>
+
+namespace PA3Placement
+{
+    enum class LegalizationMode
+    {
+        NONE,
+        // Greedy: every cell goes to the end of the row where it moves the least
+        TETRIS,
+        // Abacus: cells in a row form clusters placed at the optimal position of their members
+        ABACUS
+    };
+
+    /**
+     * Parses a legalization mode name as given on the command line ("none", "tetris" or "abacus").
+     * @return true if the name was recognized, in which case mode is set
+     */
+    bool parseLegalizationMode(const std::string &name, LegalizationMode &mode);
+
+    /**
+     * Information about a finished legalization
+     */
+    struct LegalizationStatistics
+    {
+        int rows = 0;
+        // Width of every row, larger than the chip width when the cells did not fit
+        double rowWidth = 0;
+        // Manhattan distance between the input and legal cell centers
+        double totalDisplacement = 0;
+        double maximumDisplacement = 0;
+        // Cells that had to be placed past the end of a row (Tetris only)
+        long cellsOutsideRows = 0;
+    };
+
+    /**
+     * Row based legalization: cells are one row high and a whole number of sites wide, and are placed in
+     * non-overlapping positions aligned to the sites of rows that cover the chip from y = 0 up.
+     *
+     * Cells are processed in order of their x coordinate. Each one tries the rows nearest to it first, and
+     * the search stops once the vertical distance alone exceeds the best cost found, so every cell only looks
+     * at a few rows and legalization takes about O(n log n) for n cells.
+     *
+     * Coordinates are cell centers, both for the input and the legal placement.
+     */
+    class Legalizer
+    {
+    public:
+        /**
+         * @param width Chip width, the rows are widened if the cells do not fit
+         * @param height Chip height, covered by as many rows as fit
+         */
+        Legalizer(double width, double height, double rowHeight = 1.0, double siteWidth = 1.0);
+
+        /**
+         * @param widths Width of every cell in sites
+         * @param legalX Receives the legal X coordinate of every cell
+         * @param legalY Receives the legal Y coordinate of every cell
+         */
+        LegalizationStatistics legalize(LegalizationMode mode, const double *x, const double *y, const int *widths, long count,
+                                        double *legalX, double *legalY);
+
+    private:
+        double width;
+        double height;
+        double rowHeight;
+        double siteWidth;
+
+        int rowCount;
+        double rowWidth;
+
+        /**
+         * Group of adjacent cells in a row (Abacus), placed where the weighted squared displacement of its cells
+         * is smallest: x = q / e, with the first cell at x
+         */
+        struct Cluster
+        {
+            double x;
+            // Total weight of the cells
+            double e;
+            // Sum of weight * (desired x - offset of the cell in the cluster)
+            double q;
+            double w;
+            // Index of its first cell in the row
+            int firstCell;
+        };
+
+        struct Row
+        {
+            std::vector<int> cells;
+            std::vector<Cluster> clusters;
+            // Width of the cells already in the row, or the end of the last cell with Tetris
+            double used = 0;
+        };
+
+        std::vector<Row> rows;
+
+        double getRowCenter(int row) const { return (row + 0.5) * this->rowHeight; }
+        int getNearestRow(double y) const;
+        double snapToSite(double x) const;
+        double clampClusterPosition(double x, double w) const;
+
+        /**
+         * Left edge the cell would get if added to the end of the row by Abacus, without changing the row
+         */
+        double tryAbacus(const Row &row, double desiredX, double w, double e) const;
+        void addAbacus(Row &row, int cell, double desiredX, double w, double e);
+
+        void legalizeTetris(const std::vector<long> &order, const double *x, const double *y, const int *widths,
+                            double *legalX, double *legalY, LegalizationStatistics &statistics);
+        void legalizeAbacus(const std::vector<long> &order, const double *x, const double *y, const int *widths,
+                            double *legalX, double *legalY);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_LEGALIZER_HPP
@@ -0,0 +1,77 @@
+#ifndef PA3ANALYTICPLACEMENT_MAPPEDFILE_HPP
+#define PA3ANALYTICPLACEMENT_MAPPEDFILE_HPP
+
+#include <cstddef>
+
+namespace PA3Placement
+{
+    /**
+     * A whole file mapped read only into memory, so it can be parsed in place without copying it into buffers.
+     * The contents are not null terminated, use getEnd() as the bound.
+     */
+    class MappedFile
+    {
+    public:
+        /**
+         * Maps the file, check isOpen() for success
+         */
+        explicit MappedFile(const char *fileName);
+        ~MappedFile();
+
+        MappedFile(const MappedFile &other) = delete;
+        MappedFile& operator=(const MappedFile &rhs) = delete;
+
+        bool isOpen() const { return this->fileDescriptor >= 0; }
+
+        const char* getData() const { return this->data; }
+        const char* getEnd() const { return this->data + this->size; }
+        size_t getSize() const { return this->size; }
+
+    private:
+        int fileDescriptor;
+        const char *data;
+        size_t size;
+    };
+
+    /**
+     * Whitespace separated tokens of a text buffer, read in place
+     */
+    class TextCursor
+    {
+    public:
+        TextCursor(const char *begin, const char *end) : position(begin), end(end) {}
+
+        explicit TextCursor(const MappedFile &file) : TextCursor(file.getData(), file.getEnd()) {}
+
+        /**
+         * Reads the next token, skipping any whitespace (including line breaks) before it
+         * @return false at the end of the buffer
+         */
+        bool nextToken(const char *&token, size_t &length);
+
+        /**
+         * Reads the next token as a decimal integer
+         * @return false at the end of the buffer or if the token is not an integer
+         */
+        bool nextInt(int &value);
+
+        /**
+         * Reads the next token if it is on the current line
+         * @return false if the line (or buffer) ends first
+         */
+        bool nextTokenOnLine(const char *&token, size_t &length);
+
+        /**
+         * Moves past the next line break
+         */
+        void skipLine();
+
+        bool atEnd() const { return this->position >= this->end; }
+
+    private:
+        const char *position;
+        const char *end;
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_MAPPEDFILE_HPP
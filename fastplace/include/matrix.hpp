@@ -6,7 +6,8 @@
 #define PA3ANALYTICPLACEMENT_MATRIX_HPP
 
 #include "util.hpp"
-#include "suraj_parser.h"
+#include "hypergraph.hpp"
+#include "threadpool.hpp"
 
 #include <vector>
 #include <set>
@@ -23,6 +24,7 @@ namespace PA3Placement
     class Matrix
     {
     public:
+        virtual ~Matrix() = default;
 
         /**
          * Adds a new row to the matrix keeping the same width
@@ -114,6 +116,14 @@ namespace PA3Placement
         ColumnMatrix<T> operator+(const ColumnMatrix<T> &rhs) const;
         ColumnMatrix<T> operator-(const ColumnMatrix<T> &rhs) const;
 
+        /**
+         * Get a pointer to the contiguous storage of this column,
+         * for use by solver kernels that want to bypass get/set.
+         * @return Pointer to the first element, valid until the column is resized.
+         */
+        T* getData();
+        const T* getData() const;
+
         // Implemented the following from Matrix
         virtual void addRow();
         virtual void display(std::ostream &out) const;
@@ -169,6 +179,166 @@ namespace PA3Placement
         virtual long getWidth() const;
     };
 
+    /**
+     * One (row, column, value) entry of a sparse matrix that is being assembled.
+     */
+    template <typename T>
+    struct MatrixTriplet
+    {
+        int row;
+        int column;
+        T value;
+    };
+
+    /**
+     * Square, symmetric sparse matrix stored in compressed sparse row (CSR) format.
+     *
+     * Only the upper triangle (including the diagonal) is stored, so memory usage is
+     * O(number of non-zeros) instead of O(n^2). The entries of row i live at the indices
+     * [rowStart[i], rowStart[i + 1]) of columnIndices and values. The first entry of each
+     * row is always the diagonal element, followed by the off-diagonal entries in
+     * increasing column order.
+     *
+     * @tparam T Type of values held in this matrix (usually double)
+     */
+    template <typename T>
+    class SymmetricSparseMatrix : public Matrix<T>
+    {
+    private:
+        long size;
+
+        std::vector<long> rowStart;
+        std::vector<int> columnIndices;
+        std::vector<T> values;
+
+        /**
+         * Optional mirror of the strictly upper triangle in column order (i.e. the strictly lower
+         * triangle in CSR form), see buildTransposeIndex. Empty when not built.
+         */
+        std::vector<long> lowerRowStart;
+        std::vector<int> lowerColumnIndices;
+        std::vector<T> lowerValues;
+
+        /**
+         * Finds the storage index of an element in the upper triangle.
+         * @return The index into columnIndices/values, or -1 if the element is not stored.
+         */
+        long findEntry(long row, long column) const;
+    public:
+        SymmetricSparseMatrix(long size);
+
+        /**
+         * Reserve storage for the given number of stored (upper triangle) entries.
+         */
+        void reserve(long nonZeros);
+
+        /**
+         * Discards all entries and rows, leaving an empty 0x0 matrix.
+         */
+        void clear();
+
+        /**
+         * Begins the next row of the matrix with the given diagonal value.
+         * Rows must be started in order, and the matrix grows by one row/column each call.
+         */
+        void startRow(T diagonal);
+
+        /**
+         * Appends an off-diagonal entry to the row most recently started with startRow.
+         * Columns must be strictly larger than the row number and given in increasing order.
+         */
+        void appendToRow(int column, T value);
+
+        /**
+         * Replaces the contents of the matrix with diagonal.size() rows built from the given diagonal
+         * and off-diagonal triplets. Triplets must be in the upper triangle (row < column) and may
+         * repeat, repeated entries are summed in the order they appear in the list.
+         *
+         * The triplets are given as several lists that are treated as one list concatenated in order,
+         * so per-thread buffers can be assembled without copying them together first.
+         *
+         * Sorting is done with two stable counting sort passes (by column, then by row), so
+         * assembly is linear in the number of triplets plus rows.
+         */
+        void assembleFromTriplets(const std::vector<T> &diagonal, const std::vector<std::vector<MatrixTriplet<T>>> &tripletLists);
+
+        /**
+         * Computes y = this * x, where x and y are dense vectors of getHeight() elements.
+         * y is overwritten.
+         */
+        void multiply(const T *x, T *y) const;
+
+        /**
+         * Computes y = this * x like multiply, and also returns the dot product of x and y
+         * computed in the same pass over the matrix.
+         */
+        T multiplyAndDot(const T *x, T *y) const;
+
+        /**
+         * Computes y1 = this * x1 and y2 = this * x2 in a single pass over the matrix (a sparse
+         * matrix product with two columns), along with dots[0] = x1 . y1 and dots[1] = x2 . y2.
+         */
+        void multiplyPairAndDot(const T *x1, const T *x2, T *y1, T *y2, T *dots) const;
+
+        /**
+         * Builds the lower triangle mirror needed by the row range products below.
+         * Adds O(nnz) memory. Modifying the structure of the matrix afterwards (startRow, set on an
+         * entry that is not stored yet, ...) discards it again.
+         */
+        void buildTransposeIndex();
+        bool hasTransposeIndex() const { return !this->lowerRowStart.empty(); }
+
+        /**
+         * Computes only the rows [begin, end) of y = this * x, and returns the dot product of x and y
+         * over those rows. Unlike multiply, each row only writes its own element of y, so different
+         * row ranges can be computed concurrently. Requires buildTransposeIndex.
+         */
+        T multiplyRowsAndDot(const T *x, T *y, long begin, long end) const;
+
+        /**
+         * Two column version of multiplyRowsAndDot, see multiplyPairAndDot.
+         * dots receives the two partial dot products over the row range.
+         */
+        void multiplyPairRowsAndDot(const T *x1, const T *x2, T *y1, T *y2, long begin, long end, T *dots) const;
+
+        /**
+         * Splits the rows into contiguous ranges with roughly the same number of non-zeros each
+         * (counting both triangles if the transpose index is built).
+         * @return parts + 1 row boundaries, range i is [result[i], result[i + 1])
+         */
+        std::vector<long> partitionRows(int parts) const;
+
+        ColumnMatrix<T> operator*(const ColumnMatrix<T> &rhs) const;
+
+        long getNonZeroCount() const { return static_cast<long>(values.size()); }
+        T getDiagonal(long row) const { return values[rowStart[row]]; }
+        // The diagonal is not part of the transpose index, so it can be changed at any time
+        void setDiagonal(long row, T value) { values[rowStart[row]] = value; }
+
+        const std::vector<long>& getRowStart() const { return rowStart; }
+        const std::vector<int>& getColumnIndices() const { return columnIndices; }
+        const std::vector<T>& getValues() const { return values; }
+
+        // Implemented the following from Matrix
+        virtual void addRow();
+        virtual void display(std::ostream &out) const;
+        /**
+         * Sets an element (and its mirror across the diagonal).
+         * Setting an element that is not already stored is O(nnz), build the matrix
+         * with startRow/appendToRow instead when possible.
+         */
+        virtual void set(long x, long y, T value);
+        virtual T get(long x, long y) const;
+        virtual long getHeight() const;
+        virtual long getWidth() const;
+    };
+
+    // Specialized to use the SIMD kernels from vectorkernels.hpp
+    template <>
+    double SymmetricSparseMatrix<double>::multiplyRowsAndDot(const double *x, double *y, long begin, long end) const;
+    template <>
+    void SymmetricSparseMatrix<double>::multiplyPairRowsAndDot(const double *x1, const double *x2, double *y1, double *y2, long begin, long end, double *dots) const;
+
     template <typename T>
     std::ostream& operator<<(std::ostream &out, const Matrix<T> &mat)
     {
@@ -176,33 +346,110 @@ namespace PA3Placement
         return out;
     }
 
-    class QMatrix : public Matrix2D<double>
+    class QMatrix : public SymmetricSparseMatrix<double>
     {
     public:
-        typedef std::vector<std::set<std::pair<int, double>, firstElementOfPairComparator>> WeightedCellConnectionsList;
+        /**
+         * Weighted connection between a movable node (cell or star node) and an I/O pad.
+         * I/O pads are not rows of the matrix, they only add to the diagonal and to Dx/Dy.
+         */
+        struct PadConnection
+        {
+            // Matrix row of the cell or star node
+            int node;
+            // Index of the pad into pinLocations (pad cell number - numCellsNoPads)
+            int pad;
+            double weight;
+        };
 
-        QMatrix(int numCellsNoPads, int numCellsAndPads, int numHyperedges, int *cellPinArray, int *hEdgesToFirstMemberCellArray, int *hEdgeWeights);
+        /**
+         * @param threadPool If not nullptr, the hyperedges are split over these threads. The matrix is
+         *                   the same for any number of threads.
+         */
+        QMatrix(int numCellsNoPads, int numCellsAndPads, int numHyperedges, const int *cellPinArray, const int *hEdgesToFirstMemberCellArray, const int *hEdgeWeights,
+                ThreadPool *threadPool = nullptr);
 
         int getStarNodeCount() const;
-        WeightedCellConnectionsList* getCellConnectionsList();
+
+        /**
+         * True if a hyperedge of the given degree is modeled with a star node, which is then connected to every
+         * pin with the same weight. Star nodes are numbered in the order of their hyperedges.
+         */
+        static bool isStarHyperedge(int degree);
+
+        /**
+         * All pad connections, sorted by node then pad, with one entry per (node, pad) pair.
+         */
+        const std::vector<PadConnection>& getPadConnections() const;
+
+        /**
+         * Sets the weights of anchor pseudo-nets, which connect each node to a fixed point (like an I/O pad).
+         * They only add to the diagonal, weights of a previous call are replaced.
+         * Anything set up from the matrix values (e.g. a preconditioner) has to be set up again afterwards.
+         * @param weights One weight per row
+         */
+        void setAnchorWeights(const std::vector<double> &weights);
+
+        /**
+         * Sum of the weights of all connections of a row (to other nodes and to I/O pads), without anchor weights
+         */
+        double getConnectionWeight(long row) const;
     private:
         int numCellsNoPads;
         int numCellsAndPads;
         int numHyperedges;
 
-        int *cellPinArray;
-        int *hEdgesToFirstMemberCellArray;
-        int *hEdgeWeights;
+        const int *cellPinArray;
+        const int *hEdgesToFirstMemberCellArray;
+        const int *hEdgeWeights;
 
         int numStars = 0;
 
-        WeightedCellConnectionsList cellConnectionsList;
+        std::vector<PadConnection> padConnections;
+
+        // Diagonal without anchor weights, saved by the first setAnchorWeights call
+        std::vector<double> baseDiagonal;
+
+        /**
+         * Connections found while processing a contiguous range of hyperedges, one buffer per thread.
+         * Buffers are only kept until the matrix is assembled.
+         */
+        struct ConnectionBuffer
+        {
+            // Connections between movable nodes, as (smaller node, larger node, -weight)
+            std::vector<MatrixTriplet<double>> triplets;
+            std::vector<PadConnection> padConnections;
+
+            int numStars = 0;
+        };
 
-        void calculateNumberOfStarNodes();
-        void generate();
-        void populateDiagonal();
-        void processCliqueHyperedge(int degree, double weight, int currentCellIndex, int firstCellInHEdgeIndex);
-        void processStarHyperedge(int degree, double weight, int currentCellIndex, int currentStar);
+        /**
+         * Counts the star nodes needed for the hyperedges [firstHyperedge, lastHyperedge)
+         * and reserves room in the buffer for their connections.
+         */
+        void calculateNumberOfStarNodes(int firstHyperedge, int lastHyperedge, ConnectionBuffer &buffer) const;
+        void generate(ThreadPool *threadPool);
+
+        /**
+         * Records the connections of the hyperedges [firstHyperedge, lastHyperedge),
+         * numbering their star nodes from firstStar on.
+         */
+        void processHyperedges(int firstHyperedge, int lastHyperedge, int firstStar, ConnectionBuffer &buffer) const;
+
+        /**
+         * Records a weighted connection between two cells/I/O pads given by their cell numbers
+         * (as in cellPinArray). Connections between two pads are dropped, they do not affect the placement.
+         */
+        void addConnection(int cell, int otherCell, double weight, ConnectionBuffer &buffer) const;
+
+        /**
+         * Builds the sparse Q matrix from the connection buffers, and merges repeated pad connections.
+         * Off-diagonal entries are the negated connection weights between movable cells/star nodes,
+         * diagonal entries are the sum of all connection weights of a cell (including I/O pads).
+         */
+        void assembleSparseMatrix(std::vector<ConnectionBuffer> &buffers);
+        void processCliqueHyperedge(int degree, double weight, int currentCellIndex, int firstCellInHEdgeIndex, ConnectionBuffer &buffer) const;
+        void processStarHyperedge(int degree, double weight, int currentCellIndex, int currentStar, ConnectionBuffer &buffer) const;
     };
 
     class DMatrix : public ColumnMatrix<double>
@@ -219,52 +466,36 @@ namespace PA3Placement
          *
          * The dimension (either X or Y) is denoted by the dimension parameter
          */
-        DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars, QMatrix::WeightedCellConnectionsList *cellConnectionsList);
+        DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars, const std::vector<QMatrix::PadConnection> &padConnections);
 
         /**
-         * Get the X/Y location of an I/O pad provided it's number, but
-         * it's number with the offset due to added star nodes.
-         *
-         * This is used due to numbers from the cellConnectionsList.
-         * @param ioPadNumberWithOffset
+         * Get the X/Y location of an I/O pad provided its index, as stored in QMatrix::PadConnection.
+         * @param ioPadIndex
          * @return
          */
-        const SPinLocation* getIOPadLocation(int ioPadNumberWithOffset) const;
-    private:
-        Dimension dimension;
-        const SPinLocation *pinLocations;
+        const SPinLocation* getIOPadLocation(int ioPadIndex) const;
 
         /**
-         * List to keep track of which cells are connected to others.
-         * The index is the cell number, value is a set of pairs of
-         * cell numbers the cell is connected to (first) with its corresponding weight (second).
-         *
-         * Cell numbers will be slightly different than those in the hyperedge datastructures
-         * All normal cells will be the same
-         * Added star Nodes will be placed right after the last cell number, pushing I/O pad numbers
-         * to start after the last star node number.
-         *
-         * Will incorporate both clique and star models.
+         * Creates both the Dx and Dy matrices, filled in a single pass over the pad connections.
+         * @return Dx and Dy, owned by the caller
          */
-        QMatrix::WeightedCellConnectionsList *cellConnectionsList;
+        static std::pair<DMatrix*, DMatrix*> createPair(const SPinLocation *pinLocations, int numCellsNoPads, int numStars,
+                                                        const std::vector<QMatrix::PadConnection> &padConnections);
+    private:
+        Dimension dimension;
+        // I/O pad locations, must outlive the matrix (read by getIOPadLocation)
+        const SPinLocation *pinLocations;
 
         int numCellsNoPads;
         int numStars;
 
-        void generate();
-    };
+        DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars);
 
-    struct MatrixSolverParams
-    {
-        int id;
-
-        double tolerance;
-        int maxIterations;
-
-        Matrix2D<double> *Q;
-        ColumnMatrix<double> *Dx;
-
-        ColumnMatrix<double> *xAnswer;
+        /**
+         * Sums the pad terms into the rows. padConnections are the connections between movable cells/star nodes
+         * and I/O pads, see QMatrix::getPadConnections. They are only read here, the matrix keeps no reference to them.
+         */
+        void generate(const std::vector<QMatrix::PadConnection> &padConnections);
     };
 
     /**
@@ -280,22 +511,6 @@ namespace PA3Placement
      * @return x from the equation, the solved matrix
      */
     Matrix2D<double> solveMatrixGradientDescent(double learningRate, int iterations, const Matrix2D<double> &Q, const Matrix2D<double> &Dx);
-
-    /**
-     * Solves the equation of the form Q*x = Dx
-     * where Q, x, and Dx are all matrices. x is the matrix that is unknown.
-     *
-     * Uses Conjugate Gradient method.
-     *
-     * Credit to ChatGPT for writing this function, I modified it to work with my Matrix class(es).
-     *
-     * @param tolerance
-     * @param iterations
-     * @return x from the equation, the solved matrix
-     */
-    ColumnMatrix<double> solveMatrixConjugateGradient(double tolerance, int iterations, const Matrix2D<double> &Q, const ColumnMatrix<double> &Dx);
-
-    void matrixSolverThread(void *args);
 }
 
 #endif //PA3ANALYTICPLACEMENT_MATRIX_HPP
@@ -0,0 +1,76 @@
+#ifndef PA3ANALYTICPLACEMENT_NAMETABLE_HPP
+#define PA3ANALYTICPLACEMENT_NAMETABLE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Maps names to integers. The characters of all names are copied once into a single arena, and the
+     * names are found through an open addressing hash table with linear probing, so neither inserting
+     * nor looking up a name allocates memory per name.
+     *
+     * Names are passed as (pointer, length), they do not need to be null terminated.
+     */
+    class NameTable
+    {
+    public:
+        /**
+         * Makes room for count names with total length of about averageLength * count characters
+         */
+        void reserve(size_t count, size_t averageLength = 8);
+
+        /**
+         * Associates value with the name, replacing the value it had if it was already present
+         * @param value Must not be negative
+         */
+        void insert(const char *name, size_t length, int value);
+
+        /**
+         * @return The value of the name, or -1 if it is not in the table
+         */
+        int find(const char *name, size_t length) const;
+
+        /**
+         * find for count names at once. The slots of all names are prefetched before any of them is compared,
+         * so the cache misses of a large table overlap instead of being paid one after another.
+         */
+        void findBatch(const char *const *names, const size_t *lengths, int count, int *values) const;
+
+        size_t getSize() const { return this->size; }
+
+        void clear();
+
+    private:
+        struct Slot
+        {
+            // First 8 characters of the name, zero padded. Names of up to 8 characters are compared without
+            // reading the arena.
+            uint64_t prefix;
+            // Offset of the name in the arena
+            uint32_t offset;
+            uint32_t length;
+            // -1 for an empty slot
+            int value = -1;
+        };
+
+        std::vector<Slot> slots;
+        std::vector<char> arena;
+        size_t size = 0;
+
+        static uint64_t hashName(const char *name, size_t length);
+        static uint64_t getPrefix(const char *name, size_t length);
+
+        /**
+         * Index of the slot holding the name, or of the empty slot where it would go
+         */
+        size_t findSlot(const char *name, size_t length, uint64_t hash) const;
+        bool matches(const Slot &slot, const char *name, size_t length, uint64_t prefix) const;
+
+        void rehash(size_t capacity);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_NAMETABLE_HPP
@@ -0,0 +1,100 @@
+#ifndef PA3ANALYTICPLACEMENT_NESTEROV_HPP
+#define PA3ANALYTICPLACEMENT_NESTEROV_HPP
+
+#include "density.hpp"
+#include "hypergraph.hpp"
+#include "threadpool.hpp"
+
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Information about a finished nonlinear placement
+     */
+    struct NesterovStatistics
+    {
+        int iterations = 0;
+        // Density overflow and weighted average wirelength of the final placement
+        double overflow = 0;
+        double wirelength = 0;
+    };
+
+    /**
+     * Nonlinear global placement (as in ePlace): minimizes the weighted average (WA) wirelength plus
+     * lambda times the electrostatic density energy, with Nesterov's accelerated gradient method.
+     *
+     * The step length is the inverse of a Lipschitz constant estimated from the last two reference points and
+     * their gradients, so no line search is needed. The density weight lambda grows every iteration and the WA
+     * smoothing parameter gamma shrinks with the overflow, so the placement goes from wirelength driven to
+     * density driven. Gradients are preconditioned by the pin count and area of each cell. Stops early once the overflow
+     * no longer drops. The density model's target density decides how tightly the cells may be packed.
+     *
+     * The wirelength gradient is computed per net in parallel into one entry per pin, then summed per cell over
+     * a cell to pin index, so threads never write to the same location and results do not depend on the thread count.
+     */
+    class NesterovPlacer
+    {
+    public:
+        /**
+         * @param pinLocations Locations of the I/O pads, pad p is cell numCellsNoPads + p
+         * @param cellSizes Area of every cell
+         * @param density Density model used for the penalty, its grid resolution is kept
+         * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+         */
+        NesterovPlacer(int numCellsNoPads, int numHyperedges, const int *cellPinArray, const int *hEdgesToFirstMemberCellArray,
+                       const int *hEdgeWeights, const SPinLocation *pinLocations, const int *cellSizes,
+                       ElectrostaticDensity &density, ThreadPool *threadPool = nullptr);
+
+        /**
+         * Places the movable cells, starting from and returning in x and y (numCellsNoPads elements each).
+         * Cells are kept within [0, width] x [0, height].
+         * @param maxIterations Maximum number of Nesterov iterations
+         * @param targetOverflow Stops once the density overflow is at most this, or when it stagnates above it
+         */
+        NesterovStatistics place(double *x, double *y, double width, double height, int maxIterations, double targetOverflow);
+
+    private:
+        int numCellsNoPads;
+        int numHyperedges;
+        const int *cellPinArray;
+        const int *hEdgesToFirstMemberCellArray;
+        const int *hEdgeWeights;
+        const SPinLocation *pinLocations;
+        const int *cellSizes;
+
+        ElectrostaticDensity &density;
+        ThreadPool *threadPool;
+
+        // Pins of cell i are cellPins[cellPinStart[i]] to cellPins[cellPinStart[i + 1] - 1], as indices into cellPinArray
+        std::vector<int> cellPinStart;
+        std::vector<int> cellPins;
+
+        // Wirelength gradient of every pin and wirelength of every net, filled by calculateWirelengthGradient
+        std::vector<double> pinGradientX;
+        std::vector<double> pinGradientY;
+        std::vector<double> netWirelength;
+
+        // Electrostatic force on every cell
+        std::vector<double> forceX;
+        std::vector<double> forceY;
+
+        void parallelFor(long count, const std::function<void(long, long)> &function) const;
+
+        /**
+         * WA wirelength and its gradient for the cells at x, y
+         * @return The weighted WA wirelength of all nets
+         */
+        double calculateWirelengthGradient(const double *x, const double *y, double gamma, double *gradientX, double *gradientY);
+
+        /**
+         * Preconditioned gradient of wirelength + densityWeight * density energy
+         * @param overflow Receives the density overflow at x, y
+         * @return The WA wirelength at x, y
+         */
+        double calculateGradient(const double *x, const double *y, double gamma, double densityWeight,
+                                 double *gradientX, double *gradientY, double &overflow);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_NESTEROV_HPP
@@ -6,48 +6,205 @@
 #define PA3ANALYTICPLACEMENT_PLACER_HPP
 
 #include <vector>
+#include "bingrid.hpp"
+#include "density.hpp"
+#include "hypergraph.hpp"
+#include "legalizer.hpp"
 #include "matrix.hpp"
+#include "solver.hpp"
+#include "wirelength.hpp"
 
 namespace PA3Placement
 {
-    struct Bin
+    enum class GlobalPlacementMode
     {
-        double lowerX;
-        double upperX;
-        double lowerY;
-        double upperY;
+        // FastPlace: quadratic wirelength with cell shifting and anchors
+        QUADRATIC,
+        // ePlace style: weighted average wirelength plus density, Nesterov's method
+        NESTEROV
+    };
+
+    /**
+     * Parses a global placement mode name as given on the command line ("quadratic" or "nesterov").
+     * @return true if the name was recognized, in which case mode is set
+     */
+    bool parseGlobalPlacementMode(const std::string &name, GlobalPlacementMode &mode);
+
+    enum class SpreadingMethod
+    {
+        // FastPlace cell shifting over the bin grid
+        CELL_SHIFTING,
+        // Move cells along the electrostatic field of the cell density
+        ELECTROSTATIC
+    };
+
+    /**
+     * Parses a spreading method name as given on the command line ("shift" or "electrostatic").
+     * @return true if the name was recognized, in which case method is set
+     */
+    bool parseSpreadingMethod(const std::string &name, SpreadingMethod &method);
+
+    /**
+     * Options controlling the placer, usually set from the command line
+     */
+    struct PlacerSettings
+    {
+        // Preconditioner used by the Conjugate Gradient solves
+        PreconditionerType preconditioner = PreconditionerType::JACOBI;
+        // Relaxation factor when using the SSOR preconditioner, 0 < w < 2
+        double ssorOmega = 1.0;
+        // Threads used by the solver, including the main thread
+        int threadCount = ThreadPool::getDefaultThreadCount();
+
+        // Global placement after the initial quadratic solve
+        GlobalPlacementMode globalPlacement = GlobalPlacementMode::QUADRATIC;
+        // Maximum number of Nesterov iterations in GlobalPlacementMode::NESTEROV
+        int nesterovIterations = 1000;
+
+        // Maximum number of FastPlace global placement iterations (shift cells, anchor them, re-solve).
+        // 0 for a single solve followed by one cell shifting pass
+        int globalIterations = 30;
+        // Anchor weight of a cell one bin away from its target in the first iteration, relative to the weight of the
+        // cell's connections. It grows linearly with the iteration number
+        double anchorWeight = 0.1;
+        // Cell area a bin may hold, as a fraction of its area. Designs that are fuller than this use their utilization.
+        // Used by the overflow of the bin grid and by the electrostatic density, both its charge and its overflow
+        double targetDensity = 1.0;
+        // The loop stops once the overflow (fraction of the cell area above the target density of its bin) is at most this
+        double targetOverflow = 0.1;
 
-        int utilization;
+        // Resolution of the bin grid used by cell shifting and the overflow measure
+        int binsX = 5;
+        int binsY = 5;
 
-        std::vector<int> memberCells;
+        // How cells are spread, both in the global placement iterations and the final spreading pass
+        SpreadingMethod spreading = SpreadingMethod::CELL_SHIFTING;
+        // Resolution of the electrostatic density grid in each direction, rounded up to a power of two.
+        // GlobalPlacementMode::NESTEROV uses about one bin per cell, with at most this many bins per side
+        int densityBins = 64;
+
+        // Legalization of the spread placement into rows, LegalizationMode::NONE to skip it
+        LegalizationMode legalization = LegalizationMode::ABACUS;
+        // Detailed placement passes over the legal placement, 0 to skip it
+        int detailedPasses = 2;
+
+        // Write the placement stages to [prefix]_preSpread/_spread/_legal.kiaPad. Programs using the placer
+        // as a library read the results with getSpreadCellLocations() and getLegalCellLocations() instead.
+        bool saveFiles = true;
     };
 
     class AnalyticPlacer
     {
     private:
+        // Only read, owned by the caller and must outlive the placer
+        const Hypergraph &hypergraph;
+        PlacerSettings settings;
+
         QMatrix *matrixQ;
+        // Only the I/O pad terms, built once. The solves use rhsX/rhsY
         DMatrix *matrixDx;
         DMatrix *matrixDy;
+        // Right hand sides of the solves: Dx/Dy plus the anchor terms of the current global placement iteration
+        std::vector<double> rhsX;
+        std::vector<double> rhsY;
+        // Anchor weight of every row of Q, reused between global placement iterations
+        std::vector<double> anchorWeights;
+
+        // nullptr when solving without a preconditioner
+        Preconditioner *preconditioner;
+
+        ThreadPool *threadPool;
+
+        // Kept between solves so re-solves reuse its work vectors
+        ConjugateGradientSolver *solver;
+        // Solution of the last solve, also the starting point of the next one
+        std::vector<double> solutionX;
+        std::vector<double> solutionY;
 
         std::vector<std::pair<double, double>> cellLocations;
         std::vector<std::pair<double, double>> spreadedCellLocations;
+        // Result of doLegalization, only movable cells
+        std::vector<std::pair<double, double>> legalCellLocations;
+        // Shifted coordinates of the movable cells and star nodes, the output of the vectorized shifting pass
+        std::vector<double> spreadedX;
+        std::vector<double> spreadedY;
+
+        BinGrid binGrid;
+        ElectrostaticDensity *density;
 
-        std::vector<Bin> bins;
+        // Created with Q, its edge list is taken from the off-diagonal entries
+        WirelengthEvaluator *wirelengthEvaluator;
 
         /**
          * Obtain the sum of all wirelengths in the circuit.
          * Calculated by summing the weight of each hyperedge,
          * which is modified itself due to being either a clique or star.
+         * @param x X coordinates of all movable cells and star nodes
+         * @param y Y coordinates of all movable cells and star nodes
          * @return The sum of the weights of all hyperedges
          */
-        double calculateTotalWirelength(std::vector<std::pair<double, double>> &cellLocations) const;
+        double calculateTotalWirelength(const double *x, const double *y) const;
+
+        /**
+         * Half perimeter wirelength of all hyperedges (weighted), with I/O pads at their fixed locations.
+         * @param x X coordinates of at least all movable cells
+         * @param y Y coordinates of at least all movable cells
+         */
+        double calculateHPWL(const double *x, const double *y) const;
+
+        /**
+         * Measures how unevenly the cells in cellLocations are spread, as the cell area above the target density
+         * of each bin divided by the total cell area. 0 when no bin is fuller than the target density, or than the
+         * average density when the design is fuller than that.
+         */
+        double calculateOverflow();
+
+        /**
+         * FastPlace global placement: alternates cell shifting with re-solving the placement, where every
+         * cell is pulled towards its shifted location by an anchor pseudo-net of increasing weight.
+         * Only the diagonal of Q and Dx/Dy change between iterations, and every solve is warm started.
+         * Ends with the lowest HPWL iterate that reached the target overflow, or the starting solution if none did.
+         */
+        void runGlobalPlacement();
+
+        /**
+         * Adds an anchor pseudo-net from every movable cell to its target location, replacing the anchors of a previous call.
+         * Updates Q, the right hand sides and the preconditioner.
+         * @param weight Anchor weight of a cell one bin away from its target, relative to the weight of its connections
+         */
+        void applyAnchors(const std::vector<std::pair<double, double>> &targets, double weight);
+
+        /**
+         * Copies Dx/Dy into the right hand sides, dropping any anchor terms. Reuses their storage.
+         */
+        void resetRightHandSides();
+
+        /**
+         * Nonlinear global placement with NesterovPlacer, starting from the current solution.
+         * Star nodes are moved to the centroid of their hyperedge afterwards, where the quadratic model wants them.
+         */
+        void runNesterovPlacement();
+
+        /**
+         * Places every star node at the centroid of the pins of its hyperedge, using solutionX/solutionY for the cells
+         */
+        void placeStarNodes();
+
+        /**
+         * Builds Q, Dx and Dy from the parsed hypergraph, and sets up the preconditioner and solver.
+         * Does nothing if they already exist.
+         */
+        void buildMatrices();
 
         /**
          * Solves the equation for the X and Y coordinates of each cell.
          * The equation is in the form of Q * x = Dx for x coordinates
          * and Q * y = Dy for y coordinates, where Q and Dx are known, but x is unknown (same for y variant)
+         *
+         * The solve starts from solutionX/solutionY, which hold the previous solution (or zeros).
+         * @return Statistics of the X and Y solves
          */
-        void calculateCellLocations();
+        std::pair<SolverStatistics, SolverStatistics> calculateCellLocations();
 
         /**
          * Calculates the dimensions of the chip by finding the maximum I/O pad or cell X coordinate
@@ -60,14 +217,80 @@ namespace PA3Placement
         void saveSpreadedCellsToDisk(std::string filename);
 
         void doSpreading(std::string filePrefix);
+
+        /**
+         * Legalizes spreadedCellLocations into rows one unit high, with cell widths from the cell sizes,
+         * and saves the result to filePrefix_legal.kiaPad
+         */
+        void doLegalization(std::string filePrefix);
+
+        /**
+         * Computes spreadedCellLocations from cellLocations (one cell shifting pass)
+         */
+        void shiftCells();
+
+        /**
+         * Moves every movable cell by cell shifting over the current bin grid. The shifted bin boundaries
+         * of every row (X) and every column (Y) are computed in parallel, then each cell is moved by the
+         * linear map of its bin in one SIMD pass over the cell coordinates.
+         */
         void calculateSpreadedCellLocations();
+
+        /**
+         * Spreads the movable cells by moving them along the electrostatic field of the cell density
+         * for a few steps, re-solving the field after every step.
+         */
+        void calculateElectrostaticSpreading();
+        /**
+         * Fits the bin grid to the current chip dimensions
+         */
         void createBins();
-        void updateBinUtilizations();
 
-        int getBinIndex(std::pair<double, double> coordinates, std::vector<Bin> &binsList);
-        Bin* getBin(std::pair<double, double> coordinates, std::vector<Bin> &binsList);
+        /**
+         * Assigns every movable cell to its bin, weighted by its size
+         */
+        void updateBinUtilizations();
     public:
+        /**
+         * @param hypergraph The placement problem, usually filled by parseIbmFile. Not copied, it must outlive the placer.
+         */
+        AnalyticPlacer(const Hypergraph &hypergraph, const PlacerSettings &settings = PlacerSettings());
+        ~AnalyticPlacer();
+
         void doPlacement(std::string filePrefix);
+
+        /**
+         * Solves the placement again, starting from the given cell locations instead of from zero,
+         * and reusing the matrices, preconditioner and solver set up by doPlacement. When the problem
+         * only changed a little (e.g. some pads moved) this takes a few iterations instead of hundreds.
+         *
+         * @param initialLocations Starting guess for every cell and star node, usually getCellLocations()
+         *                         from the previous solve. An empty vector continues from the last solution.
+         * @return Statistics of the X and Y solves
+         */
+        std::pair<SolverStatistics, SolverStatistics> resolvePlacement(const std::vector<std::pair<double, double>> &initialLocations);
+
+        /**
+         * Rebuilds Dx and Dy after the I/O pad locations (pinLocations of the hypergraph) changed.
+         * Q does not depend on the pad locations, so it is kept. The right hand sides are reset to the new Dx and Dy.
+         */
+        void updatePadLocations();
+
+        /**
+         * Locations of every cell and star node from the last solve (not spread)
+         */
+        const std::vector<std::pair<double, double>>& getCellLocations() const;
+
+        /**
+         * Locations of every movable cell after spreading, followed by the star nodes
+         */
+        const std::vector<std::pair<double, double>>& getSpreadCellLocations() const { return this->spreadedCellLocations; }
+
+        /**
+         * Locations of every movable cell after legalization and detailed placement,
+         * empty if doPlacement did not legalize
+         */
+        const std::vector<std::pair<double, double>>& getLegalCellLocations() const { return this->legalCellLocations; }
     };
 }
 
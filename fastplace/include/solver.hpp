@@ -0,0 +1,298 @@
+#ifndef PA3ANALYTICPLACEMENT_SOLVER_HPP
+#define PA3ANALYTICPLACEMENT_SOLVER_HPP
+
+#include "matrix.hpp"
+#include "threadpool.hpp"
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+namespace PA3Placement
+{
+    enum class PreconditionerType
+    {
+        NONE,
+        JACOBI,
+        SSOR,
+        INCOMPLETE_CHOLESKY
+    };
+
+    /**
+     * Parses a preconditioner name as given on the command line ("none", "jacobi", "ssor" or "ic0").
+     * @return true if the name was recognized, in which case type is set
+     */
+    bool parsePreconditionerType(const std::string &name, PreconditionerType &type);
+
+    /**
+     * Base class for a preconditioner M used by the Conjugate Gradient solver, where M approximates Q
+     * and M^-1 * r is cheap to compute.
+     *
+     * apply does not modify the preconditioner, so one preconditioner can be shared between
+     * several solver threads once setup has been called.
+     */
+    class Preconditioner
+    {
+    public:
+        virtual ~Preconditioner() {}
+
+        /**
+         * Prepares the preconditioner for the given matrix. Must be called again
+         * if the values of the matrix change.
+         */
+        virtual void setup(const SymmetricSparseMatrix<double> &Q) = 0;
+
+        /**
+         * Computes z = M^-1 * r
+         */
+        virtual void apply(const double *r, double *z) const = 0;
+
+        /**
+         * Computes z = M^-1 * r and returns r . z
+         */
+        virtual double applyAndDot(const double *r, double *z) const;
+
+        /**
+         * True if M^-1 is block diagonal with 1x1 blocks, so applyAndDotRows can be used to
+         * apply it to different row ranges in parallel.
+         */
+        virtual bool supportsRowRanges() const { return false; }
+
+        /**
+         * Computes the elements [begin, end) of z = M^-1 * r and returns r . z over those elements.
+         * Row ranges can only be processed in parallel if supportsRowRanges is true, otherwise
+         * this applies the whole preconditioner (writing all of z) on every call.
+         */
+        virtual double applyAndDotRows(const double *r, double *z, long begin, long end) const;
+
+        virtual const char* getName() const = 0;
+    protected:
+        long size = 0;
+    };
+
+    /**
+     * Diagonal (Jacobi) preconditioner, M = diag(Q)
+     */
+    class JacobiPreconditioner : public Preconditioner
+    {
+    public:
+        virtual void setup(const SymmetricSparseMatrix<double> &Q);
+        virtual void apply(const double *r, double *z) const;
+        virtual double applyAndDot(const double *r, double *z) const;
+        virtual bool supportsRowRanges() const { return true; }
+        virtual double applyAndDotRows(const double *r, double *z, long begin, long end) const;
+        virtual const char* getName() const { return "jacobi"; }
+    private:
+        std::vector<double> inverseDiagonal;
+    };
+
+    /**
+     * Symmetric successive over-relaxation preconditioner,
+     * M = (D/w + L) (D/w)^-1 (D/w + L^T) * w/(2-w), where Q = L + D + L^T.
+     *
+     * With w = 1 this is symmetric Gauss-Seidel.
+     */
+    class SSORPreconditioner : public Preconditioner
+    {
+    public:
+        SSORPreconditioner(double omega);
+
+        virtual void setup(const SymmetricSparseMatrix<double> &Q);
+        virtual void apply(const double *r, double *z) const;
+        virtual const char* getName() const { return "ssor"; }
+    private:
+        double omega;
+
+        const SymmetricSparseMatrix<double> *matrix = nullptr;
+        // w / d_i for every row
+        std::vector<double> scaledInverseDiagonal;
+    };
+
+    /**
+     * Zero fill-in incomplete Cholesky preconditioner, M = U^T U where U is upper triangular
+     * with the same sparsity pattern as the upper triangle of Q.
+     */
+    class IncompleteCholeskyPreconditioner : public Preconditioner
+    {
+    public:
+        virtual void setup(const SymmetricSparseMatrix<double> &Q);
+        virtual void apply(const double *r, double *z) const;
+        virtual const char* getName() const { return "ic0"; }
+    private:
+        // Factor U shares its row/column structure with the matrix it was built from
+        const SymmetricSparseMatrix<double> *matrix = nullptr;
+        std::vector<double> factorValues;
+        std::vector<double> inverseDiagonal;
+    };
+
+    /**
+     * Creates a preconditioner of the given type, or returns nullptr for PreconditionerType::NONE.
+     * The caller owns the returned object.
+     */
+    Preconditioner* createPreconditioner(PreconditionerType type, double ssorOmega = 1.0);
+
+    /**
+     * Information about a finished solve
+     */
+    struct SolverStatistics
+    {
+        int iterations = 0;
+        double residualNorm = 0;
+        // Wall clock time of the solve, excluding preconditioner setup
+        double seconds = 0;
+        bool converged = false;
+    };
+
+    std::ostream& operator<<(std::ostream &out, const SolverStatistics &statistics);
+
+    /**
+     * Conjugate Gradient solver for equations of the form Q * x = b,
+     * where Q is a symmetric positive definite sparse matrix, optionally preconditioned.
+     *
+     * All work vectors are allocated once when the solver is created and reused by every
+     * solve, so iterations do not touch the heap. Vector updates are fused so each
+     * iteration makes as few passes over memory as possible:
+     *  - Ap = Q * p together with p . Ap
+     *  - x += alpha * p, r -= alpha * Ap together with r . r
+     *  - z = M^-1 * r together with r . z (when preconditioned)
+     *  - p = z + beta * p
+     *
+     * solvePair runs two independent systems sharing the same Q (the X and Y placement equations)
+     * together, so each pass over Q serves both right hand sides.
+     *
+     * Given a thread pool (and a Q with its transpose index built), the products, vector updates and
+     * dot products are split over the threads by row ranges holding about the same number of non-zeros.
+     * Partial dot products are always summed in the same order, so the result for a given thread count
+     * is reproducible. Preconditioners that need triangular solves (SSOR, IC(0)) still run on one thread.
+     *
+     * Vector updates, the Jacobi preconditioner and (with the transpose index) the rows of Q * p use the
+     * SIMD kernels from getVectorKernels.
+     */
+    class ConjugateGradientSolver
+    {
+    public:
+        /**
+         * @param preconditioner Already set up preconditioner for Q, or nullptr for plain CG.
+         *                       Not owned by the solver.
+         * @param threadPool Threads to run on, or nullptr to run on the calling thread only. Not owned by the solver.
+         */
+        ConjugateGradientSolver(const SymmetricSparseMatrix<double> &Q, double tolerance, int maxIterations,
+                                const Preconditioner *preconditioner = nullptr, ThreadPool *threadPool = nullptr);
+
+        /**
+         * Solves Q * x = b.
+         * @param b Right hand side, Q.getHeight() elements
+         * @param x Initial guess on entry, solution on exit. Q.getHeight() elements
+         * @return Iteration count, final residual and time taken
+         */
+        SolverStatistics solve(const double *b, double *x);
+
+        /**
+         * Solves Q * x1 = b1 and Q * x2 = b2 at the same time, with one sparse matrix
+         * product serving both systems every iteration. Each system stops iterating as soon as
+         * it reaches the tolerance on its own, the results match two separate solves.
+         * @param statistics Receives the statistics of each system (2 elements)
+         */
+        void solvePair(const double *b1, const double *b2, double *x1, double *x2, SolverStatistics *statistics);
+
+    private:
+        /**
+         * Work vectors and state of the CG recurrence for one right hand side
+         */
+        struct ColumnState
+        {
+            std::vector<double> r;
+            std::vector<double> z;
+            std::vector<double> p;
+            std::vector<double> Ap;
+
+            double *x;
+            // r . r and r . z
+            double rr;
+            double rz;
+
+            bool active;
+            SolverStatistics statistics;
+        };
+
+        const SymmetricSparseMatrix<double> &Q;
+        const Preconditioner *preconditioner;
+        ThreadPool *threadPool;
+
+        double tolerance;
+        int maxIterations;
+
+        // Row range of each thread, thread i works on [rowPartition[i], rowPartition[i + 1])
+        std::vector<long> rowPartition;
+        // Partial dot products of each thread
+        std::vector<double> partialSums;
+
+        // Work vectors are only allocated for the second column once solvePair is used
+        ColumnState columns[2];
+        // Number of columns in the current solve
+        int columnCount;
+
+        // Start of the current solve, for timing
+        std::chrono::steady_clock::time_point startTime;
+
+        void allocateColumn(ColumnState &column);
+
+        /**
+         * Runs function(thread, begin, end) for the row range of every thread
+         */
+        template <typename Function>
+        void runPartitioned(Function function);
+
+        double sumPartials(int column, int slot) const;
+
+        /**
+         * Computes the initial residual and search direction for the first count columns
+         */
+        void startColumns(int count, const double *const *b, double *const *x);
+
+        /**
+         * Runs one CG iteration of every column that has not finished yet
+         */
+        void iterate();
+
+        /**
+         * Marks a column as done and fills in its statistics
+         */
+        void finishColumn(ColumnState &column);
+    };
+
+    struct MatrixSolverParams
+    {
+        int id;
+
+        double tolerance;
+        int maxIterations;
+
+        const SymmetricSparseMatrix<double> *Q;
+        ColumnMatrix<double> *Dx;
+        // May be nullptr
+        const Preconditioner *preconditioner;
+
+        ColumnMatrix<double> *xAnswer;
+        SolverStatistics statistics;
+    };
+
+    /**
+     * Solves the equation of the form Q*x = Dx
+     * where Q, x, and Dx are all matrices. x is the matrix that is unknown.
+     *
+     * Uses Conjugate Gradient method, see ConjugateGradientSolver.
+     *
+     * @param tolerance
+     * @param iterations
+     * @param preconditioner Set up preconditioner, or nullptr for none
+     * @param statistics If not nullptr, receives information about the solve
+     * @return x from the equation, the solved matrix
+     */
+    ColumnMatrix<double> solveMatrixConjugateGradient(double tolerance, int iterations, const SymmetricSparseMatrix<double> &Q, const ColumnMatrix<double> &Dx,
+                                                      const Preconditioner *preconditioner = nullptr, SolverStatistics *statistics = nullptr);
+
+    void matrixSolverThread(void *args);
+}
+
+#endif //PA3ANALYTICPLACEMENT_SOLVER_HPP
@@ -4,57 +4,18 @@
 
 #ifndef __SURAJ_PARSER__H
 #define __SURAJ_PARSER__H
-#include<map>
 #include<cstring>
 
-using namespace std;
-
-struct ltstr
-{
-  bool operator()(const char* s1, const char* s2) const
-  {
-    return strcmp(s1, s2) < 0;
-  }
-};
-
-extern map <const char *, int, ltstr> nodeNameToNodeNum_map;
-
-extern int numCellPins, // number of all terminals connected to the end points of (hyper) edges
-	numhyper, 			// number of edges and hyperedges
-	numCellsAndPads, 	// total number of movable cells (generall with names starting with a), and I/O pads (generally starting with p)
-	numCells_noPads;	// total number of movable cells
-
-extern int *cellPinArray;		// array of cell names used as endpoints of (hyper) edges
-						// The size of the array is numCellPins
-
-extern int *hEdge_idxToFirstEntryInPinArray;
-						// (hyper)edge definitions.
-						// The ith entry of this array is the
-						// index (=j) of the first pin used in the (hyper)edge
-						// The index j means the first pin of the (hyper) edge is the jth
-						// entry in cellPinArray.
-						// The degree of (hyper)edge i is determined
-						// by subtracting the value of element i from the value of element i+1
-						// The size of the array is numhyper+1
-
-extern int *hyperwts;			// (hyper) edge weights. The size of the array is numhyper
-extern int *vertexSize;		// cell and I/O pad sizes. The size of the array is numCellsAndPads
-
-struct SPinLocation {
-	int x, y;
-};
-
-extern SPinLocation *pinLocations;
-						// The x,y location of the pins. 
-						// The size of the array is (numCellsAndPads - numCells_noPads)
-						// IMPORTANT: the 0th entry in this array, corresponds to p0, which has the cell index numCells_noPads
-						// Similarly, pinLocations[i] corresponds to the (x,y) location of cell i+numCells_noPads.
-						// Conversely, if you want to get the (x,y) location of cell j -- assuming j is the cell number associated with an 
-						// I/O pad -- then j will be the p = (j - numCells_noPads)th I/O pad. pinLocations[p] has the (x,y) coordinate
-						// you have to 
+#include "hypergraph.hpp"
 
+using namespace std;
 
-int parseIbmFile(char *inareFileName, char *innetFileName, char *inPadLocationFileName);
+// Reads the .are, .net and .kiaPad files into hypergraph, replacing what it held (see hypergraph.hpp for the
+// layout of the arrays). The files are memory mapped and tokenized in place, every name is looked up in a hash
+// table, and the pin arrays are filled in one pass. There is no global state, so several files can be parsed
+// at the same time into different hypergraphs.
+// Returns -1 if a file cannot be read or does not match the counts in the .net header
+int parseIbmFile(const char *inareFileName, const char *innetFileName, const char *inPadLocationFileName, PA3Placement::Hypergraph &hypergraph);
 
 
-#endif 
\ No newline at end of file
+#endif
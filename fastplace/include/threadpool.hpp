@@ -0,0 +1,65 @@
+#ifndef PA3ANALYTICPLACEMENT_THREADPOOL_HPP
+#define PA3ANALYTICPLACEMENT_THREADPOOL_HPP
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Fixed set of worker threads that repeatedly run the same task on every thread,
+     * fork/join style. Meant for the fine grained parallel loops inside the solver,
+     * where starting new threads for every loop would cost more than the loop itself.
+     *
+     * The thread calling run takes part as thread 0, so a pool of 1 thread runs everything inline.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * @param threadCount Total number of threads including the calling thread, at least 1
+         */
+        explicit ThreadPool(int threadCount);
+        ~ThreadPool();
+
+        ThreadPool(const ThreadPool &other) = delete;
+        ThreadPool& operator=(const ThreadPool &rhs) = delete;
+
+        int getThreadCount() const { return static_cast<int>(this->workers.size()) + 1; }
+
+        /**
+         * Runs task(threadIndex) once on every thread, with threadIndex in [0, getThreadCount()),
+         * and returns once all of them have finished. Must not be called from inside a task.
+         */
+        void run(const std::function<void(int)> &task);
+
+        /**
+         * Splits [0, count) into getThreadCount() contiguous chunks of (nearly) equal size and runs
+         * function(begin, end) for each chunk in parallel.
+         */
+        void parallelFor(long count, const std::function<void(long, long)> &function);
+
+        /**
+         * Number of hardware threads on this machine, at least 1
+         */
+        static int getDefaultThreadCount();
+    private:
+        std::vector<std::thread> workers;
+
+        std::mutex mutex;
+        std::condition_variable wakeCondition;
+        std::condition_variable doneCondition;
+
+        const std::function<void(int)> *currentTask = nullptr;
+        unsigned long generation = 0;
+        int pendingWorkers = 0;
+        bool stopping = false;
+
+        void workerLoop(int threadIndex);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_THREADPOOL_HPP
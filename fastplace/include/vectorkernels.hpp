@@ -0,0 +1,97 @@
+#ifndef PA3ANALYTICPLACEMENT_VECTORKERNELS_HPP
+#define PA3ANALYTICPLACEMENT_VECTORKERNELS_HPP
+
+#include <string>
+
+namespace PA3Placement
+{
+    /**
+     * Read only view of a matrix in compressed sparse row format,
+     * row i holds the entries [rowStart[i], rowStart[i + 1]) of columnIndices and values.
+     */
+    struct CompressedRows
+    {
+        const long *rowStart;
+        const int *columnIndices;
+        const double *values;
+    };
+
+    /**
+     * Dense and sparse vector primitives used by the solver, in one implementation per instruction set.
+     *
+     * The implementation is picked at runtime from what the CPU supports (AVX-512, AVX2, SSE2 or plain scalar
+     * code), so a single binary runs at full speed on any x86-64 machine. Vectorized versions add up
+     * their sums in a different order than the scalar ones, so results agree up to rounding.
+     */
+    struct VectorKernels
+    {
+        const char *name;
+
+        /**
+         * @return x . y
+         */
+        double (*dot)(const double *x, const double *y, long n);
+
+        /**
+         * y += a * x
+         */
+        void (*axpy)(double a, const double *x, double *y, long n);
+
+        /**
+         * y = x + b * y
+         */
+        void (*xpby)(const double *x, double b, double *y, long n);
+
+        /**
+         * y += a * x
+         * @return The new y . y
+         */
+        double (*axpyAndNorm)(double a, const double *x, double *y, long n);
+
+        /**
+         * y = d * x element by element
+         * @return x . y
+         */
+        double (*multiplyAndDot)(const double *d, const double *x, double *y, long n);
+
+        /**
+         * Rows [begin, end) of y = (upper + lower) * x, for two CSR matrices with the same number of rows
+         * (the two triangles of a symmetric matrix).
+         * @return x . y over the same rows
+         */
+        double (*sparseRowsAndDot)(const CompressedRows &upper, const CompressedRows &lower, long begin, long end, const double *x, double *y);
+
+        /**
+         * sparseRowsAndDot for two vectors at once, y1 = (upper + lower) * x1 and y2 = (upper + lower) * x2.
+         * dots receives x1 . y1 and x2 . y2 over the rows.
+         */
+        void (*sparseRowsPairAndDot)(const CompressedRows &upper, const CompressedRows &lower, long begin, long end,
+                                     const double *x1, const double *x2, double *y1, double *y2, double *dots);
+
+        /**
+         * y = scale[index] * x + offset[index] element by element, a per group linear map where
+         * element i belongs to group index[i]
+         */
+        void (*gatherAffine)(const double *scale, const double *offset, const int *index, const double *x, double *y, long n);
+
+        /**
+         * Weighted squared length of a list of two-pin edges, the sum over k of
+         * weight[k] * ((x[from[k]] - x[to[k]])^2 + (y[from[k]] - y[to[k]])^2)
+         */
+        double (*edgeWirelength)(const int *from, const int *to, const double *weight, const double *x, const double *y, long n);
+    };
+
+    /**
+     * The kernels in use, by default the fastest set supported by this CPU.
+     */
+    const VectorKernels& getVectorKernels();
+
+    /**
+     * Selects the kernels to use by name: "auto" (the fastest supported), "scalar", "sse2", "avx2" or "avx512".
+     * Must be called before any solver is created.
+     * @return false if the name is unknown or the instruction set is not supported by this CPU
+     */
+    bool selectVectorKernels(const std::string &name);
+}
+
+#endif //PA3ANALYTICPLACEMENT_VECTORKERNELS_HPP
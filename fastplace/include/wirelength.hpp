@@ -0,0 +1,76 @@
+#ifndef PA3ANALYTICPLACEMENT_WIRELENGTH_HPP
+#define PA3ANALYTICPLACEMENT_WIRELENGTH_HPP
+
+#include "hypergraph.hpp"
+#include "matrix.hpp"
+#include "threadpool.hpp"
+
+#include <functional>
+#include <vector>
+
+namespace PA3Placement
+{
+    /**
+     * Evaluates the wirelength of a placement, cheaply enough to be done after every global placement iteration.
+     *
+     * The connections between movable nodes are taken from the off-diagonal upper triangle of Q once, as a flat list
+     * of (from, to, weight) edges, so the quadratic wirelength is a single vectorized pass over three arrays.
+     * Both measures are summed over fixed size blocks in parallel and the block sums are added up in order,
+     * so the result does not depend on the thread count.
+     */
+    class WirelengthEvaluator
+    {
+    public:
+        /**
+         * @param matrixQ Only its off-diagonal entries are used, they do not change when anchors are added
+         * @param pinLocations Locations of the I/O pads, pad p is cell numCellsNoPads + p
+         * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+         */
+        WirelengthEvaluator(const QMatrix &matrixQ, int numCellsNoPads, int numHyperedges, const int *cellPinArray,
+                            const int *hEdgesToFirstMemberCellArray, const int *hEdgeWeights, const SPinLocation *pinLocations,
+                            ThreadPool *threadPool = nullptr);
+
+        /**
+         * Sum of weight * squared Euclidean length over all connections between movable nodes (cells and star nodes).
+         * Connections to I/O pads are not included.
+         * @param x X coordinates of all rows of Q
+         * @param y Y coordinates of all rows of Q
+         */
+        double calculateQuadraticWirelength(const double *x, const double *y);
+
+        /**
+         * Weighted half perimeter wirelength of all hyperedges, with I/O pads at their fixed locations
+         * @param x X coordinates of at least all movable cells
+         * @param y Y coordinates of at least all movable cells
+         */
+        double calculateHPWL(const double *x, const double *y);
+
+        long getEdgeCount() const { return static_cast<long>(this->edgeWeight.size()); }
+
+    private:
+        int numCellsNoPads;
+        int numHyperedges;
+        const int *cellPinArray;
+        const int *hEdgesToFirstMemberCellArray;
+        const int *hEdgeWeights;
+        const SPinLocation *pinLocations;
+        ThreadPool *threadPool;
+
+        // Edge k connects edgeFrom[k] and edgeTo[k]
+        std::vector<int> edgeFrom;
+        std::vector<int> edgeTo;
+        std::vector<double> edgeWeight;
+
+        // Sum of every block of the last evaluation, sized for the larger of the two in the constructor
+        std::vector<double> blockSums;
+
+        void parallelFor(long count, const std::function<void(long, long)> &function) const;
+
+        /**
+         * Runs blockSum(begin, end) over [0, count) in blocks and adds the results in block order
+         */
+        double sumBlocks(long count, const std::function<double(long, long)> &blockSum);
+    };
+}
+
+#endif //PA3ANALYTICPLACEMENT_WIRELENGTH_HPP
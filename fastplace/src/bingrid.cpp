@@ -0,0 +1,97 @@
+#include "bingrid.hpp"
+
+#include <cassert>
+#include <cmath>
+
+namespace PA3Placement
+{
+    BinGrid::BinGrid(int binsX, int binsY)
+    {
+        this->setResolution(binsX, binsY);
+    }
+
+    void BinGrid::setResolution(int binsX, int binsY)
+    {
+        assert(binsX >= 1 && binsY >= 1);
+
+        this->binsX = binsX;
+        this->binsY = binsY;
+
+        this->setChipDimensions(this->width, this->height);
+    }
+
+    void BinGrid::setChipDimensions(double width, double height)
+    {
+        this->width = width;
+        this->height = height;
+        this->binWidth = width / this->binsX;
+        this->binHeight = height / this->binsY;
+
+        this->clearCells();
+    }
+
+    void BinGrid::clearCells()
+    {
+        this->binStart.assign(this->getBinCount() + 1, 0);
+        this->binCellArea.assign(this->getBinCount(), 0);
+        this->binCells.clear();
+        this->totalCellArea = 0;
+    }
+
+    int BinGrid::getColumn(double x) const
+    {
+        const double column = std::floor(x / this->binWidth);
+
+        // Also catches NaN, e.g. on a chip of zero width
+        if (!(column >= 0))
+        {
+            return 0;
+        }
+
+        return column >= this->binsX ? this->binsX - 1 : (int) column;
+    }
+
+    int BinGrid::getRow(double y) const
+    {
+        const double row = std::floor(y / this->binHeight);
+
+        if (!(row >= 0))
+        {
+            return 0;
+        }
+
+        return row >= this->binsY ? this->binsY - 1 : (int) row;
+    }
+
+    void BinGrid::assignCells(const std::vector<std::pair<double, double>> &locations, int count, const int *sizes)
+    {
+        assert(count <= (int) locations.size());
+
+        this->clearCells();
+        this->cellBin.resize(count);
+        this->binCells.resize(count);
+
+        // Count the cells and their area per bin, binStart[b + 1] holds the count of bin b
+        for (int i = 0; i < count; i++)
+        {
+            const int bin = this->getBinIndex(locations[i].first, locations[i].second);
+
+            this->cellBin[i] = bin;
+            this->binStart[bin + 1]++;
+            this->binCellArea[bin] += sizes[i];
+            this->totalCellArea += sizes[i];
+        }
+
+        for (int b = 0; b < this->getBinCount(); b++)
+        {
+            this->binStart[b + 1] += this->binStart[b];
+        }
+
+        // Stable scatter, so every bin lists its cells in increasing order
+        std::vector<int> next(this->binStart.begin(), this->binStart.end() - 1);
+        for (int i = 0; i < count; i++)
+        {
+            this->binCells[next[this->cellBin[i]]++] = i;
+        }
+    }
+}
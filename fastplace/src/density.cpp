@@ -0,0 +1,449 @@
+#include "density.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+namespace PA3Placement
+{
+    static int roundUpToPowerOfTwo(int value)
+    {
+        int power = 1;
+        while (power < value)
+        {
+            power *= 2;
+        }
+
+        return power;
+    }
+
+    CosineTransform::CosineTransform(int length)
+    {
+        assert(length >= 1 && (length & (length - 1)) == 0);
+
+        this->length = length;
+
+        const int fftLength = 2 * length;
+        int bits = 0;
+        while ((1 << bits) < fftLength)
+        {
+            bits++;
+        }
+
+        this->bitReverse.resize(fftLength);
+        for (int i = 0; i < fftLength; i++)
+        {
+            int reversed = 0;
+            for (int b = 0; b < bits; b++)
+            {
+                if (i & (1 << b))
+                {
+                    reversed |= 1 << (bits - 1 - b);
+                }
+            }
+            this->bitReverse[i] = reversed;
+        }
+
+        this->twiddles.resize(fftLength / 2);
+        for (int k = 0; k < fftLength / 2; k++)
+        {
+            this->twiddles[k] = std::polar(1.0, -2 * M_PI * k / fftLength);
+        }
+
+        this->halfShift.resize(length);
+        for (int u = 0; u < length; u++)
+        {
+            this->halfShift[u] = std::polar(1.0, -M_PI * u / fftLength);
+        }
+    }
+
+    void CosineTransform::fft(std::complex<double> *data, bool inverse) const
+    {
+        const int fftLength = 2 * this->length;
+
+        for (int i = 0; i < fftLength; i++)
+        {
+            if (i < this->bitReverse[i])
+            {
+                std::swap(data[i], data[this->bitReverse[i]]);
+            }
+        }
+
+        for (int size = 2; size <= fftLength; size *= 2)
+        {
+            const int half = size / 2;
+            const int step = fftLength / size;
+
+            for (int start = 0; start < fftLength; start += size)
+            {
+                for (int k = 0; k < half; k++)
+                {
+                    const std::complex<double> w = inverse ? std::conj(this->twiddles[k * step]) : this->twiddles[k * step];
+                    const std::complex<double> t = w * data[start + k + half];
+
+                    data[start + k + half] = data[start + k] - t;
+                    data[start + k] += t;
+                }
+            }
+        }
+    }
+
+    void CosineTransform::dct(const double *x, double *X, std::complex<double> *scratch) const
+    {
+        // X[u] = Re(exp(-i pi u / 2n) * sum_j x[j] exp(-2 pi i uj / 2n)), with x zero padded to 2n
+        for (int j = 0; j < this->length; j++)
+        {
+            scratch[j] = x[j];
+        }
+        std::fill(scratch + this->length, scratch + 2 * this->length, 0.0);
+
+        this->fft(scratch, false);
+
+        for (int u = 0; u < this->length; u++)
+        {
+            X[u] = (this->halfShift[u] * scratch[u]).real();
+        }
+    }
+
+    void CosineTransform::sums(const double *b, std::complex<double> *scratch) const
+    {
+        // sum_u b[u] exp(i pi u (2j + 1) / 2n) = sum_u (b[u] exp(i pi u / 2n)) exp(2 pi i uj / 2n)
+        for (int u = 0; u < this->length; u++)
+        {
+            scratch[u] = b[u] * std::conj(this->halfShift[u]);
+        }
+        std::fill(scratch + this->length, scratch + 2 * this->length, 0.0);
+
+        this->fft(scratch, true);
+    }
+
+    void CosineTransform::cosineSum(const double *b, double *y, std::complex<double> *scratch) const
+    {
+        this->sums(b, scratch);
+
+        for (int j = 0; j < this->length; j++)
+        {
+            y[j] = scratch[j].real();
+        }
+    }
+
+    void CosineTransform::sineSum(const double *b, double *y, std::complex<double> *scratch) const
+    {
+        this->sums(b, scratch);
+
+        for (int j = 0; j < this->length; j++)
+        {
+            y[j] = scratch[j].imag();
+        }
+    }
+
+    ElectrostaticDensity::ElectrostaticDensity(int binsX, int binsY, ThreadPool *threadPool)
+        : transformX(roundUpToPowerOfTwo(std::max(1, binsX))), transformY(roundUpToPowerOfTwo(std::max(1, binsY)))
+    {
+        this->binsX = this->transformX.getLength();
+        this->binsY = this->transformY.getLength();
+        this->threadPool = threadPool;
+
+        const long binCount = (long) this->binsX * this->binsY;
+        this->density.assign(binCount, 0);
+        this->coefficients.assign(binCount, 0);
+        this->potential.assign(binCount, 0);
+        this->fieldX.assign(binCount, 0);
+        this->fieldY.assign(binCount, 0);
+        this->threadArea.resize(threadPool != nullptr ? threadPool->getThreadCount() : 1);
+    }
+
+    void ElectrostaticDensity::setChipDimensions(double width, double height)
+    {
+        this->width = width;
+        this->height = height;
+        this->binWidth = width / this->binsX;
+        this->binHeight = height / this->binsY;
+    }
+
+    void ElectrostaticDensity::setTargetDensity(double targetDensity)
+    {
+        this->targetDensity = targetDensity;
+    }
+
+    void ElectrostaticDensity::parallelFor(long count, const std::function<void(long, long)> &function) const
+    {
+        if (this->threadPool != nullptr)
+        {
+            this->threadPool->parallelFor(count, function);
+        }
+        else
+        {
+            function(0, count);
+        }
+    }
+
+    ElectrostaticDensity::Stencil ElectrostaticDensity::stencil(double coordinate, double binSize, int bins)
+    {
+        // Position relative to the bin centers
+        const double position = coordinate / binSize - 0.5;
+
+        // Also catches NaN
+        if (!(position > 0))
+        {
+            return {0, 0, 0};
+        }
+        if (position >= bins - 1)
+        {
+            return {bins - 1, bins - 1, 0};
+        }
+
+        const int lower = (int) position;
+        return {lower, lower + 1, position - lower};
+    }
+
+    void ElectrostaticDensity::transformRows(std::vector<double> &grid, Transform transform) const
+    {
+        this->parallelFor(this->binsY, [&](long firstRow, long lastRow)
+        {
+            std::vector<std::complex<double>> scratch(this->transformX.getScratchSize());
+
+            for (long row = firstRow; row < lastRow; row++)
+            {
+                double *values = grid.data() + row * this->binsX;
+
+                switch (transform)
+                {
+                    case Transform::DCT:
+                        this->transformX.dct(values, values, scratch.data());
+                        break;
+                    case Transform::COSINE_SUM:
+                        this->transformX.cosineSum(values, values, scratch.data());
+                        break;
+                    case Transform::SINE_SUM:
+                        this->transformX.sineSum(values, values, scratch.data());
+                        break;
+                }
+            }
+        });
+    }
+
+    void ElectrostaticDensity::transformColumns(std::vector<double> &grid, Transform transform) const
+    {
+        this->parallelFor(this->binsX, [&](long firstColumn, long lastColumn)
+        {
+            std::vector<std::complex<double>> scratch(this->transformY.getScratchSize());
+            std::vector<double> values(this->binsY);
+
+            for (long column = firstColumn; column < lastColumn; column++)
+            {
+                for (int row = 0; row < this->binsY; row++)
+                {
+                    values[row] = grid[row * this->binsX + column];
+                }
+
+                switch (transform)
+                {
+                    case Transform::DCT:
+                        this->transformY.dct(values.data(), values.data(), scratch.data());
+                        break;
+                    case Transform::COSINE_SUM:
+                        this->transformY.cosineSum(values.data(), values.data(), scratch.data());
+                        break;
+                    case Transform::SINE_SUM:
+                        this->transformY.sineSum(values.data(), values.data(), scratch.data());
+                        break;
+                }
+
+                for (int row = 0; row < this->binsY; row++)
+                {
+                    grid[row * this->binsX + column] = values[row];
+                }
+            }
+        });
+    }
+
+    void ElectrostaticDensity::synthesize(std::vector<double> &grid, Transform alongX, Transform alongY, const std::function<double(int, int)> &scale) const
+    {
+        for (int v = 0; v < this->binsY; v++)
+        {
+            for (int u = 0; u < this->binsX; u++)
+            {
+                const long i = (long) v * this->binsX + u;
+                grid[i] = this->coefficients[i] * scale(u, v);
+            }
+        }
+
+        this->transformRows(grid, alongX);
+        this->transformColumns(grid, alongY);
+    }
+
+    double ElectrostaticDensity::update(const double *x, const double *y, const int *sizes, long count)
+    {
+        const long binCount = (long) this->binsX * this->binsY;
+
+        if (!(this->width > 0 && this->height > 0))
+        {
+            std::fill(this->potential.begin(), this->potential.end(), 0.0);
+            std::fill(this->fieldX.begin(), this->fieldX.end(), 0.0);
+            std::fill(this->fieldY.begin(), this->fieldY.end(), 0.0);
+            return 0;
+        }
+
+        // Rasterize, every thread into its own grid
+        const int threadCount = (int) this->threadArea.size();
+        auto rasterize = [&](int thread)
+        {
+            std::vector<double> &area = this->threadArea[thread];
+            area.assign(binCount, 0);
+
+            const long begin = count * thread / threadCount;
+            const long end = count * (thread + 1) / threadCount;
+            for (long i = begin; i < end; i++)
+            {
+                const Stencil sx = stencil(x[i], this->binWidth, this->binsX);
+                const Stencil sy = stencil(y[i], this->binHeight, this->binsY);
+
+                const double lowerX = sizes[i] * (1 - sx.upperWeight);
+                const double upperX = sizes[i] * sx.upperWeight;
+
+                area[(long) sy.lower * this->binsX + sx.lower] += lowerX * (1 - sy.upperWeight);
+                area[(long) sy.lower * this->binsX + sx.upper] += upperX * (1 - sy.upperWeight);
+                area[(long) sy.upper * this->binsX + sx.lower] += lowerX * sy.upperWeight;
+                area[(long) sy.upper * this->binsX + sx.upper] += upperX * sy.upperWeight;
+            }
+        };
+
+        if (this->threadPool != nullptr)
+        {
+            this->threadPool->run(rasterize);
+        }
+        else
+        {
+            rasterize(0);
+        }
+
+        const double binArea = this->binWidth * this->binHeight;
+        double totalDensity = 0;
+        for (long b = 0; b < binCount; b++)
+        {
+            double area = 0;
+            for (int thread = 0; thread < threadCount; thread++)
+            {
+                area += this->threadArea[thread][b];
+            }
+            this->density[b] = area / binArea;
+            totalDensity += this->density[b];
+        }
+
+        // The free space is only filled when there is space left over at the target density
+        this->fillDensity = this->targetDensity > totalDensity / binCount ? this->targetDensity : 0;
+
+        // rho = sum_uv a_uv cos(w_u x) cos(w_v y), where every bin holds at least fillDensity
+        this->coefficients.resize(binCount);
+        for (long b = 0; b < binCount; b++)
+        {
+            this->coefficients[b] = std::max(this->density[b], this->fillDensity);
+        }
+        this->transformRows(this->coefficients, Transform::DCT);
+        this->transformColumns(this->coefficients, Transform::DCT);
+
+        for (int v = 0; v < this->binsY; v++)
+        {
+            for (int u = 0; u < this->binsX; u++)
+            {
+                const double normalization = (u == 0 ? 1.0 : 2.0) * (v == 0 ? 1.0 : 2.0) / binCount;
+                this->coefficients[(long) v * this->binsX + u] *= normalization;
+            }
+        }
+
+        // With w_u = pi u / width and w_v = pi v / height:
+        //   psi = sum_uv a_uv / (w_u^2 + w_v^2) cos(w_u x) cos(w_v y)
+        //   Ex = -dpsi/dx = sum_uv a_uv w_u / (w_u^2 + w_v^2) sin(w_u x) cos(w_v y), likewise for Ey
+        // The constant term (u = v = 0) is the average density, which exerts no force
+        const double frequencyX = M_PI / this->width;
+        const double frequencyY = M_PI / this->height;
+        auto inverseSquare = [=](int u, int v)
+        {
+            const double wu = u * frequencyX;
+            const double wv = v * frequencyY;
+            return (u == 0 && v == 0) ? 0.0 : 1.0 / (wu * wu + wv * wv);
+        };
+
+        this->synthesize(this->potential, Transform::COSINE_SUM, Transform::COSINE_SUM, inverseSquare);
+        this->synthesize(this->fieldX, Transform::SINE_SUM, Transform::COSINE_SUM, [&](int u, int v)
+        {
+            return u * frequencyX * inverseSquare(u, v);
+        });
+        this->synthesize(this->fieldY, Transform::COSINE_SUM, Transform::SINE_SUM, [&](int u, int v)
+        {
+            return v * frequencyY * inverseSquare(u, v);
+        });
+
+        double energy = 0;
+        for (long b = 0; b < binCount; b++)
+        {
+            energy += std::max(this->density[b], this->fillDensity) * this->potential[b];
+        }
+
+        return 0.5 * energy * binArea;
+    }
+
+    void ElectrostaticDensity::calculateForces(const double *x, const double *y, const int *sizes, long count, double *forceX, double *forceY) const
+    {
+        this->parallelFor(count, [&](long begin, long end)
+        {
+            for (long i = begin; i < end; i++)
+            {
+                const Stencil sx = stencil(x[i], this->binWidth, this->binsX);
+                const Stencil sy = stencil(y[i], this->binHeight, this->binsY);
+
+                const long lowerLeft = (long) sy.lower * this->binsX + sx.lower;
+                const long lowerRight = (long) sy.lower * this->binsX + sx.upper;
+                const long upperLeft = (long) sy.upper * this->binsX + sx.lower;
+                const long upperRight = (long) sy.upper * this->binsX + sx.upper;
+
+                const double w00 = (1 - sx.upperWeight) * (1 - sy.upperWeight);
+                const double w10 = sx.upperWeight * (1 - sy.upperWeight);
+                const double w01 = (1 - sx.upperWeight) * sy.upperWeight;
+                const double w11 = sx.upperWeight * sy.upperWeight;
+
+                forceX[i] = sizes[i] * (w00 * this->fieldX[lowerLeft] + w10 * this->fieldX[lowerRight]
+                                        + w01 * this->fieldX[upperLeft] + w11 * this->fieldX[upperRight]);
+                forceY[i] = sizes[i] * (w00 * this->fieldY[lowerLeft] + w10 * this->fieldY[lowerRight]
+                                        + w01 * this->fieldY[upperLeft] + w11 * this->fieldY[upperRight]);
+            }
+        });
+    }
+
+    double ElectrostaticDensity::getMaximumField() const
+    {
+        double maximum = 0;
+
+        for (size_t b = 0; b < this->fieldX.size(); b++)
+        {
+            maximum = std::max(maximum, std::hypot(this->fieldX[b], this->fieldY[b]));
+        }
+
+        return maximum;
+    }
+
+    double ElectrostaticDensity::getOverflow() const
+    {
+        double total = 0;
+        for (double binDensity : this->density)
+        {
+            total += binDensity;
+        }
+
+        if (total <= 0)
+        {
+            return 0;
+        }
+
+        const double capacity = std::max(this->targetDensity, total / this->density.size());
+
+        double excess = 0;
+        for (double binDensity : this->density)
+        {
+            excess += std::max(0.0, binDensity - capacity);
+        }
+
+        return excess / total;
+    }
+}
@@ -0,0 +1,664 @@
+#include "detailed.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace PA3Placement
+{
+    // Side of the square windows, in rows
+    static const int DETAILED_WINDOW_ROWS = 32;
+    // Largest independent set matched at once
+    static const int ISM_SET_SIZE = 8;
+    // How many following cells of the window are looked at for an independent set
+    static const int ISM_SEARCH_DISTANCE = 64;
+    // Rows above and below the optimal region searched for a global swap partner
+    static const int SWAP_ROW_RANGE = 1;
+    // Smallest improvement for a move to be accepted, so rounding noise never moves a cell
+    static const double MOVE_TOLERANCE = 1e-9;
+
+    DetailedPlacer::DetailedPlacer(int numCellsNoPads, int numHyperedges, const int *cellPinArray, const int *hEdgesToFirstMemberCellArray,
+                                   const int *hEdgeWeights, const SPinLocation *pinLocations, const int *cellWidths, WirelengthEvaluator &wirelengthEvaluator,
+                                   ThreadPool *threadPool)
+    {
+        this->numCellsNoPads = numCellsNoPads;
+        this->numHyperedges = numHyperedges;
+        this->cellPinArray = cellPinArray;
+        this->hEdgesToFirstMemberCellArray = hEdgesToFirstMemberCellArray;
+        this->hEdgeWeights = hEdgeWeights;
+        this->pinLocations = pinLocations;
+        this->cellWidths = cellWidths;
+        this->wirelengthEvaluator = &wirelengthEvaluator;
+        this->threadPool = threadPool;
+
+        // Counting sort of the pins by cell. A net is listed once per cell even if the cell has several pins on it.
+        std::vector<int> lastNet(numCellsNoPads, -1);
+        this->cellNetStart.assign(numCellsNoPads + 1, 0);
+
+        for (int net = 0; net < numHyperedges; net++)
+        {
+            for (int j = hEdgesToFirstMemberCellArray[net]; j < hEdgesToFirstMemberCellArray[net + 1]; j++)
+            {
+                const int cell = cellPinArray[j];
+                if (cell < numCellsNoPads && lastNet[cell] != net)
+                {
+                    lastNet[cell] = net;
+                    this->cellNetStart[cell + 1]++;
+                }
+            }
+        }
+
+        std::partial_sum(this->cellNetStart.begin(), this->cellNetStart.end(), this->cellNetStart.begin());
+        this->cellNets.resize(this->cellNetStart[numCellsNoPads]);
+
+        std::vector<int> next(this->cellNetStart.begin(), this->cellNetStart.end() - 1);
+        std::fill(lastNet.begin(), lastNet.end(), -1);
+
+        for (int net = 0; net < numHyperedges; net++)
+        {
+            for (int j = hEdgesToFirstMemberCellArray[net]; j < hEdgesToFirstMemberCellArray[net + 1]; j++)
+            {
+                const int cell = cellPinArray[j];
+                if (cell < numCellsNoPads && lastNet[cell] != net)
+                {
+                    lastNet[cell] = net;
+                    this->cellNets[next[cell]++] = net;
+                }
+            }
+        }
+    }
+
+    void DetailedPlacer::parallelFor(long count, const std::function<void(long, long)> &function) const
+    {
+        if (this->threadPool != nullptr)
+        {
+            this->threadPool->parallelFor(count, function);
+        }
+        else
+        {
+            function(0, count);
+        }
+    }
+
+    int DetailedPlacer::getRow(double y) const
+    {
+        return (int) std::floor(y / this->rowHeight);
+    }
+
+    void DetailedPlacer::getPinLocation(int cell, int window, double &pinX, double &pinY) const
+    {
+        if (cell >= this->numCellsNoPads)
+        {
+            // I/O pad
+            pinX = this->pinLocations[cell - this->numCellsNoPads].x;
+            pinY = this->pinLocations[cell - this->numCellsNoPads].y;
+        }
+        else if (this->cellWindow[cell] == window)
+        {
+            pinX = this->x[cell];
+            pinY = this->y[cell];
+        }
+        else
+        {
+            // Another window may be moving it right now
+            pinX = this->passX[cell];
+            pinY = this->passY[cell];
+        }
+    }
+
+    double DetailedPlacer::getNetHPWL(int net, int window) const
+    {
+        double minX = INFINITY;
+        double maxX = -INFINITY;
+        double minY = INFINITY;
+        double maxY = -INFINITY;
+
+        for (int j = this->hEdgesToFirstMemberCellArray[net]; j < this->hEdgesToFirstMemberCellArray[net + 1]; j++)
+        {
+            double x;
+            double y;
+            this->getPinLocation(this->cellPinArray[j], window, x, y);
+
+            minX = std::min(minX, x);
+            maxX = std::max(maxX, x);
+            minY = std::min(minY, y);
+            maxY = std::max(maxY, y);
+        }
+
+        if (minX > maxX)
+        {
+            return 0;
+        }
+
+        return this->hEdgeWeights[net] * ((maxX - minX) + (maxY - minY));
+    }
+
+    double DetailedPlacer::getCellsHPWL(const int *cells, int count, int window, std::vector<int> &nets) const
+    {
+        nets.clear();
+        for (int k = 0; k < count; k++)
+        {
+            nets.insert(nets.end(), this->cellNets.begin() + this->cellNetStart[cells[k]], this->cellNets.begin() + this->cellNetStart[cells[k] + 1]);
+        }
+
+        if (count > 1)
+        {
+            std::sort(nets.begin(), nets.end());
+            nets.erase(std::unique(nets.begin(), nets.end()), nets.end());
+        }
+
+        double sum = 0;
+        for (int net : nets)
+        {
+            sum += this->getNetHPWL(net, window);
+        }
+
+        return sum;
+    }
+
+    void DetailedPlacer::buildWindows(double windowSize, double offset, std::vector<Window> &windows)
+    {
+        const int n = this->numCellsNoPads;
+
+        double maxX = 0;
+        double maxY = 0;
+        for (int i = 0; i < n; i++)
+        {
+            maxX = std::max(maxX, this->x[i]);
+            maxY = std::max(maxY, this->y[i]);
+        }
+
+        const int windowsX = (int) std::floor((maxX + offset) / windowSize) + 1;
+        const int windowsY = (int) std::floor((maxY + offset) / windowSize) + 1;
+
+        this->passX.assign(this->x, this->x + n);
+        this->passY.assign(this->y, this->y + n);
+        this->cellWindow.resize(n);
+
+        std::vector<int> windowCount(windowsX * windowsY + 1, 0);
+        for (int i = 0; i < n; i++)
+        {
+            const int column = std::max(0, (int) std::floor((this->x[i] + offset) / windowSize));
+            const int row = std::max(0, (int) std::floor((this->y[i] + offset) / windowSize));
+
+            this->cellWindow[i] = row * windowsX + column;
+            windowCount[this->cellWindow[i] + 1]++;
+        }
+
+        // Bucket the cells by window, in cell order
+        windows.assign(windowsX * windowsY, Window());
+        for (int w = 0; w < windowsX * windowsY; w++)
+        {
+            windows[w].index = w;
+            windows[w].cells.reserve(windowCount[w + 1]);
+        }
+        for (int i = 0; i < n; i++)
+        {
+            windows[this->cellWindow[i]].cells.push_back(i);
+        }
+
+        this->parallelFor(windows.size(), [&](long firstWindow, long lastWindow)
+        {
+            for (long w = firstWindow; w < lastWindow; w++)
+            {
+                this->sortWindow(windows[w]);
+            }
+        });
+    }
+
+    void DetailedPlacer::sortWindow(Window &window) const
+    {
+        std::vector<int> &cells = window.cells;
+        window.rowStart.clear();
+
+        if (cells.empty())
+        {
+            return;
+        }
+
+        std::sort(cells.begin(), cells.end(), [&](int a, int b)
+        {
+            const int rowA = this->getRow(this->y[a]);
+            const int rowB = this->getRow(this->y[b]);
+            return rowA != rowB ? rowA < rowB : (this->x[a] != this->x[b] ? this->x[a] < this->x[b] : a < b);
+        });
+
+        window.firstRow = this->getRow(this->y[cells.front()]);
+        const int lastRow = this->getRow(this->y[cells.back()]);
+
+        window.rowStart.resize(lastRow - window.firstRow + 2);
+        size_t k = 0;
+        for (int row = window.firstRow; row <= lastRow; row++)
+        {
+            window.rowStart[row - window.firstRow] = (int) k;
+            while (k < cells.size() && this->getRow(this->y[cells[k]]) == row)
+            {
+                k++;
+            }
+        }
+        window.rowStart.back() = (int) cells.size();
+    }
+
+    long DetailedPlacer::globalSwap(Window &window)
+    {
+        std::vector<int> &cells = window.cells;
+        const int rows = (int) window.rowStart.size() - 1;
+
+        std::vector<double> boundsX;
+        std::vector<double> boundsY;
+        std::vector<int> nets;
+        long swaps = 0;
+
+        for (size_t s = 0; s < cells.size(); s++)
+        {
+            const int cell = cells[s];
+
+            // The optimal region is between the medians of the bounding box ends of its nets without the cell
+            boundsX.clear();
+            boundsY.clear();
+            for (int j = this->cellNetStart[cell]; j < this->cellNetStart[cell + 1]; j++)
+            {
+                const int net = this->cellNets[j];
+
+                double minX = INFINITY;
+                double maxX = -INFINITY;
+                double minY = INFINITY;
+                double maxY = -INFINITY;
+                for (int p = this->hEdgesToFirstMemberCellArray[net]; p < this->hEdgesToFirstMemberCellArray[net + 1]; p++)
+                {
+                    const int other = this->cellPinArray[p];
+                    if (other == cell)
+                    {
+                        continue;
+                    }
+
+                    double pinX;
+                    double pinY;
+                    this->getPinLocation(other, window.index, pinX, pinY);
+                    minX = std::min(minX, pinX);
+                    maxX = std::max(maxX, pinX);
+                    minY = std::min(minY, pinY);
+                    maxY = std::max(maxY, pinY);
+                }
+
+                if (minX <= maxX)
+                {
+                    boundsX.push_back(minX);
+                    boundsX.push_back(maxX);
+                    boundsY.push_back(minY);
+                    boundsY.push_back(maxY);
+                }
+            }
+
+            if (boundsX.empty())
+            {
+                continue;
+            }
+
+            const size_t middle = boundsX.size() / 2;
+            std::nth_element(boundsX.begin(), boundsX.begin() + middle, boundsX.end());
+            std::nth_element(boundsY.begin(), boundsY.begin() + middle, boundsY.end());
+            const double optimalX = (*std::max_element(boundsX.begin(), boundsX.begin() + middle) + boundsX[middle]) / 2;
+            const double optimalY = (*std::max_element(boundsY.begin(), boundsY.begin() + middle) + boundsY[middle]) / 2;
+
+            const int width = this->cellWidths[cell];
+            if (std::abs(optimalX - this->x[cell]) <= std::max(width, 1) && std::abs(optimalY - this->y[cell]) <= this->rowHeight)
+            {
+                // Already in its optimal region
+                continue;
+            }
+
+            const int targetRow = this->getRow(optimalY) - window.firstRow;
+            double bestGain = MOVE_TOLERANCE;
+            int bestSlot = -1;
+
+            for (int row = std::max(0, targetRow - SWAP_ROW_RANGE); row <= std::min(rows - 1, targetRow + SWAP_ROW_RANGE); row++)
+            {
+                // Cells around the optimal X in this row
+                const auto begin = cells.begin() + window.rowStart[row];
+                const auto end = cells.begin() + window.rowStart[row + 1];
+                const int nearest = (int) (std::lower_bound(begin, end, optimalX, [&](int c, double value) { return this->x[c] < value; }) - cells.begin());
+
+                for (int t = std::max(window.rowStart[row], nearest - 1); t <= std::min(window.rowStart[row + 1] - 1, nearest + 1); t++)
+                {
+                    const int other = cells[t];
+                    if (t == (int) s || this->cellWidths[other] != width)
+                    {
+                        continue;
+                    }
+
+                    const int pair[2] = {cell, other};
+                    const double before = this->getCellsHPWL(pair, 2, window.index, nets);
+                    std::swap(this->x[cell], this->x[other]);
+                    std::swap(this->y[cell], this->y[other]);
+                    const double after = this->getCellsHPWL(pair, 2, window.index, nets);
+                    std::swap(this->x[cell], this->x[other]);
+                    std::swap(this->y[cell], this->y[other]);
+
+                    if (before - after > bestGain)
+                    {
+                        bestGain = before - after;
+                        bestSlot = t;
+                    }
+                }
+            }
+
+            if (bestSlot >= 0)
+            {
+                // Same width, so the cells exchange positions and the window stays sorted once they exchange slots
+                const int other = cells[bestSlot];
+                std::swap(this->x[cell], this->x[other]);
+                std::swap(this->y[cell], this->y[other]);
+                std::swap(cells[s], cells[bestSlot]);
+                swaps++;
+            }
+        }
+
+        return swaps;
+    }
+
+    /**
+     * Minimum cost assignment of n rows to n columns (Hungarian algorithm with potentials, O(n^3)).
+     * @param cost Row major n x n costs
+     * @param assignment Receives the column of every row
+     */
+    static void solveAssignment(const double *cost, int n, int *assignment)
+    {
+        // 1-based, column 0 is a virtual column for the row being added
+        std::array<double, ISM_SET_SIZE + 1> u{};
+        std::array<double, ISM_SET_SIZE + 1> v{};
+        std::array<int, ISM_SET_SIZE + 1> rowOfColumn{};
+        std::array<int, ISM_SET_SIZE + 1> way{};
+        std::array<double, ISM_SET_SIZE + 1> minimum{};
+        std::array<char, ISM_SET_SIZE + 1> used{};
+
+        for (int i = 1; i <= n; i++)
+        {
+            rowOfColumn[0] = i;
+            int column = 0;
+            minimum.fill(INFINITY);
+            used.fill(false);
+
+            do
+            {
+                used[column] = true;
+                const int row = rowOfColumn[column];
+                double delta = INFINITY;
+                int nextColumn = 0;
+
+                for (int j = 1; j <= n; j++)
+                {
+                    if (used[j])
+                    {
+                        continue;
+                    }
+
+                    const double reduced = cost[(row - 1) * n + (j - 1)] - u[row] - v[j];
+                    if (reduced < minimum[j])
+                    {
+                        minimum[j] = reduced;
+                        way[j] = column;
+                    }
+                    if (minimum[j] < delta)
+                    {
+                        delta = minimum[j];
+                        nextColumn = j;
+                    }
+                }
+
+                for (int j = 0; j <= n; j++)
+                {
+                    if (used[j])
+                    {
+                        u[rowOfColumn[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                    {
+                        minimum[j] -= delta;
+                    }
+                }
+
+                column = nextColumn;
+            } while (rowOfColumn[column] != 0);
+
+            // Flip the augmenting path
+            do
+            {
+                const int previous = way[column];
+                rowOfColumn[column] = rowOfColumn[previous];
+                column = previous;
+            } while (column != 0);
+        }
+
+        for (int j = 1; j <= n; j++)
+        {
+            assignment[rowOfColumn[j] - 1] = j - 1;
+        }
+    }
+
+    long DetailedPlacer::independentSetMatching(Window &window)
+    {
+        std::vector<int> &cells = window.cells;
+
+        std::vector<char> used(cells.size(), false);
+        std::vector<int> setNets;
+        std::vector<int> nets;
+        long matched = 0;
+
+        for (size_t s = 0; s < cells.size(); s++)
+        {
+            if (used[s])
+            {
+                continue;
+            }
+
+            // Greedy independent set: following cells of the same width that share no net with the set
+            int slots[ISM_SET_SIZE];
+            int count = 0;
+            slots[count++] = (int) s;
+            used[s] = true;
+
+            const int width = this->cellWidths[cells[s]];
+            setNets.assign(this->cellNets.begin() + this->cellNetStart[cells[s]], this->cellNets.begin() + this->cellNetStart[cells[s] + 1]);
+            std::sort(setNets.begin(), setNets.end());
+
+            for (size_t t = s + 1; t < std::min(cells.size(), s + ISM_SEARCH_DISTANCE) && count < ISM_SET_SIZE; t++)
+            {
+                const int cell = cells[t];
+                if (used[t] || this->cellWidths[cell] != width)
+                {
+                    continue;
+                }
+
+                const auto begin = this->cellNets.begin() + this->cellNetStart[cell];
+                const auto end = this->cellNets.begin() + this->cellNetStart[cell + 1];
+                const bool independent = std::none_of(begin, end, [&](int net) { return std::binary_search(setNets.begin(), setNets.end(), net); });
+                if (!independent)
+                {
+                    continue;
+                }
+
+                slots[count++] = (int) t;
+                used[t] = true;
+                setNets.insert(setNets.end(), begin, end);
+                std::sort(setNets.begin(), setNets.end());
+            }
+
+            if (count < 2)
+            {
+                continue;
+            }
+
+            // The cells share no nets, so the wirelength of an assignment is the sum of what every cell costs at its position
+            int setCells[ISM_SET_SIZE];
+            double positionX[ISM_SET_SIZE];
+            double positionY[ISM_SET_SIZE];
+            for (int k = 0; k < count; k++)
+            {
+                setCells[k] = cells[slots[k]];
+                positionX[k] = this->x[setCells[k]];
+                positionY[k] = this->y[setCells[k]];
+            }
+
+            double cost[ISM_SET_SIZE * ISM_SET_SIZE];
+            double currentCost = 0;
+            for (int a = 0; a < count; a++)
+            {
+                const int cell = setCells[a];
+                for (int b = 0; b < count; b++)
+                {
+                    this->x[cell] = positionX[b];
+                    this->y[cell] = positionY[b];
+                    cost[a * count + b] = this->getCellsHPWL(&cell, 1, window.index, nets);
+                }
+                this->x[cell] = positionX[a];
+                this->y[cell] = positionY[a];
+                currentCost += cost[a * count + a];
+            }
+
+            int assignment[ISM_SET_SIZE];
+            solveAssignment(cost, count, assignment);
+
+            double assignedCost = 0;
+            for (int a = 0; a < count; a++)
+            {
+                assignedCost += cost[a * count + assignment[a]];
+            }
+
+            if (currentCost - assignedCost <= MOVE_TOLERANCE)
+            {
+                continue;
+            }
+
+            for (int a = 0; a < count; a++)
+            {
+                const int cell = setCells[a];
+                this->x[cell] = positionX[assignment[a]];
+                this->y[cell] = positionY[assignment[a]];
+                // Cells take the slot of the position they move to, which keeps the window sorted
+                cells[slots[assignment[a]]] = cell;
+
+                if (assignment[a] != a)
+                {
+                    matched++;
+                }
+            }
+        }
+
+        return matched;
+    }
+
+    long DetailedPlacer::localReordering(Window &window)
+    {
+        std::vector<int> &cells = window.cells;
+        const int rows = (int) window.rowStart.size() - 1;
+
+        std::vector<int> nets;
+        long reorders = 0;
+
+        for (int row = 0; row < rows; row++)
+        {
+            for (int s = window.rowStart[row]; s + 3 <= window.rowStart[row + 1]; s++)
+            {
+                int order[3] = {cells[s], cells[s + 1], cells[s + 2]};
+                const double originalX[3] = {this->x[order[0]], this->x[order[1]], this->x[order[2]]};
+
+                // Any order packed from the left edge of the first cell stays inside the span of the three
+                const double left = originalX[0] - this->cellWidths[order[0]] / 2.0;
+                const double right = originalX[2] + this->cellWidths[order[2]] / 2.0;
+                if (right - left < this->cellWidths[order[0]] + this->cellWidths[order[1]] + this->cellWidths[order[2]])
+                {
+                    continue;
+                }
+
+                const double currentCost = this->getCellsHPWL(order, 3, window.index, nets);
+                double bestCost = currentCost - MOVE_TOLERANCE;
+                int best[3] = {-1, -1, -1};
+
+                std::sort(order, order + 3);
+                do
+                {
+                    double position = left;
+                    for (int cell : order)
+                    {
+                        this->x[cell] = position + this->cellWidths[cell] / 2.0;
+                        position += this->cellWidths[cell];
+                    }
+
+                    const double cost = this->getCellsHPWL(order, 3, window.index, nets);
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        std::copy(order, order + 3, best);
+                    }
+                } while (std::next_permutation(order, order + 3));
+
+                if (best[0] < 0)
+                {
+                    for (int k = 0; k < 3; k++)
+                    {
+                        this->x[cells[s + k]] = originalX[k];
+                    }
+                    continue;
+                }
+
+                double position = left;
+                for (int k = 0; k < 3; k++)
+                {
+                    this->x[best[k]] = position + this->cellWidths[best[k]] / 2.0;
+                    position += this->cellWidths[best[k]];
+                    cells[s + k] = best[k];
+                }
+                reorders++;
+            }
+        }
+
+        return reorders;
+    }
+
+    DetailedPlacementStatistics DetailedPlacer::place(double *x, double *y, double rowHeight, int passes)
+    {
+        this->x = x;
+        this->y = y;
+        this->rowHeight = rowHeight;
+
+        DetailedPlacementStatistics statistics;
+        statistics.initialHPWL = this->wirelengthEvaluator->calculateHPWL(x, y);
+
+        const double windowSize = DETAILED_WINDOW_ROWS * rowHeight;
+        std::vector<Window> windows;
+
+        for (int pass = 0; pass < passes; pass++)
+        {
+            this->buildWindows(windowSize, (pass % 2) * windowSize / 2, windows);
+
+            // Windows only write their own cells and read other cells from the start of the pass, so they can run in any order
+            std::vector<MoveCounts> counts(windows.size());
+            this->parallelFor(windows.size(), [&](long firstWindow, long lastWindow)
+            {
+                for (long w = firstWindow; w < lastWindow; w++)
+                {
+                    counts[w].swaps = this->globalSwap(windows[w]);
+                    counts[w].matchedCells = this->independentSetMatching(windows[w]);
+                    counts[w].reorders = this->localReordering(windows[w]);
+                }
+            });
+
+            for (const MoveCounts &count : counts)
+            {
+                statistics.swaps += count.swaps;
+                statistics.matchedCells += count.matchedCells;
+                statistics.reorders += count.reorders;
+            }
+        }
+
+        statistics.finalHPWL = this->wirelengthEvaluator->calculateHPWL(x, y);
+
+        this->x = nullptr;
+        this->y = nullptr;
+        return statistics;
+    }
+}
@@ -0,0 +1,327 @@
+#include "legalizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+
+namespace PA3Placement
+{
+    bool parseLegalizationMode(const std::string &name, LegalizationMode &mode)
+    {
+        if (name == "none")
+        {
+            mode = LegalizationMode::NONE;
+        }
+        else if (name == "tetris")
+        {
+            mode = LegalizationMode::TETRIS;
+        }
+        else if (name == "abacus")
+        {
+            mode = LegalizationMode::ABACUS;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    Legalizer::Legalizer(double width, double height, double rowHeight, double siteWidth)
+    {
+        this->width = width;
+        this->height = height;
+        this->rowHeight = rowHeight;
+        this->siteWidth = siteWidth;
+
+        this->rowCount = std::max(1, (int) std::floor(height / rowHeight + 0.5));
+        this->rowWidth = width;
+    }
+
+    int Legalizer::getNearestRow(double y) const
+    {
+        const double row = std::floor(y / this->rowHeight);
+
+        if (!(row >= 0))
+        {
+            return 0;
+        }
+
+        return row >= this->rowCount ? this->rowCount - 1 : (int) row;
+    }
+
+    double Legalizer::snapToSite(double x) const
+    {
+        return std::round(x / this->siteWidth) * this->siteWidth;
+    }
+
+    double Legalizer::clampClusterPosition(double x, double w) const
+    {
+        return std::min(std::max(x, 0.0), this->rowWidth - w);
+    }
+
+    double Legalizer::tryAbacus(const Row &row, double desiredX, double w, double e) const
+    {
+        // The cell starts a cluster of its own, which merges with the clusters to its left while they overlap
+        double clusterE = e;
+        double clusterQ = e * desiredX;
+        double clusterW = w;
+        double position = this->clampClusterPosition(desiredX, w);
+
+        for (int k = (int) row.clusters.size() - 1; k >= 0; k--)
+        {
+            const Cluster &previous = row.clusters[k];
+            if (previous.x + previous.w <= position)
+            {
+                break;
+            }
+
+            clusterQ = previous.q + clusterQ - clusterE * previous.w;
+            clusterE += previous.e;
+            clusterW += previous.w;
+            position = this->clampClusterPosition(clusterQ / clusterE, clusterW);
+        }
+
+        // The cell is the last one of the cluster
+        return position + clusterW - w;
+    }
+
+    void Legalizer::addAbacus(Row &row, int cell, double desiredX, double w, double e)
+    {
+        row.clusters.push_back({this->clampClusterPosition(desiredX, w), e, e * desiredX, w, (int) row.cells.size()});
+        row.cells.push_back(cell);
+        row.used += w;
+
+        // Collapse: merge the last cluster into its predecessor while they overlap
+        while (row.clusters.size() > 1)
+        {
+            Cluster &last = row.clusters.back();
+            Cluster &previous = row.clusters[row.clusters.size() - 2];
+
+            if (previous.x + previous.w <= last.x)
+            {
+                break;
+            }
+
+            previous.q += last.q - last.e * previous.w;
+            previous.e += last.e;
+            previous.w += last.w;
+            previous.x = this->clampClusterPosition(previous.q / previous.e, previous.w);
+            row.clusters.pop_back();
+        }
+    }
+
+    void Legalizer::legalizeTetris(const std::vector<long> &order, const double *x, const double *y, const int *widths,
+                                   double *legalX, double *legalY, LegalizationStatistics &statistics)
+    {
+        for (long cell : order)
+        {
+            const double w = widths[cell] * this->siteWidth;
+            const double desiredX = std::max(0.0, this->snapToSite(x[cell] - w / 2));
+            const int nearest = this->getNearestRow(y[cell]);
+
+            double bestCost = std::numeric_limits<double>::infinity();
+            int bestRow = -1;
+
+            for (int distance = 0; distance < this->rowCount; distance++)
+            {
+                const double verticalBound = std::max(0.0, distance - 0.5) * this->rowHeight;
+                if (bestRow >= 0 && verticalBound >= bestCost)
+                {
+                    break;
+                }
+
+                const int candidates[2] = {nearest - distance, nearest + distance};
+                for (int c = 0; c < (distance == 0 ? 1 : 2); c++)
+                {
+                    const int r = candidates[c];
+                    if (r < 0 || r >= this->rowCount)
+                    {
+                        continue;
+                    }
+
+                    const double placeX = std::max(desiredX, this->rows[r].used);
+                    if (placeX + w > this->rowWidth)
+                    {
+                        continue;
+                    }
+
+                    const double cost = std::abs(placeX - desiredX) + std::abs(this->getRowCenter(r) - y[cell]);
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestRow = r;
+                    }
+                }
+            }
+
+            if (bestRow < 0)
+            {
+                // Gaps left behind filled every row up, continue past the end of the least used one
+                bestRow = 0;
+                for (int r = 1; r < this->rowCount; r++)
+                {
+                    if (this->rows[r].used < this->rows[bestRow].used)
+                    {
+                        bestRow = r;
+                    }
+                }
+                statistics.cellsOutsideRows++;
+            }
+
+            const double placeX = std::max(desiredX, this->rows[bestRow].used);
+            this->rows[bestRow].used = placeX + w;
+
+            legalX[cell] = placeX + w / 2;
+            legalY[cell] = this->getRowCenter(bestRow);
+        }
+    }
+
+    void Legalizer::legalizeAbacus(const std::vector<long> &order, const double *x, const double *y, const int *widths,
+                                   double *legalX, double *legalY)
+    {
+        for (long cell : order)
+        {
+            const double w = widths[cell] * this->siteWidth;
+            const double desiredX = x[cell] - w / 2;
+            // Wide cells are heavier, so they move less
+            const double e = std::max(1, widths[cell]);
+            const int nearest = this->getNearestRow(y[cell]);
+
+            double bestCost = std::numeric_limits<double>::infinity();
+            int bestRow = -1;
+
+            for (int distance = 0; distance < this->rowCount; distance++)
+            {
+                const double verticalBound = std::max(0.0, distance - 0.5) * this->rowHeight;
+                if (bestRow >= 0 && verticalBound * verticalBound >= bestCost)
+                {
+                    break;
+                }
+
+                const int candidates[2] = {nearest - distance, nearest + distance};
+                for (int c = 0; c < (distance == 0 ? 1 : 2); c++)
+                {
+                    const int r = candidates[c];
+                    if (r < 0 || r >= this->rowCount || this->rows[r].used + w > this->rowWidth)
+                    {
+                        continue;
+                    }
+
+                    const double dx = this->tryAbacus(this->rows[r], desiredX, w, e) - desiredX;
+                    const double dy = this->getRowCenter(r) - y[cell];
+                    const double cost = dx * dx + dy * dy;
+                    if (cost < bestCost)
+                    {
+                        bestCost = cost;
+                        bestRow = r;
+                    }
+                }
+            }
+
+            // The rows are wide enough that some row always has room
+            this->addAbacus(this->rows[bestRow], (int) cell, desiredX, w, e);
+        }
+
+        for (int r = 0; r < this->rowCount; r++)
+        {
+            const Row &row = this->rows[r];
+
+            // Cells get their positions from their clusters, then move to whole sites: first no cell may
+            // start before the previous one ends, then no cell may end after the next one starts
+            std::vector<double> left(row.cells.size());
+            for (size_t k = 0; k < row.clusters.size(); k++)
+            {
+                const int end = (k + 1 < row.clusters.size()) ? row.clusters[k + 1].firstCell : (int) row.cells.size();
+
+                double position = row.clusters[k].x;
+                for (int i = row.clusters[k].firstCell; i < end; i++)
+                {
+                    left[i] = position;
+                    position += widths[row.cells[i]] * this->siteWidth;
+                }
+            }
+
+            double previousEnd = 0;
+            for (size_t i = 0; i < row.cells.size(); i++)
+            {
+                left[i] = std::max(this->snapToSite(left[i]), previousEnd);
+                previousEnd = left[i] + widths[row.cells[i]] * this->siteWidth;
+            }
+
+            double nextStart = this->rowWidth;
+            for (size_t i = row.cells.size(); i-- > 0;)
+            {
+                const double w = widths[row.cells[i]] * this->siteWidth;
+
+                left[i] = std::min(left[i], nextStart - w);
+                nextStart = left[i];
+
+                legalX[row.cells[i]] = left[i] + w / 2;
+                legalY[row.cells[i]] = this->getRowCenter(r);
+            }
+        }
+    }
+
+    LegalizationStatistics Legalizer::legalize(LegalizationMode mode, const double *x, const double *y, const int *widths, long count,
+                                               double *legalX, double *legalY)
+    {
+        LegalizationStatistics statistics;
+
+        // Make the rows wide enough that, whatever the order, some row always has room for the next cell
+        double totalWidth = 0;
+        double maximumWidth = 0;
+        for (long i = 0; i < count; i++)
+        {
+            totalWidth += widths[i] * this->siteWidth;
+            maximumWidth = std::max(maximumWidth, widths[i] * this->siteWidth);
+        }
+
+        this->rowWidth = std::max(this->snapToSite(this->width),
+                                  std::ceil((totalWidth / this->rowCount + maximumWidth) / this->siteWidth) * this->siteWidth);
+        this->rows.assign(this->rowCount, Row());
+
+        statistics.rows = this->rowCount;
+        statistics.rowWidth = this->rowWidth;
+
+        if (mode == LegalizationMode::NONE)
+        {
+            std::copy(x, x + count, legalX);
+            std::copy(y, y + count, legalY);
+            return statistics;
+        }
+
+        // Left to right by left edge
+        std::vector<double> leftEdge(count);
+        for (long i = 0; i < count; i++)
+        {
+            leftEdge[i] = x[i] - widths[i] * this->siteWidth / 2;
+        }
+
+        std::vector<long> order(count);
+        std::iota(order.begin(), order.end(), 0);
+        std::stable_sort(order.begin(), order.end(), [&](long a, long b) { return leftEdge[a] < leftEdge[b]; });
+
+        if (mode == LegalizationMode::TETRIS)
+        {
+            this->legalizeTetris(order, x, y, widths, legalX, legalY, statistics);
+        }
+        else
+        {
+            this->legalizeAbacus(order, x, y, widths, legalX, legalY);
+        }
+
+        for (long i = 0; i < count; i++)
+        {
+            const double displacement = std::abs(legalX[i] - x[i]) + std::abs(legalY[i] - y[i]);
+
+            statistics.totalDisplacement += displacement;
+            statistics.maximumDisplacement = std::max(statistics.maximumDisplacement, displacement);
+        }
+
+        this->rows.clear();
+        return statistics;
+    }
+}
@@ -7,9 +7,11 @@
 #include<stdio.h>
 #include<vector>
 #include <string.h>
+#include <stdlib.h>
 #include "suraj_parser.h"
 
 #include "placer.hpp"
+#include "vectorkernels.hpp"
 
 using namespace std;
 
@@ -20,11 +22,110 @@ int main(int argv, char *argc[])
     char innetFileName[100];
     char inPadLocationFileName[100];
 
-    if (argv!=2) {
+    if (argv < 2) {
         cout << "Please provide a circuit file name with no extension." << endl;
+        cout << "Usage: " << argc[0] << " <circuit> [--preconditioner none|jacobi|ssor|ic0] [--ssor-omega w] [--threads n] [--simd auto|scalar|sse2|avx2|avx512] [--global-iterations n] [--anchor-weight w] [--target-density d] [--target-overflow f] [--bins n|XxY] [--spreading shift|electrostatic] [--density-bins n] [--global-placement quadratic|nesterov] [--nesterov-iterations n] [--legalize none|tetris|abacus] [--detailed-passes n]" << endl;
         return 1;
     }
 
+    PA3Placement::PlacerSettings settings;
+
+    for (int i = 2; i < argv; i++) {
+        if (strcmp(argc[i], "--preconditioner") == 0 && i + 1 < argv) {
+            if (!PA3Placement::parsePreconditionerType(argc[++i], settings.preconditioner)) {
+                cout << "Unknown preconditioner " << argc[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--ssor-omega") == 0 && i + 1 < argv) {
+            settings.ssorOmega = atof(argc[++i]);
+            if (settings.ssorOmega <= 0 || settings.ssorOmega >= 2) {
+                cout << "SSOR omega must be between 0 and 2" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--threads") == 0 && i + 1 < argv) {
+            settings.threadCount = atoi(argc[++i]);
+            if (settings.threadCount < 1) {
+                cout << "Thread count must be at least 1" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--simd") == 0 && i + 1 < argv) {
+            if (!PA3Placement::selectVectorKernels(argc[++i])) {
+                cout << "Unknown or unsupported instruction set " << argc[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--global-iterations") == 0 && i + 1 < argv) {
+            settings.globalIterations = atoi(argc[++i]);
+            if (settings.globalIterations < 0) {
+                cout << "Global iteration count must not be negative" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--anchor-weight") == 0 && i + 1 < argv) {
+            settings.anchorWeight = atof(argc[++i]);
+            if (settings.anchorWeight <= 0) {
+                cout << "Anchor weight must be positive" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--target-density") == 0 && i + 1 < argv) {
+            settings.targetDensity = atof(argc[++i]);
+            if (settings.targetDensity <= 0 || settings.targetDensity > 1) {
+                cout << "Target density must be in (0, 1]" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--target-overflow") == 0 && i + 1 < argv) {
+            settings.targetOverflow = atof(argc[++i]);
+            if (settings.targetOverflow < 0) {
+                cout << "Target overflow must not be negative" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--bins") == 0 && i + 1 < argv) {
+            const char *bins = argc[++i];
+            int matched = sscanf(bins, "%dx%d", &settings.binsX, &settings.binsY);
+            if (matched == 1) {
+                settings.binsY = settings.binsX;
+            }
+            if (matched < 1 || settings.binsX < 1 || settings.binsY < 1) {
+                cout << "Bin grid must be given as n or XxY with positive sizes, e.g. 256 or 128x64" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--spreading") == 0 && i + 1 < argv) {
+            if (!PA3Placement::parseSpreadingMethod(argc[++i], settings.spreading)) {
+                cout << "Unknown spreading method " << argc[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--density-bins") == 0 && i + 1 < argv) {
+            settings.densityBins = atoi(argc[++i]);
+            if (settings.densityBins < 1) {
+                cout << "Density grid size must be at least 1" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--global-placement") == 0 && i + 1 < argv) {
+            if (!PA3Placement::parseGlobalPlacementMode(argc[++i], settings.globalPlacement)) {
+                cout << "Unknown global placement mode " << argc[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--nesterov-iterations") == 0 && i + 1 < argv) {
+            settings.nesterovIterations = atoi(argc[++i]);
+            if (settings.nesterovIterations < 0) {
+                cout << "Nesterov iteration count must not be negative" << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--legalize") == 0 && i + 1 < argv) {
+            if (!PA3Placement::parseLegalizationMode(argc[++i], settings.legalization)) {
+                cout << "Unknown legalization mode " << argc[i] << endl;
+                return 1;
+            }
+        } else if (strcmp(argc[i], "--detailed-passes") == 0 && i + 1 < argv) {
+            settings.detailedPasses = atoi(argc[++i]);
+            if (settings.detailedPasses < 0) {
+                cout << "Detailed placement pass count must not be negative" << endl;
+                return 1;
+            }
+        } else {
+            cout << "Unknown option " << argc[i] << endl;
+            return 1;
+        }
+    }
+
     cout << "Reading circuit file " << argc[1] << endl;
 
     strcpy (inareFileName, argc[1]);
@@ -34,22 +135,18 @@ int main(int argv, char *argc[])
     strcpy(inPadLocationFileName,argc[1]);
     strcat(inPadLocationFileName,".kiaPad");
 
-    int success = parseIbmFile(inareFileName, innetFileName, inPadLocationFileName);
+    PA3Placement::Hypergraph hypergraph;
+    int success = parseIbmFile(inareFileName, innetFileName, inPadLocationFileName, hypergraph);
     if (success == -1) {
         cout << "Error reading input file(s)" << endl;
         return 0;
     }
 
-    printf("\nNumber of vertices,hyper = %d %d\n",numCellsAndPads,numhyper);
+    printf("\nNumber of vertices,hyper = %d %d\n",hypergraph.numCellsAndPads,hypergraph.numhyper);
 
 
     // call function(s) dealing with creating the Q matrix, placement, etc.
 
-    PA3Placement::AnalyticPlacer placer;
+    PA3Placement::AnalyticPlacer placer(hypergraph, settings);
     placer.doPlacement(argc[1]);
-
-    free(pinLocations);
-    free(hEdge_idxToFirstEntryInPinArray);
-    free(cellPinArray);
-    free(hyperwts);
 }
@@ -0,0 +1,153 @@
+#include "mappedfile.hpp"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace PA3Placement
+{
+    static inline bool isSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    static inline bool isLineSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\v' || c == '\f';
+    }
+
+    MappedFile::MappedFile(const char *fileName)
+    {
+        this->data = nullptr;
+        this->size = 0;
+        this->fileDescriptor = open(fileName, O_RDONLY);
+
+        if (this->fileDescriptor < 0)
+        {
+            return;
+        }
+
+        struct stat status;
+        if (fstat(this->fileDescriptor, &status) != 0)
+        {
+            close(this->fileDescriptor);
+            this->fileDescriptor = -1;
+            return;
+        }
+
+        // Empty files cannot be mapped, they simply have no contents. The pages are mapped up front
+        // instead of faulting in one at a time while parsing.
+        if (status.st_size > 0)
+        {
+            void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE | MAP_POPULATE, this->fileDescriptor, 0);
+            if (mapping == MAP_FAILED)
+            {
+                close(this->fileDescriptor);
+                this->fileDescriptor = -1;
+                return;
+            }
+
+            // Parsers read the file once from start to end
+            madvise(mapping, status.st_size, MADV_SEQUENTIAL);
+
+            this->data = static_cast<const char*>(mapping);
+            this->size = static_cast<size_t>(status.st_size);
+        }
+    }
+
+    MappedFile::~MappedFile()
+    {
+        if (this->data != nullptr)
+        {
+            munmap(const_cast<char*>(this->data), this->size);
+        }
+        if (this->fileDescriptor >= 0)
+        {
+            close(this->fileDescriptor);
+        }
+    }
+
+    bool TextCursor::nextToken(const char *&token, size_t &length)
+    {
+        while (this->position < this->end && isSpace(*this->position))
+        {
+            this->position++;
+        }
+
+        if (this->position >= this->end)
+        {
+            return false;
+        }
+
+        token = this->position;
+        while (this->position < this->end && !isSpace(*this->position))
+        {
+            this->position++;
+        }
+        length = this->position - token;
+
+        return true;
+    }
+
+    bool TextCursor::nextInt(int &value)
+    {
+        const char *token;
+        size_t length;
+        if (!this->nextToken(token, length))
+        {
+            return false;
+        }
+
+        size_t i = 0;
+        const bool negative = token[0] == '-';
+        if (negative || token[0] == '+')
+        {
+            i++;
+        }
+        if (i == length)
+        {
+            return false;
+        }
+
+        long result = 0;
+        for (; i < length; i++)
+        {
+            if (token[i] < '0' || token[i] > '9')
+            {
+                return false;
+            }
+            result = result * 10 + (token[i] - '0');
+        }
+
+        value = static_cast<int>(negative ? -result : result);
+        return true;
+    }
+
+    bool TextCursor::nextTokenOnLine(const char *&token, size_t &length)
+    {
+        while (this->position < this->end && isLineSpace(*this->position))
+        {
+            this->position++;
+        }
+
+        if (this->position >= this->end || *this->position == '\n')
+        {
+            return false;
+        }
+
+        return this->nextToken(token, length);
+    }
+
+    void TextCursor::skipLine()
+    {
+        while (this->position < this->end && *this->position != '\n')
+        {
+            this->position++;
+        }
+        if (this->position < this->end)
+        {
+            this->position++;
+        }
+    }
+}
@@ -2,6 +2,7 @@
 // Created by Alejandro Zeise on 12/11/23.
 //
 #include "matrix.hpp"
+#include "vectorkernels.hpp"
 
 #include <algorithm>
 #include <iomanip>
@@ -292,8 +293,544 @@ namespace PA3Placement
         return this->height;
     }
 
-    QMatrix::QMatrix(int numCellsNoPads, int numCellsAndPads, int numHyperedges, int *cellPinArray,
-                     int *hEdgesToFirstMemberCellArray, int *hEdgeWeights) : Matrix2D<double>(1, numCellsNoPads) // We will be resizing the Matrix anyway later
+    template <typename T>
+    SymmetricSparseMatrix<T>::SymmetricSparseMatrix(long size)
+    {
+        this->size = 0;
+        this->rowStart.push_back(0);
+
+        // Every row stores at least its diagonal, start out as an all-zero matrix
+        for (long i = 0; i < size; i++)
+        {
+            this->startRow(0);
+        }
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::reserve(long nonZeros)
+    {
+        this->columnIndices.reserve(nonZeros);
+        this->values.reserve(nonZeros);
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::clear()
+    {
+        this->size = 0;
+        this->rowStart.assign(1, 0);
+        this->columnIndices.clear();
+        this->values.clear();
+
+        this->lowerRowStart.clear();
+        this->lowerColumnIndices.clear();
+        this->lowerValues.clear();
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::startRow(T diagonal)
+    {
+        if (this->hasTransposeIndex())
+        {
+            this->lowerRowStart.clear();
+            this->lowerColumnIndices.clear();
+            this->lowerValues.clear();
+        }
+
+        // Diagonal is always the first entry of a row
+        this->columnIndices.push_back(this->size);
+        this->values.push_back(diagonal);
+
+        this->size++;
+        this->rowStart.push_back(this->values.size());
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::appendToRow(int column, T value)
+    {
+        assert(this->size > 0);
+        assert(column > this->columnIndices.back());
+        assert(!this->hasTransposeIndex());
+
+        this->columnIndices.push_back(column);
+        this->values.push_back(value);
+        this->rowStart.back() = this->values.size();
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::assembleFromTriplets(const std::vector<T> &diagonal, const std::vector<std::vector<MatrixTriplet<T>>> &tripletLists)
+    {
+        const long n = diagonal.size();
+
+        long tripletCount = 0;
+        for (const auto &triplets : tripletLists)
+        {
+            tripletCount += triplets.size();
+        }
+
+        // Counting sort by column, then by row. Both passes are stable, so the triplets end up
+        // ordered by (row, column) with repeated entries still in their original order
+        std::vector<long> bucketStart(n + 1, 0);
+        std::vector<MatrixTriplet<T>> byColumn(tripletCount);
+
+        for (const auto &triplets : tripletLists)
+        {
+            for (const auto &triplet : triplets)
+            {
+                assert(triplet.row < triplet.column && triplet.column < n);
+                bucketStart[triplet.column + 1]++;
+            }
+        }
+        for (long i = 0; i < n; i++)
+        {
+            bucketStart[i + 1] += bucketStart[i];
+        }
+        for (const auto &triplets : tripletLists)
+        {
+            for (const auto &triplet : triplets)
+            {
+                byColumn[bucketStart[triplet.column]++] = triplet;
+            }
+        }
+
+        std::vector<MatrixTriplet<T>> sorted(tripletCount);
+
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for (const auto &triplet : byColumn)
+        {
+            bucketStart[triplet.row + 1]++;
+        }
+        for (long i = 0; i < n; i++)
+        {
+            bucketStart[i + 1] += bucketStart[i];
+        }
+        for (const auto &triplet : byColumn)
+        {
+            sorted[bucketStart[triplet.row]++] = triplet;
+        }
+
+        this->clear();
+        this->reserve(n + tripletCount);
+
+        long next = 0;
+        for (long i = 0; i < n; i++)
+        {
+            this->startRow(diagonal[i]);
+
+            while (next < tripletCount && sorted[next].row == i)
+            {
+                // Sum up repeated entries
+                const int column = sorted[next].column;
+                T value = 0;
+
+                while (next < tripletCount && sorted[next].row == i && sorted[next].column == column)
+                {
+                    value += sorted[next].value;
+                    next++;
+                }
+
+                this->appendToRow(column, value);
+            }
+        }
+    }
+
+    template <typename T>
+    long SymmetricSparseMatrix<T>::findEntry(long row, long column) const
+    {
+        // Only the upper triangle is stored
+        if (column < row)
+        {
+            std::swap(row, column);
+        }
+
+        const long start = this->rowStart[row];
+        const long end = this->rowStart[row + 1];
+
+        if (column == row)
+        {
+            return start;
+        }
+
+        // Off-diagonal columns (after the diagonal) are sorted
+        auto first = this->columnIndices.begin() + start + 1;
+        auto last = this->columnIndices.begin() + end;
+        auto found = std::lower_bound(first, last, column);
+
+        if (found != last && *found == column)
+        {
+            return found - this->columnIndices.begin();
+        }
+
+        return -1;
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::multiply(const T *x, T *y) const
+    {
+        std::fill(y, y + this->size, 0);
+
+        for (long i = 0; i < this->size; i++)
+        {
+            const long start = this->rowStart[i];
+            const long end = this->rowStart[i + 1];
+            const T xi = x[i];
+
+            T sum = this->values[start] * xi;
+
+            // Each stored off-diagonal entry (i, j) also stands in for its mirror (j, i)
+            for (long k = start + 1; k < end; k++)
+            {
+                const int j = this->columnIndices[k];
+                const T a = this->values[k];
+
+                sum += a * x[j];
+                y[j] += a * xi;
+            }
+
+            y[i] += sum;
+        }
+    }
+
+    template <typename T>
+    T SymmetricSparseMatrix<T>::multiplyAndDot(const T *x, T *y) const
+    {
+        T dot = 0;
+
+        std::fill(y, y + this->size, 0);
+
+        for (long i = 0; i < this->size; i++)
+        {
+            const long start = this->rowStart[i];
+            const long end = this->rowStart[i + 1];
+            const T xi = x[i];
+
+            T sum = this->values[start] * xi;
+
+            for (long k = start + 1; k < end; k++)
+            {
+                const int j = this->columnIndices[k];
+                const T a = this->values[k];
+
+                sum += a * x[j];
+                y[j] += a * xi;
+            }
+
+            // Rows before i have already scattered into y[i], and rows after i only
+            // scatter into later elements, so y[i] is final here
+            y[i] += sum;
+            dot += xi * y[i];
+        }
+
+        return dot;
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::multiplyPairAndDot(const T *x1, const T *x2, T *y1, T *y2, T *dots) const
+    {
+        T dot1 = 0;
+        T dot2 = 0;
+
+        std::fill(y1, y1 + this->size, 0);
+        std::fill(y2, y2 + this->size, 0);
+
+        for (long i = 0; i < this->size; i++)
+        {
+            const long start = this->rowStart[i];
+            const long end = this->rowStart[i + 1];
+            const T x1i = x1[i];
+            const T x2i = x2[i];
+
+            T sum1 = this->values[start] * x1i;
+            T sum2 = this->values[start] * x2i;
+
+            for (long k = start + 1; k < end; k++)
+            {
+                const int j = this->columnIndices[k];
+                const T a = this->values[k];
+
+                sum1 += a * x1[j];
+                sum2 += a * x2[j];
+                y1[j] += a * x1i;
+                y2[j] += a * x2i;
+            }
+
+            y1[i] += sum1;
+            y2[i] += sum2;
+            dot1 += x1i * y1[i];
+            dot2 += x2i * y2[i];
+        }
+
+        dots[0] = dot1;
+        dots[1] = dot2;
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::buildTransposeIndex()
+    {
+        const long offDiagonal = this->getNonZeroCount() - this->size;
+
+        this->lowerRowStart.assign(this->size + 1, 0);
+        this->lowerColumnIndices.resize(offDiagonal);
+        this->lowerValues.resize(offDiagonal);
+
+        // Count the entries of each lower row (column of the upper triangle)
+        for (long i = 0; i < this->size; i++)
+        {
+            for (long k = this->rowStart[i] + 1; k < this->rowStart[i + 1]; k++)
+            {
+                this->lowerRowStart[this->columnIndices[k] + 1]++;
+            }
+        }
+
+        for (long i = 0; i < this->size; i++)
+        {
+            this->lowerRowStart[i + 1] += this->lowerRowStart[i];
+        }
+
+        // Fill, upper rows are visited in order so every lower row comes out sorted
+        std::vector<long> next(this->lowerRowStart.begin(), this->lowerRowStart.end() - 1);
+        for (long i = 0; i < this->size; i++)
+        {
+            for (long k = this->rowStart[i] + 1; k < this->rowStart[i + 1]; k++)
+            {
+                const long position = next[this->columnIndices[k]]++;
+
+                this->lowerColumnIndices[position] = i;
+                this->lowerValues[position] = this->values[k];
+            }
+        }
+    }
+
+    template <typename T>
+    T SymmetricSparseMatrix<T>::multiplyRowsAndDot(const T *x, T *y, long begin, long end) const
+    {
+        assert(this->hasTransposeIndex());
+
+        T dot = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            T sum = 0;
+
+            for (long k = this->lowerRowStart[i]; k < this->lowerRowStart[i + 1]; k++)
+            {
+                sum += this->lowerValues[k] * x[this->lowerColumnIndices[k]];
+            }
+
+            // Upper part, starting with the diagonal
+            for (long k = this->rowStart[i]; k < this->rowStart[i + 1]; k++)
+            {
+                sum += this->values[k] * x[this->columnIndices[k]];
+            }
+
+            y[i] = sum;
+            dot += x[i] * sum;
+        }
+
+        return dot;
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::multiplyPairRowsAndDot(const T *x1, const T *x2, T *y1, T *y2, long begin, long end, T *dots) const
+    {
+        assert(this->hasTransposeIndex());
+
+        T dot1 = 0;
+        T dot2 = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            T sum1 = 0;
+            T sum2 = 0;
+
+            for (long k = this->lowerRowStart[i]; k < this->lowerRowStart[i + 1]; k++)
+            {
+                const int j = this->lowerColumnIndices[k];
+                sum1 += this->lowerValues[k] * x1[j];
+                sum2 += this->lowerValues[k] * x2[j];
+            }
+
+            for (long k = this->rowStart[i]; k < this->rowStart[i + 1]; k++)
+            {
+                const int j = this->columnIndices[k];
+                sum1 += this->values[k] * x1[j];
+                sum2 += this->values[k] * x2[j];
+            }
+
+            y1[i] = sum1;
+            y2[i] = sum2;
+            dot1 += x1[i] * sum1;
+            dot2 += x2[i] * sum2;
+        }
+
+        dots[0] = dot1;
+        dots[1] = dot2;
+    }
+
+    // double matrices use the SIMD kernels for the row products
+    template <>
+    double SymmetricSparseMatrix<double>::multiplyRowsAndDot(const double *x, double *y, long begin, long end) const
+    {
+        assert(this->hasTransposeIndex());
+
+        const CompressedRows upper = {this->rowStart.data(), this->columnIndices.data(), this->values.data()};
+        const CompressedRows lower = {this->lowerRowStart.data(), this->lowerColumnIndices.data(), this->lowerValues.data()};
+
+        return getVectorKernels().sparseRowsAndDot(upper, lower, begin, end, x, y);
+    }
+
+    template <>
+    void SymmetricSparseMatrix<double>::multiplyPairRowsAndDot(const double *x1, const double *x2, double *y1, double *y2, long begin, long end, double *dots) const
+    {
+        assert(this->hasTransposeIndex());
+
+        const CompressedRows upper = {this->rowStart.data(), this->columnIndices.data(), this->values.data()};
+        const CompressedRows lower = {this->lowerRowStart.data(), this->lowerColumnIndices.data(), this->lowerValues.data()};
+
+        getVectorKernels().sparseRowsPairAndDot(upper, lower, begin, end, x1, x2, y1, y2, dots);
+    }
+
+    template <typename T>
+    std::vector<long> SymmetricSparseMatrix<T>::partitionRows(int parts) const
+    {
+        assert(parts >= 1);
+
+        // Work for a row is its stored entries, its mirrored entries, and one unit for the vector updates
+        auto rowWork = [this](long row) {
+            long work = this->rowStart[row + 1] - this->rowStart[row] + 1;
+            if (this->hasTransposeIndex())
+            {
+                work += this->lowerRowStart[row + 1] - this->lowerRowStart[row];
+            }
+            return work;
+        };
+
+        long totalWork = 0;
+        for (long i = 0; i < this->size; i++)
+        {
+            totalWork += rowWork(i);
+        }
+
+        std::vector<long> boundaries(parts + 1, this->size);
+        boundaries[0] = 0;
+
+        long row = 0;
+        long accumulated = 0;
+        for (int part = 1; part < parts; part++)
+        {
+            const long target = totalWork * part / parts;
+            while (row < this->size && accumulated < target)
+            {
+                accumulated += rowWork(row++);
+            }
+            boundaries[part] = row;
+        }
+
+        return boundaries;
+    }
+
+    template <typename T>
+    ColumnMatrix<T> SymmetricSparseMatrix<T>::operator*(const ColumnMatrix<T> &rhs) const
+    {
+        assert(this->getWidth() == rhs.getHeight());
+
+        ColumnMatrix<T> result(this->getHeight(), 0);
+        this->multiply(rhs.getData(), result.getData());
+
+        return result;
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::addRow()
+    {
+        // New row/column only has a zero diagonal
+        this->startRow(0);
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::display(std::ostream &out) const
+    {
+        for(int i = 0; i < this->getHeight(); i++)
+        {
+            for (int j = 0; j < this->getWidth(); j++)
+            {
+                out << std::setw(3) << std::setprecision(3) << std::fixed << this->get(j, i) << " ";
+            }
+            out << std::endl;
+        }
+    }
+
+    template <typename T>
+    void SymmetricSparseMatrix<T>::set(long x, long y, T value)
+    {
+        assert(x >= 0 && x < this->size);
+        assert(y >= 0 && y < this->size);
+
+        long index = this->findEntry(y, x);
+        if (index >= 0)
+        {
+            this->values[index] = value;
+
+            if (this->hasTransposeIndex() && x != y)
+            {
+                // Keep the mirror in sync
+                const long row = std::max(x, y);
+                const long column = std::min(x, y);
+                auto first = this->lowerColumnIndices.begin() + this->lowerRowStart[row];
+                auto last = this->lowerColumnIndices.begin() + this->lowerRowStart[row + 1];
+
+                this->lowerValues[std::lower_bound(first, last, column) - this->lowerColumnIndices.begin()] = value;
+            }
+            return;
+        }
+
+        // Structure changes, the mirror would have to be rebuilt
+        this->lowerRowStart.clear();
+        this->lowerColumnIndices.clear();
+        this->lowerValues.clear();
+
+        // Not stored yet, insert it into the upper triangle keeping the columns sorted
+        const long row = std::min(x, y);
+        const long column = std::max(x, y);
+
+        auto first = this->columnIndices.begin() + this->rowStart[row] + 1;
+        auto last = this->columnIndices.begin() + this->rowStart[row + 1];
+        index = std::lower_bound(first, last, column) - this->columnIndices.begin();
+
+        this->columnIndices.insert(this->columnIndices.begin() + index, column);
+        this->values.insert(this->values.begin() + index, value);
+
+        for (long i = row + 1; i <= this->size; i++)
+        {
+            this->rowStart[i]++;
+        }
+    }
+
+    template <typename T>
+    T SymmetricSparseMatrix<T>::get(long x, long y) const
+    {
+        assert(x >= 0 && x < this->size);
+        assert(y >= 0 && y < this->size);
+
+        long index = this->findEntry(y, x);
+
+        return (index >= 0) ? this->values[index] : 0;
+    }
+
+    template <typename T>
+    long SymmetricSparseMatrix<T>::getHeight() const
+    {
+        return this->size;
+    }
+
+    template <typename T>
+    long SymmetricSparseMatrix<T>::getWidth() const
+    {
+        return this->size;
+    }
+
+    QMatrix::QMatrix(int numCellsNoPads, int numCellsAndPads, int numHyperedges, const int *cellPinArray,
+                     const int *hEdgesToFirstMemberCellArray, const int *hEdgeWeights, ThreadPool *threadPool)
+                     : SymmetricSparseMatrix<double>(0) // Rows are added once all connections are known
     {
         this->numCellsNoPads = numCellsNoPads;
         this->numCellsAndPads = numCellsAndPads;
@@ -302,10 +839,7 @@ namespace PA3Placement
         this->hEdgesToFirstMemberCellArray = hEdgesToFirstMemberCellArray;
         this->hEdgeWeights = hEdgeWeights;
 
-        // Will be resized later to account for added star nodes
-        cellConnectionsList = WeightedCellConnectionsList(numCellsAndPads);
-
-        this->generate();
+        this->generate(threadPool);
     }
 
     int QMatrix::getStarNodeCount() const
@@ -313,55 +847,127 @@ namespace PA3Placement
         return this->numStars;
     }
 
-    QMatrix::WeightedCellConnectionsList* QMatrix::getCellConnectionsList()
+    const std::vector<QMatrix::PadConnection>& QMatrix::getPadConnections() const
     {
-        return &this->cellConnectionsList;
+        return this->padConnections;
     }
 
-    void QMatrix::calculateNumberOfStarNodes()
+    void QMatrix::setAnchorWeights(const std::vector<double> &weights)
+    {
+        assert(static_cast<long>(weights.size()) == this->getHeight());
+
+        if (this->baseDiagonal.empty())
+        {
+            this->baseDiagonal.resize(this->getHeight());
+            for (long i = 0; i < this->getHeight(); i++)
+            {
+                this->baseDiagonal[i] = this->getDiagonal(i);
+            }
+        }
+
+        for (long i = 0; i < this->getHeight(); i++)
+        {
+            this->setDiagonal(i, this->baseDiagonal[i] + weights[i]);
+        }
+    }
+
+    double QMatrix::getConnectionWeight(long row) const
+    {
+        return this->baseDiagonal.empty() ? this->getDiagonal(row) : this->baseDiagonal[row];
+    }
+
+    bool QMatrix::isStarHyperedge(int degree)
+    {
+        return degree > STAR_MODEL_THRESHOLD;
+    }
+
+    void QMatrix::calculateNumberOfStarNodes(int firstHyperedge, int lastHyperedge, ConnectionBuffer &buffer) const
     {
-#ifdef DEBUG
-        std::cout << "Calculating number of star nodes to add." << std::endl;
-#endif
         /*
          * First iterate through each hyperedge, and determine it's degree
          * If the degree is greater than 3 then we use a star model (which adds a node),
          * otherwise we use clique.
          */
-        for (int i = 0; i < this->numHyperedges; i++)
+        long cliqueConnections = 0;
+        long starConnections = 0;
+        for (int i = firstHyperedge; i < lastHyperedge; i++)
         {
             // Degree of the hyperedge is the element at index i subtracted from element at i + 1
             // The last element in the hyperedge array is the total number of pins
             int degree = this->hEdgesToFirstMemberCellArray[i + 1] - this->hEdgesToFirstMemberCellArray[i];
             if (degree > STAR_MODEL_THRESHOLD)
             {
-                // Add row to matrix, since we are adding a node
-                this->addRow();
-                this->numStars++;
+                // Star model adds a node (row/column in the matrix)
+                buffer.numStars++;
+                starConnections += degree;
+            }
+            else
+            {
+                // Else we use clique, doesn't affect matrix dimensions
+                cliqueConnections += static_cast<long>(degree) * (degree - 1) / 2;
             }
-            // Else we use clique, doesn't affect matrix dimensions
         }
 
+        // Upper bound on the number of connections, most of them are between movable cells
+        buffer.triplets.reserve(cliqueConnections + starConnections);
+    }
+
+    void QMatrix::generate(ThreadPool *threadPool)
+    {
 #ifdef DEBUG
-        std::cout << "Resizing Matrix width" << std::endl;
+        std::cout << "Calculating number of star nodes to add." << std::endl;
 #endif
+        const int chunkCount = (nullptr != threadPool) ? threadPool->getThreadCount() : 1;
+        const int totalPins = this->hEdgesToFirstMemberCellArray[this->numHyperedges];
 
-        // Resize matrix (and cellConnectionsList) due to our added star nodes
-        this->resizeWidth(this->numCellsNoPads + this->numStars);
-        this->cellConnectionsList.resize(this->numCellsAndPads + this->numStars);
-    }
+        // Thread i processes the hyperedges [chunkStart[i], chunkStart[i + 1]), chunks have about the same number of pins
+        std::vector<int> chunkStart(chunkCount + 1);
+        for (int i = 0; i <= chunkCount; i++)
+        {
+            const long pinBoundary = static_cast<long>(totalPins) * i / chunkCount;
+            chunkStart[i] = std::lower_bound(this->hEdgesToFirstMemberCellArray, this->hEdgesToFirstMemberCellArray + this->numHyperedges,
+                                             pinBoundary) - this->hEdgesToFirstMemberCellArray;
+        }
+        chunkStart[chunkCount] = this->numHyperedges;
 
-    void QMatrix::generate()
-    {
-        // First star node will be after the last cell
-        const int firstStarIndex = this->numCellsNoPads;
+        std::vector<ConnectionBuffer> buffers(chunkCount);
+        auto runChunks = [&](const std::function<void(int)> &task) {
+            if (nullptr != threadPool)
+            {
+                threadPool->run(task);
+            }
+            else
+            {
+                task(0);
+            }
+        };
+
+        // Calculate the number of star nodes each chunk will need, and reserve room for the connections
+        runChunks([&](int chunk) {
+            this->calculateNumberOfStarNodes(chunkStart[chunk], chunkStart[chunk + 1], buffers[chunk]);
+        });
+
+        // First star node will be after the last cell, stars are numbered in hyperedge order
+        // no matter how the hyperedges were split up
+        std::vector<int> chunkFirstStar(chunkCount);
+        this->numStars = 0;
+        for (int i = 0; i < chunkCount; i++)
+        {
+            chunkFirstStar[i] = this->numCellsNoPads + this->numStars;
+            this->numStars += buffers[i].numStars;
+        }
 
-        // Calculate the number of star nodes we will need, and resize ourself to accomodate
-        // This also creates the required row/cols in the matrix for the new star nodes
-        this->calculateNumberOfStarNodes();
+        runChunks([&](int chunk) {
+            this->processHyperedges(chunkStart[chunk], chunkStart[chunk + 1], chunkFirstStar[chunk], buffers[chunk]);
+        });
 
-        // Iterate through each hyperedge, now populating the Q matrix
-        for (int i = 0, currentStar = firstStarIndex; i < this->numHyperedges; i++)
+        this->assembleSparseMatrix(buffers);
+    }
+
+    void QMatrix::processHyperedges(int firstHyperedge, int lastHyperedge, int firstStar, ConnectionBuffer &buffer) const
+    {
+        // Iterate through each hyperedge, recording the connections it adds
+        for (int i = firstHyperedge, currentStar = firstStar; i < lastHyperedge; i++)
         {
             const int indexFirstCellPinInHyperedge = this->hEdgesToFirstMemberCellArray[i];
             const int degree = this->hEdgesToFirstMemberCellArray[i + 1] - indexFirstCellPinInHyperedge;
@@ -375,11 +981,11 @@ namespace PA3Placement
                 // Action depends on if this hyperedge is a clique or not,
                 if (isClique)
                 {
-                    this->processCliqueHyperedge(degree, weight, j, indexFirstCellPinInHyperedge);
+                    this->processCliqueHyperedge(degree, weight, j, indexFirstCellPinInHyperedge, buffer);
                 }
                 else
                 {
-                    this->processStarHyperedge(degree, weight, j, currentStar);
+                    this->processStarHyperedge(degree, weight, j, currentStar, buffer);
                 }
             }
 
@@ -389,86 +995,49 @@ namespace PA3Placement
                 currentStar++;
             }
         }
+    }
+
+    void QMatrix::addConnection(int cell, int otherCell, double weight, ConnectionBuffer &buffer) const
+    {
+        // Star nodes are numbered after the movable cells, so any cell number from numCellsNoPads
+        // on is an I/O pad here (the cell numbers in cellPinArray never refer to star nodes)
+        const bool cellIsIOPin = (cell >= this->numCellsNoPads);
+        const bool otherCellIsIOPin = (otherCell >= this->numCellsNoPads);
+
+        if (cell == otherCell || (cellIsIOPin && otherCellIsIOPin))
+        {
+            return;
+        }
 
-        this->populateDiagonal();
+        if (cellIsIOPin)
+        {
+            buffer.padConnections.push_back({otherCell, cell - this->numCellsNoPads, weight});
+        }
+        else if (otherCellIsIOPin)
+        {
+            buffer.padConnections.push_back({cell, otherCell - this->numCellsNoPads, weight});
+        }
+        else
+        {
+            buffer.triplets.push_back({std::min(cell, otherCell), std::max(cell, otherCell), -weight});
+        }
     }
 
-    void QMatrix::processCliqueHyperedge(int degree, double weight, int currentCellIndex, int firstCellInHEdgeIndex)
+    void QMatrix::processCliqueHyperedge(int degree, double weight, int currentCellIndex, int firstCellInHEdgeIndex, ConnectionBuffer &buffer) const
     {
         const int currentCell = this->cellPinArray[currentCellIndex];
 
-        // The current cell is an I/O pin if it's number is larger than the last moveable cell number
-        const bool currentCellIsIOPin = (currentCell >= this->numCellsNoPads);
-
         // This is a clique, so the weight is different now (1/(k-1)) * w
         const double modifiedWeight = (1.0 / (degree - 1.0)) * weight;
 
         // Every cell in this hyperedge needs to connect to the others in it.
         for (int k = currentCellIndex + 1; k < firstCellInHEdgeIndex + degree; k++)
         {
-            int connectedCell = cellPinArray[k];
-
-            // Check if connected cell/connected cell is an I/O pin or not
-            // Account for potential offset if the cell is an I/O pin or not
-            int currentCellWithOffset = currentCell;
-            int connectedCellWithOffset = connectedCell;
-
-            if (currentCellIsIOPin)
-            {
-                // cell is an I/O pin, add offset to it to account for added star nodes
-                currentCellWithOffset += numStars;
-            }
-
-            if (connectedCell >= this->numCellsNoPads)
-            {
-                // cell is an I/O pin, add offset to it to account for added star nodes
-                connectedCellWithOffset += numStars;
-            }
-
-            // Connect the cell or I/O pads together in our cell connections list
-            auto &currentConnections = cellConnectionsList.at(currentCellWithOffset);
-            auto &connectedConnections = cellConnectionsList.at(connectedCellWithOffset);
-
-            // Set comparator only looks at first element in pair, so can leave the "weight" as zero for the query
-            auto currentToCon = currentConnections.find({connectedCellWithOffset, 0});
-            auto conToCurrent = connectedConnections.find({currentCellWithOffset, 0});
-
-            // Check if there is an already existing connection
-            if (currentToCon != currentConnections.end())
-            {
-                // "currentCell" already connected to "connectedCell". Replace the connection with an updated weight
-                std::pair<double, double> newPair = {currentToCon->first, currentToCon->second + modifiedWeight};
-                currentConnections.erase(currentToCon);
-                currentConnections.insert(newPair);
-            }
-            else
-            {
-                currentConnections.insert({connectedCellWithOffset, modifiedWeight});
-            }
-
-            if (conToCurrent != connectedConnections.end())
-            {
-                // "connectedCell" already connected to "currentCell". Replace the connection with an updated weight
-                std::pair<double, double> newPair = {conToCurrent->first, conToCurrent->second + modifiedWeight};
-                connectedConnections.erase(conToCurrent);
-                connectedConnections.insert(newPair);
-            }
-            else
-            {
-                connectedConnections.insert({currentCellWithOffset, modifiedWeight});
-            }
-
-
-            if (!currentCellIsIOPin && connectedCell < this->numCellsNoPads) // Avoid I/O pins
-            {
-                // Connect the cells together in the matrix (since they are not I/O pins)
-                this->set(currentCell, connectedCell, this->get(currentCell, connectedCell) + -modifiedWeight);
-                this->set(connectedCell, currentCell, this->get(connectedCell, currentCell) + -modifiedWeight);
-            }
+            this->addConnection(currentCell, this->cellPinArray[k], modifiedWeight, buffer);
         }
     }
 
-    void QMatrix::processStarHyperedge(int degree, double weight, int currentCellIndex, int currentStar)
+    void QMatrix::processStarHyperedge(int degree, double weight, int currentCellIndex, int currentStar, ConnectionBuffer &buffer) const
     {
         const int currentCell = this->cellPinArray[currentCellIndex];
 
@@ -481,41 +1050,70 @@ namespace PA3Placement
         // Connect the current cell or I/O pad to the current star
         if (currentCellIsIOPin)
         {
-            // Add offset to currentCell to account for added star nodes
-            cellConnectionsList.at(currentStar).insert({currentCell + numStars, modifiedWeight});
-            cellConnectionsList.at(currentCell + numStars).insert({currentStar, modifiedWeight});
+            buffer.padConnections.push_back({currentStar, currentCell - this->numCellsNoPads, modifiedWeight});
         }
         else
         {
-            cellConnectionsList.at(currentStar).insert({currentCell, modifiedWeight});
-            cellConnectionsList.at(currentCell).insert({currentStar, modifiedWeight});
-
-            // Current cell is NOT an I/O pad, so connect the cell to the star in the Matrix
-            this->set(currentCell, currentStar, this->get(currentCell, currentStar) + -modifiedWeight);
-            this->set(currentStar, currentCell, this->get(currentStar, currentCell) + -modifiedWeight);
+            // Star nodes are numbered after all cells, so the star is always the column
+            buffer.triplets.push_back({currentCell, currentStar, -modifiedWeight});
         }
     }
 
-    void QMatrix::populateDiagonal()
+    void QMatrix::assembleSparseMatrix(std::vector<ConnectionBuffer> &buffers)
     {
-        // Populate the diagonal of the Q matrix based on cell connections
-        for (unsigned int i = 0; i < cellConnectionsList.size(); i++)
+        // I/O pads are not rows/columns in the matrix, only cells and star nodes
+        const int numMovable = this->numCellsNoPads + this->numStars;
+
+        std::vector<std::vector<MatrixTriplet<double>>> tripletLists;
+        for (auto &buffer : buffers)
         {
-            auto &ithCellConnections = cellConnectionsList.at(i);
+            this->padConnections.insert(this->padConnections.end(), buffer.padConnections.begin(), buffer.padConnections.end());
+            tripletLists.push_back(std::move(buffer.triplets));
+        }
 
-            std::for_each(ithCellConnections.begin(), ithCellConnections.end(), [this, i] (auto connectedCellData)
-                  {
-                    // First element of pair is the connected cell number, second element is the weight of the connection
+        // Merge repeated connections to the same pad
+        std::sort(this->padConnections.begin(), this->padConnections.end(), [](const PadConnection &lhs, const PadConnection &rhs) {
+            return (lhs.node != rhs.node) ? (lhs.node < rhs.node) : (lhs.pad < rhs.pad);
+        });
 
-                      // Exclude I/O pins from Q matrix
-                      // We include them as part of the weights (hence only checking i), but they are not actual rows/columns in the matrix
-                      if (i < (this->numCellsNoPads + numStars))
-                      {
-                          this->set(i, i, this->get(i, i) + connectedCellData.second);
-                      }
-                  }
-            );
+        size_t merged = 0;
+        for (size_t i = 0; i < this->padConnections.size(); i++)
+        {
+            if (merged > 0 && this->padConnections[merged - 1].node == this->padConnections[i].node
+                && this->padConnections[merged - 1].pad == this->padConnections[i].pad)
+            {
+                this->padConnections[merged - 1].weight += this->padConnections[i].weight;
+            }
+            else
+            {
+                this->padConnections[merged++] = this->padConnections[i];
+            }
+        }
+        this->padConnections.resize(merged);
+
+        // The diagonal includes connections to I/O pads, they are part of the weights but not actual rows/columns
+        std::vector<double> diagonal(numMovable, 0);
+        for (const auto &triplets : tripletLists)
+        {
+            for (const auto &triplet : triplets)
+            {
+                // Triplets hold the negated weight
+                diagonal[triplet.row] -= triplet.value;
+                diagonal[triplet.column] -= triplet.value;
+            }
+        }
+        for (const auto &padConnection : this->padConnections)
+        {
+            diagonal[padConnection.node] += padConnection.weight;
         }
+
+        this->assembleFromTriplets(diagonal, tripletLists);
+
+#ifdef DEBUG
+        std::cout << "Q matrix: " << this->getHeight() << "x" << this->getWidth() << ", "
+                  << this->getNonZeroCount() << " stored non-zeros, "
+                  << this->padConnections.size() << " pad connections" << std::endl;
+#endif
     }
 
     template <typename T>
@@ -627,6 +1225,18 @@ namespace PA3Placement
         return result;
     }
 
+    template <typename T>
+    T* ColumnMatrix<T>::getData()
+    {
+        return this->rows->data();
+    }
+
+    template <typename T>
+    const T* ColumnMatrix<T>::getData() const
+    {
+        return this->rows->data();
+    }
+
     template <typename T>
     void ColumnMatrix<T>::addRow()
     {
@@ -674,53 +1284,66 @@ namespace PA3Placement
         return 1;
     }
 
-    DMatrix::DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars, QMatrix::WeightedCellConnectionsList *cellConnectionsList)
-        : ColumnMatrix<double>(numCellsNoPads + numStars, 0)
+    DMatrix::DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars, const std::vector<QMatrix::PadConnection> &padConnections)
+        : DMatrix(dimension, pinLocations, numCellsNoPads, numStars)
+    {
+        this->generate(padConnections);
+    }
+
+    DMatrix::DMatrix(Dimension dimension, const SPinLocation *pinLocations, int numCellsNoPads, int numStars)
         // Number of rows in the D matrix is equal to the number of cells and star nodes
         // (everything except I/O pads, they are not present as rows or columns in any matrix)
+        : ColumnMatrix<double>(numCellsNoPads + numStars, 0)
     {
         this->dimension = dimension;
         this->pinLocations = pinLocations;
         this->numCellsNoPads = numCellsNoPads;
         this->numStars = numStars;
-        this->cellConnectionsList = cellConnectionsList;
-
-        this->generate();
     }
 
-    const SPinLocation* DMatrix::getIOPadLocation(int ioPadNumberWithOffset) const
+    const SPinLocation* DMatrix::getIOPadLocation(int ioPadIndex) const
     {
         // According to suraj_parser.cpp: the pin location for an I/O pad is (padNumber - numCells_noPads)
-        // but due to our offset we must subtract that as well (added star nodes)
-        return this->pinLocations + (ioPadNumberWithOffset - this->numStars - this->numCellsNoPads);
-    }
-
-    void DMatrix::generate()
-    {
-        for (unsigned int currentCell = 0; currentCell < this->cellConnectionsList->size(); currentCell++)
-        {
-            // Only looking at non I/O pads as our "current cell"
-            if (currentCell < this->numCellsNoPads + this->numStars) {
-                const auto &connectedCells = this->cellConnectionsList->at(currentCell);
-
-                for (auto &connectedCell: connectedCells) {
-                    // Check if the connected cell is an I/O pad.
-                    // The cell numbers in the cellConnectionsList have an offset based on how many star nodes have been added
-                    // So, an I/O pad is an I/O pad if it's number is greater than the last movable cell plus the number of stars
-                    // (since the next numbers after the last movable cell are the added star nodes)
-                    if (connectedCell.first >= this->numCellsNoPads + this->numStars) {
-                        // Get the x,y coordinates of the I/O pad
-                        const SPinLocation *ioPadLoc = this->getIOPadLocation(connectedCell.first);
-                        // Pick the corresponding coordinate depending on our dimension
-                        int coord = (this->dimension == X ? ioPadLoc->x : ioPadLoc->y);
-
-                        // Update the matrix row for our current cell with the I/O pad coordinate
-                        // Summing here because multiple pads might be connected to a cell, and they should be summed in this case
-                        // Multiply the coordinate value by the weight of the connection between the pad and the current cell
-                        this->set(0, currentCell, this->get(0, currentCell) + (coord * connectedCell.second));
-                    }
-                }
-            }
+        return this->pinLocations + ioPadIndex;
+    }
+
+    std::pair<DMatrix*, DMatrix*> DMatrix::createPair(const SPinLocation *pinLocations, int numCellsNoPads, int numStars,
+                                                      const std::vector<QMatrix::PadConnection> &padConnections)
+    {
+        DMatrix *dx = new DMatrix(X, pinLocations, numCellsNoPads, numStars);
+        DMatrix *dy = new DMatrix(Y, pinLocations, numCellsNoPads, numStars);
+
+        double *xRows = dx->getData();
+        double *yRows = dy->getData();
+
+        for (const auto &padConnection : padConnections)
+        {
+            const SPinLocation *ioPadLoc = dx->getIOPadLocation(padConnection.pad);
+            const double x = ioPadLoc->x;
+            const double y = ioPadLoc->y;
+
+            xRows[padConnection.node] += x * padConnection.weight;
+            yRows[padConnection.node] += y * padConnection.weight;
+        }
+
+        return {dx, dy};
+    }
+
+    void DMatrix::generate(const std::vector<QMatrix::PadConnection> &padConnections)
+    {
+        double *rows = this->getData();
+
+        for (const auto &padConnection : padConnections)
+        {
+            // Get the x,y coordinates of the I/O pad
+            const SPinLocation *ioPadLoc = this->getIOPadLocation(padConnection.pad);
+            // Pick the corresponding coordinate depending on our dimension
+            const double coord = (this->dimension == X ? ioPadLoc->x : ioPadLoc->y);
+
+            // Update the matrix row for the connected cell with the I/O pad coordinate
+            // Summing here because multiple pads might be connected to a cell, and they should be summed in this case
+            // Multiply the coordinate value by the weight of the connection between the pad and the current cell
+            rows[padConnection.node] += coord * padConnection.weight;
         }
     }
 
@@ -729,6 +1352,7 @@ namespace PA3Placement
     template class Matrix2D<int>;
     template class ColumnMatrix<double>;
     template class ColumnMatrix<int>;
+    template class SymmetricSparseMatrix<double>;
 
     // Based on ChatGPT code
     Matrix2D<double> solveMatrixGradientDescent(double learningRate, int iterations, const Matrix2D<double> &Q, const Matrix2D<double> &Dx)
@@ -752,81 +1376,4 @@ namespace PA3Placement
 
         return x;
     }
-
-    // Based on ChatGPT code
-    ColumnMatrix<double> solveMatrixConjugateGradient(double tolerance, int iterations, const Matrix2D<double> &Q, const ColumnMatrix<double> &Dx)
-    {
-#if 0
-        // Initialize the solution vector x
-        Matrix2D<double> x(Dx.getWidth(), Dx.getHeight());
-
-        Matrix2D<double> r = Q * x - Dx;
-        Matrix2D<double> p = r;
-
-        for (int k = 0; k < iterations; ++k) {
-            double alpha = r.dot(r) / p.dot(Q * p);
-            x = x - p * alpha;
-            Matrix2D<double> new_r = Q * x - Dx;
-
-            if (new_r.norm() < tolerance) {
-#ifdef DEBUG
-                std::cout << "[Conjugate Gradient Solver]: Converged in " << k + 1 << " iterations." << std::endl;
-#endif
-                break;
-            }
-
-            double beta = new_r.dot(new_r) / r.dot(r);
-            p = new_r + p * beta;
-            r = new_r;
-
-#ifdef DEBUG
-            std::cout << "[Conjugate Gradient Solver]: Completed iteration: " << k << std::endl;
-#endif
-        }
-
-        return x;
-#else
-        long n = Q.getHeight();
-        ColumnMatrix<double> Ap(n , 0);
-        ColumnMatrix<double> x(n, 0); // col
-
-        ColumnMatrix<double> r = Dx - Q * x; // col
-        ColumnMatrix<double> p = r; // col
-
-        //double rs_old = inner_product(r, r);
-        double rs_old = r.dot(r);
-
-        for (int i = 0; i < iterations; i++) {
-            Ap = Q * p; // col
-            double alpha = rs_old / p.dot(Ap);
-            x = x + (p * alpha);
-            r = r - (Ap * alpha);
-            double rs_new = r.dot(r);
-            if (sqrt(rs_new) < tolerance) break;
-            p = r + p * (rs_new / rs_old);
-            rs_old = rs_new;
-#ifdef DEBUG
-            std::cout << "[Conjugate Gradient Solver]: Completed Iteration " << i << std::endl;
-#endif
-        }
-
-        return x;
-#endif
-    }
-
-    void matrixSolverThread(void *args)
-    {
-        MatrixSolverParams *params = (MatrixSolverParams*) args;
-
-        std::cout << "[Matrix Solver Thread " << params->id << "]: Started." << std::endl;
-
-#if 1
-        *(params->xAnswer) = solveMatrixConjugateGradient(params->tolerance, params->maxIterations, *params->Q, *params->Dx);
-        //*(params->xAnswer) = acceleratedSolveMatrixConjugateGradient(*params->Q, *params->Dx);
-#else
-        *(params->xAnswer) = solveMatrixGradientDescent(0.01, params->maxIterations, *params->Q, *params->Dx);
-#endif
-
-        std::cout << "[Matrix Solver Thread " << params->id << "]: Exit." << std::endl;
-    }
 }
@@ -0,0 +1,166 @@
+#include "nametable.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace PA3Placement
+{
+    static const int NAME_TABLE_MINIMUM_CAPACITY = 16;
+    // Names looked up together by findBatch
+    static const int NAME_TABLE_BATCH_SIZE = 32;
+
+    uint64_t NameTable::hashName(const char *name, size_t length)
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= static_cast<unsigned char>(name[i]);
+            hash *= 1099511628211ull;
+        }
+
+        // Mix the high bits into the low bits used as the slot index
+        return hash ^ (hash >> 29);
+    }
+
+    uint64_t NameTable::getPrefix(const char *name, size_t length)
+    {
+        uint64_t prefix = 0;
+        std::memcpy(&prefix, name, std::min<size_t>(length, sizeof(prefix)));
+
+        return prefix;
+    }
+
+    bool NameTable::matches(const Slot &slot, const char *name, size_t length, uint64_t prefix) const
+    {
+        if (slot.prefix != prefix || slot.length != length)
+        {
+            return false;
+        }
+
+        return length <= sizeof(prefix) || std::memcmp(this->arena.data() + slot.offset, name, length) == 0;
+    }
+
+    size_t NameTable::findSlot(const char *name, size_t length, uint64_t hash) const
+    {
+        const size_t mask = this->slots.size() - 1;
+        const uint64_t prefix = getPrefix(name, length);
+
+        for (size_t i = hash & mask;; i = (i + 1) & mask)
+        {
+            const Slot &slot = this->slots[i];
+            if (slot.value < 0 || this->matches(slot, name, length, prefix))
+            {
+                return i;
+            }
+        }
+    }
+
+    void NameTable::rehash(size_t capacity)
+    {
+        std::vector<Slot> previous(capacity);
+        previous.swap(this->slots);
+
+        const size_t mask = capacity - 1;
+        for (const Slot &slot : previous)
+        {
+            if (slot.value >= 0)
+            {
+                size_t i = hashName(this->arena.data() + slot.offset, slot.length) & mask;
+                while (this->slots[i].value >= 0)
+                {
+                    i = (i + 1) & mask;
+                }
+                this->slots[i] = slot;
+            }
+        }
+    }
+
+    void NameTable::reserve(size_t count, size_t averageLength)
+    {
+        size_t capacity = NAME_TABLE_MINIMUM_CAPACITY;
+        while (capacity < 2 * count)
+        {
+            capacity *= 2;
+        }
+
+        if (capacity > this->slots.size())
+        {
+            this->rehash(capacity);
+        }
+        this->arena.reserve(count * averageLength);
+    }
+
+    void NameTable::insert(const char *name, size_t length, int value)
+    {
+        // The table grows once it is more than half full
+        if (2 * (this->size + 1) > this->slots.size())
+        {
+            this->rehash(this->slots.empty() ? NAME_TABLE_MINIMUM_CAPACITY : 2 * this->slots.size());
+        }
+
+        Slot &slot = this->slots[this->findSlot(name, length, hashName(name, length))];
+
+        if (slot.value < 0)
+        {
+            slot.prefix = getPrefix(name, length);
+            slot.offset = static_cast<uint32_t>(this->arena.size());
+            slot.length = static_cast<uint32_t>(length);
+            this->arena.insert(this->arena.end(), name, name + length);
+            this->size++;
+        }
+        slot.value = value;
+    }
+
+    int NameTable::find(const char *name, size_t length) const
+    {
+        if (this->slots.empty())
+        {
+            return -1;
+        }
+
+        return this->slots[this->findSlot(name, length, hashName(name, length))].value;
+    }
+
+    void NameTable::findBatch(const char *const *names, const size_t *lengths, int count, int *values) const
+    {
+        if (this->slots.empty())
+        {
+            std::fill(values, values + count, -1);
+            return;
+        }
+
+        const size_t mask = this->slots.size() - 1;
+        size_t first[NAME_TABLE_BATCH_SIZE];
+
+        for (int begin = 0; begin < count; begin += NAME_TABLE_BATCH_SIZE)
+        {
+            const int end = std::min(count, begin + NAME_TABLE_BATCH_SIZE);
+
+            for (int k = begin; k < end; k++)
+            {
+                first[k - begin] = hashName(names[k], lengths[k]) & mask;
+                __builtin_prefetch(&this->slots[first[k - begin]]);
+            }
+
+            for (int k = begin; k < end; k++)
+            {
+                const uint64_t prefix = getPrefix(names[k], lengths[k]);
+
+                size_t i = first[k - begin];
+                while (this->slots[i].value >= 0 && !this->matches(this->slots[i], names[k], lengths[k], prefix))
+                {
+                    i = (i + 1) & mask;
+                }
+                values[k] = this->slots[i].value;
+            }
+        }
+    }
+
+    void NameTable::clear()
+    {
+        this->slots.clear();
+        this->arena.clear();
+        this->size = 0;
+    }
+}
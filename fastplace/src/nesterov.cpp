@@ -0,0 +1,407 @@
+#include "nesterov.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace PA3Placement
+{
+    // The density weight starts at this fraction of the gradient norm ratio between wirelength and density
+    static const double INITIAL_DENSITY_WEIGHT_SCALE = 1e-3;
+    // and grows by this factor every iteration
+    static const double DENSITY_WEIGHT_GROWTH = 1.05;
+
+    // Stops when the overflow did not drop by STAGNATION_OVERFLOW_DECREASE within STAGNATION_ITERATIONS iterations,
+    // counted from when the density weight balances the initial wirelength and density gradients
+    static const int STAGNATION_ITERATIONS = 50;
+    static const double STAGNATION_OVERFLOW_DECREASE = 1e-3;
+
+    // gamma = WA_GAMMA_BINS * bin size * 10^(WA_GAMMA_SLOPE * (overflow - 0.1) - 1), shrinking as the cells spread
+    static const double WA_GAMMA_BINS = 4.0;
+    static const double WA_GAMMA_SLOPE = 20.0 / 9.0;
+
+    // Progress is printed every this many iterations
+    static const int REPORT_INTERVAL = 25;
+
+    NesterovPlacer::NesterovPlacer(int numCellsNoPads, int numHyperedges, const int *cellPinArray, const int *hEdgesToFirstMemberCellArray,
+                                   const int *hEdgeWeights, const SPinLocation *pinLocations, const int *cellSizes,
+                                   ElectrostaticDensity &density, ThreadPool *threadPool)
+        : density(density)
+    {
+        this->numCellsNoPads = numCellsNoPads;
+        this->numHyperedges = numHyperedges;
+        this->cellPinArray = cellPinArray;
+        this->hEdgesToFirstMemberCellArray = hEdgesToFirstMemberCellArray;
+        this->hEdgeWeights = hEdgeWeights;
+        this->pinLocations = pinLocations;
+        this->cellSizes = cellSizes;
+        this->threadPool = threadPool;
+
+        const int numPins = hEdgesToFirstMemberCellArray[numHyperedges];
+
+        // Counting sort of the movable pins by cell, so every cell lists its pins in increasing order
+        this->cellPinStart.assign(numCellsNoPads + 1, 0);
+        for (int pin = 0; pin < numPins; pin++)
+        {
+            if (cellPinArray[pin] < numCellsNoPads)
+            {
+                this->cellPinStart[cellPinArray[pin] + 1]++;
+            }
+        }
+        for (int i = 0; i < numCellsNoPads; i++)
+        {
+            this->cellPinStart[i + 1] += this->cellPinStart[i];
+        }
+
+        this->cellPins.resize(this->cellPinStart[numCellsNoPads]);
+        std::vector<int> next(this->cellPinStart.begin(), this->cellPinStart.end() - 1);
+        for (int pin = 0; pin < numPins; pin++)
+        {
+            if (cellPinArray[pin] < numCellsNoPads)
+            {
+                this->cellPins[next[cellPinArray[pin]]++] = pin;
+            }
+        }
+
+        this->pinGradientX.resize(numPins);
+        this->pinGradientY.resize(numPins);
+        this->netWirelength.resize(numHyperedges);
+        this->forceX.resize(numCellsNoPads);
+        this->forceY.resize(numCellsNoPads);
+    }
+
+    void NesterovPlacer::parallelFor(long count, const std::function<void(long, long)> &function) const
+    {
+        if (this->threadPool != nullptr)
+        {
+            this->threadPool->parallelFor(count, function);
+        }
+        else
+        {
+            function(0, count);
+        }
+    }
+
+    /**
+     * WA wirelength of one net along one axis, writes d(WA)/d(coordinate) of every pin to gradient
+     */
+    static double weightedAverageWirelength(const double *coordinates, int degree, double gamma, double *gradient)
+    {
+        const double maximum = *std::max_element(coordinates, coordinates + degree);
+        const double minimum = *std::min_element(coordinates, coordinates + degree);
+
+        // Exponentials are taken relative to the extremes so they never overflow
+        double sumMax = 0;
+        double weightedSumMax = 0;
+        double sumMin = 0;
+        double weightedSumMin = 0;
+        for (int p = 0; p < degree; p++)
+        {
+            const double expMax = std::exp((coordinates[p] - maximum) / gamma);
+            const double expMin = std::exp((minimum - coordinates[p]) / gamma);
+
+            sumMax += expMax;
+            weightedSumMax += coordinates[p] * expMax;
+            sumMin += expMin;
+            weightedSumMin += coordinates[p] * expMin;
+        }
+
+        const double averageMax = weightedSumMax / sumMax;
+        const double averageMin = weightedSumMin / sumMin;
+
+        for (int p = 0; p < degree; p++)
+        {
+            const double expMax = std::exp((coordinates[p] - maximum) / gamma);
+            const double expMin = std::exp((minimum - coordinates[p]) / gamma);
+
+            gradient[p] = expMax / sumMax * (1 + (coordinates[p] - averageMax) / gamma)
+                        - expMin / sumMin * (1 - (coordinates[p] - averageMin) / gamma);
+        }
+
+        return averageMax - averageMin;
+    }
+
+    double NesterovPlacer::calculateWirelengthGradient(const double *x, const double *y, double gamma, double *gradientX, double *gradientY)
+    {
+        // Per net, into one gradient entry per pin
+        this->parallelFor(this->numHyperedges, [&](long firstNet, long lastNet)
+        {
+            std::vector<double> pinX;
+            std::vector<double> pinY;
+
+            for (long net = firstNet; net < lastNet; net++)
+            {
+                const int first = this->hEdgesToFirstMemberCellArray[net];
+                const int degree = this->hEdgesToFirstMemberCellArray[net + 1] - first;
+
+                if (degree < 2)
+                {
+                    std::fill(this->pinGradientX.begin() + first, this->pinGradientX.begin() + first + degree, 0.0);
+                    std::fill(this->pinGradientY.begin() + first, this->pinGradientY.begin() + first + degree, 0.0);
+                    this->netWirelength[net] = 0;
+                    continue;
+                }
+
+                pinX.resize(degree);
+                pinY.resize(degree);
+                for (int p = 0; p < degree; p++)
+                {
+                    const int cell = this->cellPinArray[first + p];
+
+                    if (cell < this->numCellsNoPads)
+                    {
+                        pinX[p] = x[cell];
+                        pinY[p] = y[cell];
+                    }
+                    else
+                    {
+                        // I/O pad
+                        pinX[p] = this->pinLocations[cell - this->numCellsNoPads].x;
+                        pinY[p] = this->pinLocations[cell - this->numCellsNoPads].y;
+                    }
+                }
+
+                const double weight = this->hEdgeWeights[net];
+                double *netGradientX = this->pinGradientX.data() + first;
+                double *netGradientY = this->pinGradientY.data() + first;
+
+                this->netWirelength[net] = weight * (weightedAverageWirelength(pinX.data(), degree, gamma, netGradientX)
+                                                     + weightedAverageWirelength(pinY.data(), degree, gamma, netGradientY));
+
+                for (int p = 0; p < degree; p++)
+                {
+                    netGradientX[p] *= weight;
+                    netGradientY[p] *= weight;
+                }
+            }
+        });
+
+        // Per cell, summing its pins
+        this->parallelFor(this->numCellsNoPads, [&](long begin, long end)
+        {
+            for (long cell = begin; cell < end; cell++)
+            {
+                double sumX = 0;
+                double sumY = 0;
+
+                for (int k = this->cellPinStart[cell]; k < this->cellPinStart[cell + 1]; k++)
+                {
+                    sumX += this->pinGradientX[this->cellPins[k]];
+                    sumY += this->pinGradientY[this->cellPins[k]];
+                }
+
+                gradientX[cell] = sumX;
+                gradientY[cell] = sumY;
+            }
+        });
+
+        double wirelength = 0;
+        for (int net = 0; net < this->numHyperedges; net++)
+        {
+            wirelength += this->netWirelength[net];
+        }
+
+        return wirelength;
+    }
+
+    double NesterovPlacer::calculateGradient(const double *x, const double *y, double gamma, double densityWeight,
+                                             double *gradientX, double *gradientY, double &overflow)
+    {
+        const double wirelength = this->calculateWirelengthGradient(x, y, gamma, gradientX, gradientY);
+
+        this->density.update(x, y, this->cellSizes, this->numCellsNoPads);
+        this->density.calculateForces(x, y, this->cellSizes, this->numCellsNoPads, this->forceX.data(), this->forceY.data());
+        overflow = this->density.getOverflow();
+
+        // The gradient of the density energy is minus the force, each cell is scaled by its pin count and area
+        this->parallelFor(this->numCellsNoPads, [&](long begin, long end)
+        {
+            for (long cell = begin; cell < end; cell++)
+            {
+                const double pins = this->cellPinStart[cell + 1] - this->cellPinStart[cell];
+                const double preconditioner = std::max(1.0, pins + densityWeight * this->cellSizes[cell]);
+
+                gradientX[cell] = (gradientX[cell] - densityWeight * this->forceX[cell]) / preconditioner;
+                gradientY[cell] = (gradientY[cell] - densityWeight * this->forceY[cell]) / preconditioner;
+            }
+        });
+
+        return wirelength;
+    }
+
+    /**
+     * |a - b|^2 over both coordinates
+     */
+    static double squaredDistance(const std::vector<double> &ax, const std::vector<double> &ay,
+                                  const std::vector<double> &bx, const std::vector<double> &by)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < ax.size(); i++)
+        {
+            sum += (ax[i] - bx[i]) * (ax[i] - bx[i]) + (ay[i] - by[i]) * (ay[i] - by[i]);
+        }
+
+        return sum;
+    }
+
+    NesterovStatistics NesterovPlacer::place(double *x, double *y, double width, double height, int maxIterations, double targetOverflow)
+    {
+        NesterovStatistics statistics;
+        const long n = this->numCellsNoPads;
+
+        if (n == 0 || !(width > 0 && height > 0))
+        {
+            return statistics;
+        }
+
+        this->density.setChipDimensions(width, height);
+        const double binSize = 0.5 * (this->density.getBinWidth() + this->density.getBinHeight());
+
+        auto clampInside = [&](std::vector<double> &vx, std::vector<double> &vy)
+        {
+            for (long i = 0; i < n; i++)
+            {
+                vx[i] = std::min(std::max(vx[i], 0.0), width);
+                vy[i] = std::min(std::max(vy[i], 0.0), height);
+            }
+        };
+
+        // u: solution, v: reference point the gradient is taken at
+        std::vector<double> ux(x, x + n);
+        std::vector<double> uy(y, y + n);
+        clampInside(ux, uy);
+        std::vector<double> vx = ux;
+        std::vector<double> vy = uy;
+        std::vector<double> gx(n);
+        std::vector<double> gy(n);
+
+        // Balance wirelength and density gradients for the initial density weight
+        double overflow;
+        double wirelength = this->calculateWirelengthGradient(vx.data(), vy.data(), WA_GAMMA_BINS * binSize, gx.data(), gy.data());
+        this->density.update(vx.data(), vy.data(), this->cellSizes, n);
+        this->density.calculateForces(vx.data(), vy.data(), this->cellSizes, n, this->forceX.data(), this->forceY.data());
+        overflow = this->density.getOverflow();
+
+        double wirelengthNorm = 0;
+        double densityNorm = 0;
+        for (long i = 0; i < n; i++)
+        {
+            wirelengthNorm += std::abs(gx[i]) + std::abs(gy[i]);
+            densityNorm += std::abs(this->forceX[i]) + std::abs(this->forceY[i]);
+        }
+
+        const double balancedDensityWeight = densityNorm > 0 ? wirelengthNorm / densityNorm : 1.0;
+        double densityWeight = INITIAL_DENSITY_WEIGHT_SCALE * balancedDensityWeight;
+        auto gamma = [&](double currentOverflow)
+        {
+            return WA_GAMMA_BINS * binSize * std::pow(10.0, WA_GAMMA_SLOPE * (currentOverflow - 0.1) - 1);
+        };
+
+        wirelength = this->calculateGradient(vx.data(), vy.data(), gamma(overflow), densityWeight, gx.data(), gy.data(), overflow);
+
+        // Initial step from a point a small step back along the gradient
+        double gradientMaximum = 0;
+        for (long i = 0; i < n; i++)
+        {
+            gradientMaximum = std::max(gradientMaximum, std::max(std::abs(gx[i]), std::abs(gy[i])));
+        }
+        if (gradientMaximum <= 0)
+        {
+            statistics.overflow = overflow;
+            statistics.wirelength = wirelength;
+            return statistics;
+        }
+
+        std::vector<double> previousVx(n);
+        std::vector<double> previousVy(n);
+        std::vector<double> previousGx(n);
+        std::vector<double> previousGy(n);
+        double unusedOverflow;
+        for (long i = 0; i < n; i++)
+        {
+            previousVx[i] = vx[i] - 0.1 * binSize * gx[i] / gradientMaximum;
+            previousVy[i] = vy[i] - 0.1 * binSize * gy[i] / gradientMaximum;
+        }
+        this->calculateGradient(previousVx.data(), previousVy.data(), gamma(overflow), densityWeight, previousGx.data(), previousGy.data(), unusedOverflow);
+
+        double stepLength = std::sqrt(squaredDistance(vx, vy, previousVx, previousVy) / squaredDistance(gx, gy, previousGx, previousGy));
+        if (!std::isfinite(stepLength))
+        {
+            stepLength = 0.1 * binSize / gradientMaximum;
+        }
+
+        double a = 1;
+        std::vector<double> nextUx(n);
+        std::vector<double> nextUy(n);
+
+        double bestOverflow = overflow;
+        int lastImprovement = 0;
+
+        int iteration = 0;
+        while (iteration < maxIterations && overflow > targetOverflow)
+        {
+            iteration++;
+
+            // u' = v - step * grad(v), v' = u' + (a - 1) / a' * (u' - u)
+            const double nextA = (1 + std::sqrt(4 * a * a + 1)) / 2;
+            const double momentum = (a - 1) / nextA;
+
+            for (long i = 0; i < n; i++)
+            {
+                nextUx[i] = vx[i] - stepLength * gx[i];
+                nextUy[i] = vy[i] - stepLength * gy[i];
+            }
+            clampInside(nextUx, nextUy);
+
+            previousVx.swap(vx);
+            previousVy.swap(vy);
+            for (long i = 0; i < n; i++)
+            {
+                vx[i] = nextUx[i] + momentum * (nextUx[i] - ux[i]);
+                vy[i] = nextUy[i] + momentum * (nextUy[i] - uy[i]);
+            }
+            clampInside(vx, vy);
+            ux.swap(nextUx);
+            uy.swap(nextUy);
+            a = nextA;
+
+            previousGx.swap(gx);
+            previousGy.swap(gy);
+            densityWeight *= DENSITY_WEIGHT_GROWTH;
+            wirelength = this->calculateGradient(vx.data(), vy.data(), gamma(overflow), densityWeight, gx.data(), gy.data(), overflow);
+
+            // Step length is the inverse of the local Lipschitz constant estimate
+            const double nextStepLength = std::sqrt(squaredDistance(vx, vy, previousVx, previousVy) / squaredDistance(gx, gy, previousGx, previousGy));
+            if (std::isfinite(nextStepLength) && nextStepLength > 0)
+            {
+                stepLength = nextStepLength;
+            }
+
+            if (iteration % REPORT_INTERVAL == 0)
+            {
+                std::cout << "Nesterov iteration " << iteration << ": overflow " << overflow << ", WA wirelength " << wirelength
+                          << ", density weight " << densityWeight << std::endl;
+            }
+
+            // Before the density weight catches up the overflow is not expected to drop
+            if (overflow < bestOverflow - STAGNATION_OVERFLOW_DECREASE || densityWeight < balancedDensityWeight)
+            {
+                bestOverflow = overflow;
+                lastImprovement = iteration;
+            }
+            else if (iteration - lastImprovement >= STAGNATION_ITERATIONS)
+            {
+                std::cout << "Nesterov placement stagnated at overflow " << overflow << std::endl;
+                break;
+            }
+        }
+
+        std::copy(ux.begin(), ux.end(), x);
+        std::copy(uy.begin(), uy.end(), y);
+
+        statistics.iterations = iteration;
+        statistics.overflow = overflow;
+        statistics.wirelength = wirelength;
+        return statistics;
+    }
+}
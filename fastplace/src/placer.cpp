@@ -3,84 +3,134 @@
 //
 
 #include "placer.hpp"
+#include "detailed.hpp"
+#include "nesterov.hpp"
+#include "vectorkernels.hpp"
 
 #include <iostream>
 #include <fstream>
 #include <vector>
-#include <unordered_set>
+#include <algorithm>
 #include <cassert>
+#include <chrono>
 #include <cmath>
+#include <tuple>
 
 namespace PA3Placement
 {
-    static const unsigned int NUM_BINS = 5;
 
     static const double SPREADING_ALPHA = 0.8;
     static const double SPREADING_SIGMA = 1.5;
 
+    // Electrostatic spreading moves every cell ELECTROSTATIC_STEPS times, at most ELECTROSTATIC_STEP_SIZE bins each time
+    static const int ELECTROSTATIC_STEPS = 10;
+    static const double ELECTROSTATIC_STEP_SIZE = 0.5;
+
     static const double CONJ_GRADIENT_TOLERANCE = 1e-6;
     static const int CONJ_GRADIENT_ITERATIONS = 1000;
 
-    double AnalyticPlacer::calculateTotalWirelength(std::vector<std::pair<double, double>> &cellLocations) const
+    // Global placement stops when an iteration changes the overflow and (relative) HPWL by less than these
+    static const double GLOBAL_OVERFLOW_TOLERANCE = 1e-3;
+    static const double GLOBAL_HPWL_TOLERANCE = 1e-3;
+    // Cells closer to their anchor target than this many bins get the anchor weight of a cell this far away
+    static const double ANCHOR_MINIMUM_DISTANCE = 0.25;
+
+    bool parseGlobalPlacementMode(const std::string &name, GlobalPlacementMode &mode)
     {
-        double sum = 0.0;
+        if (name == "quadratic")
+        {
+            mode = GlobalPlacementMode::QUADRATIC;
+        }
+        else if (name == "nesterov")
+        {
+            mode = GlobalPlacementMode::NESTEROV;
+        }
+        else
+        {
+            return false;
+        }
 
-        if (nullptr != this->matrixQ)
+        return true;
+    }
+
+    bool parseSpreadingMethod(const std::string &name, SpreadingMethod &method)
+    {
+        if (name == "shift")
+        {
+            method = SpreadingMethod::CELL_SHIFTING;
+        }
+        else if (name == "electrostatic")
+        {
+            method = SpreadingMethod::ELECTROSTATIC;
+        }
+        else
         {
-            std::unordered_set<std::pair<int, int>, pairHashInteger> visitedPairs;
+            return false;
+        }
 
-            for (unsigned int currentCell = 0; currentCell < this->matrixQ->getCellConnectionsList()->size(); currentCell++)
-            {
-                // Only looking at non I/O pads as our "current cell" (exclude star nodes)
-                if (currentCell < numCells_noPads) {
-                    auto currentCellCoords = cellLocations.at(currentCell);
-                    auto connectedCells = this->matrixQ->getCellConnectionsList()->at(currentCell);
-
-                    // First element in pair is the cell number, second element is the connection weight
-                    for (auto &connectedCell: connectedCells) {
-                        std::pair<double, double> connectedCellCoords;
-                        double connectionWeight = connectedCell.second;
-
-                        // Only visit a pair once
-                        if (visitedPairs.find({currentCell, connectedCell.first}) == visitedPairs.end()
-                            && visitedPairs.find({connectedCell.first, currentCell}) == visitedPairs.end())
-                        {
-
-                            // Check if the cell is an I/O pad or not (include Star nodes)
-                            if (connectedCell.first < numCells_noPads + this->matrixQ->getStarNodeCount())
-                            {
-                                // Not an I/O pad, and also not a star node
-                                connectedCellCoords = cellLocations.at(connectedCell.first);
-                            }
-                            else
-                            {
-#if 0
-                                // Is an I/O pad, get its coordinates from the pinLocations list
-                                connectedCellCoords.first = this->matrixDx->getIOPadLocation(connectedCell.first)->x;
-                                connectedCellCoords.second = this->matrixDx->getIOPadLocation(connectedCell.first)->y;
-#else
-                                continue; // Only calculating wirelength between movable cells
-#endif
-                            }
+        return true;
+    }
 
-                            // w_i * (x1-x2)^2 + (y1-y2)^2
-                            double diffx = currentCellCoords.first - connectedCellCoords.first;
-                            double diffy = currentCellCoords.second - connectedCellCoords.second;
+    AnalyticPlacer::AnalyticPlacer(const Hypergraph &hypergraph, const PlacerSettings &settings) : hypergraph(hypergraph)
+    {
+        this->settings = settings;
+
+        this->matrixQ = nullptr;
+        this->matrixDx = nullptr;
+        this->matrixDy = nullptr;
+        this->preconditioner = nullptr;
+        this->solver = nullptr;
+        this->wirelengthEvaluator = nullptr;
+        this->threadPool = new ThreadPool(std::max(1, settings.threadCount));
+        this->binGrid.setResolution(settings.binsX, settings.binsY);
+        this->density = new ElectrostaticDensity(settings.densityBins, settings.densityBins, this->threadPool);
+        this->density->setTargetDensity(settings.targetDensity);
+    }
 
-                            double x1x2 = pow(diffx, 2);
-                            double y1y2 = pow(diffy, 2);
+    AnalyticPlacer::~AnalyticPlacer()
+    {
+        delete this->wirelengthEvaluator;
+        delete this->solver;
+        delete this->preconditioner;
+        delete this->matrixDx;
+        delete this->matrixDy;
+        delete this->matrixQ;
+        delete this->density;
+        delete this->threadPool;
+    }
 
-                            sum += connectionWeight * (x1x2 + y1y2);
+    double AnalyticPlacer::calculateTotalWirelength(const double *x, const double *y) const
+    {
+        // Only calculating wirelength between movable nodes, connections to I/O pads are not part of Q
+        return nullptr != this->wirelengthEvaluator ? this->wirelengthEvaluator->calculateQuadraticWirelength(x, y) : 0.0;
+    }
 
-                            visitedPairs.insert({currentCell, connectedCell.first});
-                            //std::cout << "Visited pair: " << currentCell << " " << connectedCell.first << std::endl;
-                        }
-                    }
-                }
-            }
+    double AnalyticPlacer::calculateHPWL(const double *x, const double *y) const
+    {
+        return this->wirelengthEvaluator->calculateHPWL(x, y);
+    }
+
+    double AnalyticPlacer::calculateOverflow()
+    {
+        this->createBins();
+        this->updateBinUtilizations();
+
+        const BinGrid &grid = this->binGrid;
+        if (grid.getTotalCellArea() <= 0)
+        {
+            return 0;
         }
 
-        return sum;
+        // Cell area a bin may hold, never less than when the cells are spread evenly over the chip
+        const double capacity = std::max(this->settings.targetDensity * grid.getBinArea(), grid.getTotalCellArea() / grid.getBinCount());
+
+        double excess = 0;
+        for (int bin = 0; bin < grid.getBinCount(); bin++)
+        {
+            excess += std::max(0.0, grid.getCellArea(bin) - capacity);
+        }
+
+        return excess / grid.getTotalCellArea();
     }
 
     void AnalyticPlacer::saveCellLocationsToDisk(std::string filename)
@@ -94,9 +144,9 @@ namespace PA3Placement
         }
 
         // Now add the I/O pads
-        for (int i = 0; i < numCellsAndPads - numCells_noPads; i++)
+        for (int i = 0; i < this->hypergraph.getPadCount(); i++)
         {
-            fout << "p" << i << " " << pinLocations[i].x << " " << pinLocations[i].y << std::endl;
+            fout << "p" << i << " " << this->hypergraph.pinLocations[i].x << " " << this->hypergraph.pinLocations[i].y << std::endl;
         }
     }
 
@@ -111,13 +161,13 @@ namespace PA3Placement
         }
 
         // Now add the I/O pads
-        for (int i = 0; i < numCellsAndPads - numCells_noPads; i++)
+        for (int i = 0; i < this->hypergraph.getPadCount(); i++)
         {
-            fout << "p" << i << " " << pinLocations[i].x << " " << pinLocations[i].y << std::endl;
+            fout << "p" << i << " " << this->hypergraph.pinLocations[i].x << " " << this->hypergraph.pinLocations[i].y << std::endl;
         }
     }
 
-    void AnalyticPlacer::calculateCellLocations()
+    std::pair<SolverStatistics, SolverStatistics> AnalyticPlacer::calculateCellLocations()
     {
         // Solve the Matrices to get X/Y coordinates for each cell
 #if 0
@@ -126,41 +176,246 @@ namespace PA3Placement
         std::cout << "Solving for Y coordinates..." << std::endl;
         auto resultY = solveMatrixGradientDescent(0.01, 100, *this->matrixQ, this->matrixDy->convertTo2D());
 #else
-        pthread_t xSolverTid, ySolverTid;
-        ColumnMatrix<double> *resultX = new ColumnMatrix<double>(1, 0);
-        ColumnMatrix<double> *resultY = new ColumnMatrix<double>(1, 0);
-
-        MatrixSolverParams *xParams = new MatrixSolverParams();
-        MatrixSolverParams *yParams;
-        xParams->id = 1;
-        xParams->tolerance = CONJ_GRADIENT_TOLERANCE;
-        xParams->maxIterations = CONJ_GRADIENT_ITERATIONS;
-        xParams->Q = this->matrixQ;
-        xParams->Dx = this->matrixDx;
-        xParams->xAnswer = resultX;
-
-        yParams = new MatrixSolverParams(*xParams);
-        yParams->id = 2;
-        yParams->Dx = this->matrixDy;
-        yParams->xAnswer = resultY;
+        // X and Y share the same Q, solve both together so every pass over Q serves both
+        SolverStatistics statistics[2];
 
-        std::cout << "Solving for X coordinates..." << std::endl;
-        pthread_create(&xSolverTid, NULL, (void *(*)(void *)) (matrixSolverThread), (void*) xParams);
-        std::cout << "Solving for Y coordinates..." << std::endl;
-        pthread_create(&ySolverTid, NULL, (void *(*)(void *)) (matrixSolverThread), (void*) yParams);
+        std::cout << "Solving for X and Y coordinates..." << std::endl;
+        this->solver->solvePair(this->rhsX.data(), this->rhsY.data(), this->solutionX.data(), this->solutionY.data(), statistics);
 
-        // Wait for X and Y solver threads to finish
-        pthread_join(xSolverTid, NULL);
-        pthread_join(ySolverTid, NULL);
+        std::cout << "X solve " << statistics[0] << std::endl;
+        std::cout << "Y solve " << statistics[1] << std::endl;
 #endif
 
         // Place the x/y coordinates into our vector
-        for (int i = 0; i < matrixQ->getHeight(); i++)
+        this->cellLocations.resize(this->solutionX.size());
+        for (size_t i = 0; i < this->solutionX.size(); i++)
+        {
+            this->cellLocations[i] = {this->solutionX[i], this->solutionY[i]};
+        }
+
+        return {statistics[0], statistics[1]};
+    }
+
+    std::pair<SolverStatistics, SolverStatistics> AnalyticPlacer::resolvePlacement(const std::vector<std::pair<double, double>> &initialLocations)
+    {
+        this->buildMatrices();
+
+        if (!initialLocations.empty())
+        {
+            assert(initialLocations.size() == this->solutionX.size());
+
+            for (size_t i = 0; i < initialLocations.size(); i++)
+            {
+                this->solutionX[i] = initialLocations[i].first;
+                this->solutionY[i] = initialLocations[i].second;
+            }
+        }
+
+        return this->calculateCellLocations();
+    }
+
+    void AnalyticPlacer::updatePadLocations()
+    {
+        if (nullptr == this->matrixQ)
+        {
+            return;
+        }
+
+        delete this->matrixDx;
+        delete this->matrixDy;
+        std::tie(this->matrixDx, this->matrixDy) = DMatrix::createPair(this->hypergraph.pinLocations.data(), this->hypergraph.numCells_noPads,
+                                                                       this->matrixQ->getStarNodeCount(),
+                                                                       this->matrixQ->getPadConnections());
+        this->resetRightHandSides();
+    }
+
+    void AnalyticPlacer::applyAnchors(const std::vector<std::pair<double, double>> &targets, double weight)
+    {
+        // Start from Dx/Dy with only the pad connections
+        this->resetRightHandSides();
+        this->anchorWeights.assign(this->matrixQ->getHeight(), 0);
+
+        // Distances to the targets are measured in bins, which are never taken to be smaller than one site
+        this->createBins();
+        const double binWidth = std::max(this->binGrid.getBinWidth(), 1.0);
+        const double binHeight = std::max(this->binGrid.getBinHeight(), 1.0);
+
+        // An anchor is a connection to a fixed point, just like an I/O pad. Star nodes are not anchored.
+        // As in FastPlace the weight is relative to the weight of the cell's connections, so strongly connected
+        // cells move as well, and inversely proportional to the distance to the target, so every cell is pulled
+        // with about the same force instead of far away cells dominating the wirelength
+        for (int i = 0; i < this->hypergraph.numCells_noPads; i++)
         {
-            this->cellLocations.push_back({resultX->get(0, i), resultY->get(0, i)});
+            const double distance = std::abs(this->solutionX[i] - targets[i].first) / binWidth + std::abs(this->solutionY[i] - targets[i].second) / binHeight;
+            const double cellWeight = weight * this->matrixQ->getConnectionWeight(i) / std::max(distance, ANCHOR_MINIMUM_DISTANCE);
+
+            this->anchorWeights[i] = cellWeight;
+            this->rhsX[i] += cellWeight * targets[i].first;
+            this->rhsY[i] += cellWeight * targets[i].second;
+        }
+
+        this->matrixQ->setAnchorWeights(this->anchorWeights);
+
+        if (nullptr != this->preconditioner)
+        {
+            this->preconditioner->setup(*this->matrixQ);
+        }
+    }
+
+    void AnalyticPlacer::resetRightHandSides()
+    {
+        const double *dx = this->matrixDx->getData();
+        const double *dy = this->matrixDy->getData();
+
+        this->rhsX.assign(dx, dx + this->matrixDx->getHeight());
+        this->rhsY.assign(dy, dy + this->matrixDy->getHeight());
+    }
+
+    void AnalyticPlacer::runGlobalPlacement()
+    {
+        double hpwl = this->calculateHPWL(this->solutionX.data(), this->solutionY.data());
+        double overflow = this->calculateOverflow();
+
+        std::cout << "Global placement iteration 0: overflow " << overflow << ", HPWL " << hpwl
+                  << ", quadratic wirelength " << this->calculateTotalWirelength(this->solutionX.data(), this->solutionY.data()) << std::endl;
+
+        // The iterate the loop ends with: the one with the lowest HPWL of those at or below the target overflow,
+        // or the starting solution if none of them get there. More iterations can then never make the result worse.
+        int bestIteration = 0;
+        double bestHpwl = hpwl;
+        bool bestReachedTarget = overflow <= this->settings.targetOverflow;
+        std::vector<double> bestX = this->solutionX;
+        std::vector<double> bestY = this->solutionY;
+
+        for (int iteration = 1; iteration <= this->settings.globalIterations; iteration++)
+        {
+            if (overflow <= this->settings.targetOverflow)
+            {
+                std::cout << "Reached the target overflow of " << this->settings.targetOverflow << std::endl;
+                break;
+            }
+
+            // Pull every cell towards where cell shifting wants it, harder every iteration
+            this->shiftCells();
+            this->applyAnchors(this->spreadedCellLocations, this->settings.anchorWeight * iteration);
+
+            // Starts from the previous solution
+            this->calculateCellLocations();
+
+            const double previousHpwl = hpwl;
+            const double previousOverflow = overflow;
+            hpwl = this->calculateHPWL(this->solutionX.data(), this->solutionY.data());
+            overflow = this->calculateOverflow();
+
+            std::cout << "Global placement iteration " << iteration << ": overflow " << overflow << ", HPWL " << hpwl
+                      << ", quadratic wirelength " << this->calculateTotalWirelength(this->solutionX.data(), this->solutionY.data()) << std::endl;
+
+            if (overflow <= this->settings.targetOverflow && (!bestReachedTarget || hpwl < bestHpwl))
+            {
+                bestIteration = iteration;
+                bestHpwl = hpwl;
+                bestReachedTarget = true;
+                bestX = this->solutionX;
+                bestY = this->solutionY;
+            }
+
+            if (std::abs(overflow - previousOverflow) < GLOBAL_OVERFLOW_TOLERANCE
+                && std::abs(hpwl - previousHpwl) < GLOBAL_HPWL_TOLERANCE * previousHpwl)
+            {
+                std::cout << "Global placement converged" << std::endl;
+                break;
+            }
+        }
+
+        if (bestX != this->solutionX || bestY != this->solutionY)
+        {
+            std::cout << "Keeping the placement of global placement iteration " << bestIteration << " (HPWL " << bestHpwl << ")" << std::endl;
+
+            this->solutionX = std::move(bestX);
+            this->solutionY = std::move(bestY);
+            for (size_t i = 0; i < this->solutionX.size(); i++)
+            {
+                this->cellLocations[i] = {this->solutionX[i], this->solutionY[i]};
+            }
+        }
+    }
+
+    void AnalyticPlacer::runNesterovPlacement()
+    {
+        const auto chipDimensions = this->calculateChipDimensions();
+
+        const Hypergraph &graph = this->hypergraph;
+
+        // About one bin per cell, as in ePlace, with at most densityBins bins per side
+        int bins = 2;
+        while (4L * bins * bins <= graph.numCells_noPads && bins * 2 <= this->settings.densityBins)
+        {
+            bins *= 2;
+        }
+        ElectrostaticDensity density(bins, bins, this->threadPool);
+        density.setTargetDensity(this->settings.targetDensity);
+
+        NesterovPlacer nesterov(graph.numCells_noPads, graph.numhyper, graph.cellPinArray.data(), graph.hEdge_idxToFirstEntryInPinArray.data(),
+                                graph.hyperwts.data(), graph.pinLocations.data(), graph.vertexSize.data(), density, this->threadPool);
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const NesterovStatistics statistics = nesterov.place(this->solutionX.data(), this->solutionY.data(), chipDimensions.first, chipDimensions.second,
+                                                             this->settings.nesterovIterations, this->settings.targetOverflow);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        std::cout << "Nesterov placement finished after " << statistics.iterations << " iterations in " << elapsed.count() * 1000 << " ms"
+                  << " (overflow " << statistics.overflow << ", WA wirelength " << statistics.wirelength << ")" << std::endl;
+
+        this->placeStarNodes();
+
+        for (size_t i = 0; i < this->solutionX.size(); i++)
+        {
+            this->cellLocations[i] = {this->solutionX[i], this->solutionY[i]};
+        }
+    }
+
+    void AnalyticPlacer::placeStarNodes()
+    {
+        int star = this->hypergraph.numCells_noPads;
+
+        for (int i = 0; i < this->hypergraph.numhyper; i++)
+        {
+            const int first = this->hypergraph.hEdge_idxToFirstEntryInPinArray[i];
+            const int degree = this->hypergraph.hEdge_idxToFirstEntryInPinArray[i + 1] - first;
+
+            if (!QMatrix::isStarHyperedge(degree))
+            {
+                continue;
+            }
+
+            double sumX = 0;
+            double sumY = 0;
+            for (int j = first; j < first + degree; j++)
+            {
+                const int cell = this->hypergraph.cellPinArray[j];
+
+                if (cell < this->hypergraph.numCells_noPads)
+                {
+                    sumX += this->solutionX[cell];
+                    sumY += this->solutionY[cell];
+                }
+                else
+                {
+                    // I/O pad
+                    sumX += this->hypergraph.pinLocations[cell - this->hypergraph.numCells_noPads].x;
+                    sumY += this->hypergraph.pinLocations[cell - this->hypergraph.numCells_noPads].y;
+                }
+            }
+
+            this->solutionX[star] = sumX / degree;
+            this->solutionY[star] = sumY / degree;
+            star++;
         }
+    }
 
-        saveCellLocationsToDisk("preSpread.kiaPad");
+    const std::vector<std::pair<double, double>>& AnalyticPlacer::getCellLocations() const
+    {
+        return this->cellLocations;
     }
 
     std::pair<double, double> AnalyticPlacer::calculateChipDimensions()
@@ -182,29 +437,75 @@ namespace PA3Placement
         }
 
         // Check I/O pad coordinates now
-        for (int i = 0; i < numCellsAndPads - numCells_noPads; i++)
+        for (int i = 0; i < this->hypergraph.getPadCount(); i++)
         {
-            if (pinLocations[i].x > dimensions.first)
+            if (this->hypergraph.pinLocations[i].x > dimensions.first)
             {
-                dimensions.first = pinLocations[i].x;
+                dimensions.first = this->hypergraph.pinLocations[i].x;
             }
 
-            if (pinLocations[i].y > dimensions.second)
+            if (this->hypergraph.pinLocations[i].y > dimensions.second)
             {
-                dimensions.second = pinLocations[i].y;
+                dimensions.second = this->hypergraph.pinLocations[i].y;
             }
         }
 
         return dimensions;
     }
 
-    void AnalyticPlacer::doPlacement(std::string filePrefix)
+    void AnalyticPlacer::buildMatrices()
     {
+        if (nullptr != this->matrixQ)
+        {
+            return;
+        }
+
         std::cout << "Constructing Matrices..." << std::endl;
         // Create Q, Dx, Dy matrices
-        this->matrixQ = new QMatrix(numCells_noPads, numCellsAndPads, numhyper, cellPinArray, hEdge_idxToFirstEntryInPinArray, hyperwts);
-        this->matrixDx = new DMatrix(DMatrix::Dimension::X, pinLocations, numCells_noPads, this->matrixQ->getStarNodeCount(), this->matrixQ->getCellConnectionsList());
-        this->matrixDy = new DMatrix(DMatrix::Dimension::Y, pinLocations, numCells_noPads, this->matrixQ->getStarNodeCount(), this->matrixQ->getCellConnectionsList());
+        const auto constructionStart = std::chrono::steady_clock::now();
+        const Hypergraph &graph = this->hypergraph;
+        this->matrixQ = new QMatrix(graph.numCells_noPads, graph.numCellsAndPads, graph.numhyper, graph.cellPinArray.data(), graph.hEdge_idxToFirstEntryInPinArray.data(),
+                                    graph.hyperwts.data(), this->threadPool);
+        std::tie(this->matrixDx, this->matrixDy) = DMatrix::createPair(graph.pinLocations.data(), graph.numCells_noPads, this->matrixQ->getStarNodeCount(),
+                                                                       this->matrixQ->getPadConnections());
+        this->resetRightHandSides();
+        const std::chrono::duration<double, std::milli> constructionTime = std::chrono::steady_clock::now() - constructionStart;
+        std::cout << "Matrices constructed in " << constructionTime.count() << " ms" << std::endl;
+
+        // Lets the solver split the matrix products over the threads by rows. On a single thread the
+        // scatter based product is faster, it only reads the stored triangle once
+        if (this->threadPool->getThreadCount() > 1)
+        {
+            this->matrixQ->buildTransposeIndex();
+            std::cout << "Solving with " << this->threadPool->getThreadCount() << " threads" << std::endl;
+        }
+        std::cout << "Using " << getVectorKernels().name << " vector kernels" << std::endl;
+
+        this->preconditioner = createPreconditioner(this->settings.preconditioner, this->settings.ssorOmega);
+        if (nullptr != this->preconditioner)
+        {
+            const auto setupStart = std::chrono::steady_clock::now();
+            this->preconditioner->setup(*this->matrixQ);
+            const std::chrono::duration<double, std::milli> setupTime = std::chrono::steady_clock::now() - setupStart;
+
+            std::cout << "Preconditioner " << this->preconditioner->getName() << " set up in " << setupTime.count() << " ms" << std::endl;
+        }
+        else
+        {
+            std::cout << "Solving without a preconditioner" << std::endl;
+        }
+
+        this->solver = new ConjugateGradientSolver(*this->matrixQ, CONJ_GRADIENT_TOLERANCE, CONJ_GRADIENT_ITERATIONS, this->preconditioner, this->threadPool);
+        this->wirelengthEvaluator = new WirelengthEvaluator(*this->matrixQ, graph.numCells_noPads, graph.numhyper, graph.cellPinArray.data(),
+                                                            graph.hEdge_idxToFirstEntryInPinArray.data(), graph.hyperwts.data(), graph.pinLocations.data(),
+                                                            this->threadPool);
+        this->solutionX.assign(this->matrixQ->getHeight(), 0);
+        this->solutionY.assign(this->matrixQ->getHeight(), 0);
+    }
+
+    void AnalyticPlacer::doPlacement(std::string filePrefix)
+    {
+        this->buildMatrices();
 
         //std::cout << *this->matrixQ << std::endl << std::endl;
 #if 0
@@ -237,7 +538,6 @@ namespace PA3Placement
             }
             else if (dx == 0 && dy == 0)
             {
-                auto connections = this->matrixQ->getCellConnectionsList()->at(i);
                 std::cerr << "Problem at " << i << std::endl;
                 std::cerr << diagonal << " " << nonDiag << "( Dx/Dy: " << this->matrixDx->get(0, i) << " " << this->matrixDy->get(0, i) << ")" << std::endl;
 
@@ -255,16 +555,41 @@ namespace PA3Placement
         std::cout << "Solving Matrices..." << std::endl;
 #if 1
         this->calculateCellLocations();
+        if (this->settings.saveFiles)
+        {
+            this->saveCellLocationsToDisk(filePrefix + "_preSpread.kiaPad");
+        }
 
-        double wirelength = this->calculateTotalWirelength(this->cellLocations);
+        double wirelength = this->calculateTotalWirelength(this->solutionX.data(), this->solutionY.data());
 
         std::cout << "Total Wirelength: " << wirelength << std::endl;
         std::cout << "Sqrt of total Wirelength: " << sqrt(wirelength) << std::endl;
 
+        if (this->settings.globalPlacement == GlobalPlacementMode::NESTEROV)
+        {
+            std::cout << "Nonlinear global placement..." << std::endl;
+            this->runNesterovPlacement();
+
+            std::cout << "Sqrt of total Wirelength (global placement): " << sqrt(this->calculateTotalWirelength(this->solutionX.data(), this->solutionY.data())) << std::endl;
+        }
+        else if (this->settings.globalIterations > 0)
+        {
+            std::cout << "Global placement..." << std::endl;
+            this->runGlobalPlacement();
+
+            std::cout << "Sqrt of total Wirelength (global placement): " << sqrt(this->calculateTotalWirelength(this->solutionX.data(), this->solutionY.data())) << std::endl;
+        }
+
         std::cout << "Spreading..." << std::endl;
         this->doSpreading(filePrefix);
 
-        std::cout << "Sqrt of total Wirelength (post-spreading): " << sqrt(this->calculateTotalWirelength(this->spreadedCellLocations)) << std::endl;
+        std::cout << "Sqrt of total Wirelength (post-spreading): " << sqrt(this->calculateTotalWirelength(this->spreadedX.data(), this->spreadedY.data())) << std::endl;
+
+        if (this->settings.legalization != LegalizationMode::NONE)
+        {
+            std::cout << "Legalizing..." << std::endl;
+            this->doLegalization(filePrefix);
+        }
 #else
         std::cout << *this->matrixQ * *this->matrixDx << std::endl;
 
@@ -277,220 +602,243 @@ namespace PA3Placement
     void AnalyticPlacer::createBins()
     {
         const auto chipDimensions = this->calculateChipDimensions();
-        const double xBinSize = chipDimensions.first / NUM_BINS;
-        const double yBinSize = chipDimensions.second / NUM_BINS;
-
-        bins.clear();
-
-        // Divide the chip into bins
-        double x = xBinSize;
-        double y = yBinSize;
-        for (unsigned int i = 0; i < NUM_BINS; i++)
-        {
-            for (unsigned int j = 0; j < NUM_BINS; j++)
-            {
-                Bin bin = {x - xBinSize, x, y - yBinSize, y, 0};
 
-                x += xBinSize;
-
-                bins.push_back(bin);
-            }
-
-            x = xBinSize;
-            y += yBinSize;
-        }
+        this->binGrid.setChipDimensions(chipDimensions.first, chipDimensions.second);
     }
 
     void AnalyticPlacer::calculateSpreadedCellLocations()
     {
-        const auto chipDimensions = this->calculateChipDimensions();
+        const BinGrid &grid = this->binGrid;
+        const int binsX = grid.getBinsX();
+        const int binsY = grid.getBinsY();
+
+        // Every cell moves to SPREADING_ALPHA of the way from where it is to where the linear map from its
+        // old bin to its shifted bin puts it, x' = scale * x + offset with one scale/offset pair per bin
+        std::vector<double> scaleX(grid.getBinCount());
+        std::vector<double> offsetX(grid.getBinCount());
+        std::vector<double> scaleY(grid.getBinCount());
+        std::vector<double> offsetY(grid.getBinCount());
+
+        auto shiftCoefficients = [](double OBxMinus1, double OBx, double NBxMinus1, double NBx, double &scale, double &offset)
+        {
+            const double width = OBx - OBxMinus1;
 
-        std::vector<Bin> unequalBins;
+            scale = 1 - SPREADING_ALPHA + SPREADING_ALPHA * (NBx - NBxMinus1) / width;
+            offset = SPREADING_ALPHA * (NBxMinus1 * OBx - NBx * OBxMinus1) / width;
+        };
 
-        for (unsigned int i = 0; i < bins.size(); i ++)
+        // The X boundaries of a row only depend on the utilization of that row, so rows are independent
+        this->threadPool->parallelFor(binsY, [&](long firstRow, long lastRow)
         {
-            auto bin = bins.at(i);
-
-            double OBx = bin.upperX;
-            double OBy = bin.upperY;
-            double OBxMinus1 = bin.lowerX;
-            double OByMinus1 = bin.lowerY;
-            double OBxPlus1;
-            double OByPlus1;
-            double UxPlus1;
-            double UyPlus1;
+            for (long row = firstRow; row < lastRow; row++)
+            {
+                // Assume we are the first bin in the row
+                double NBxMinus1 = 0;
 
-            double Ux = bin.utilization;
-            double Uy = bin.utilization;
+                for (int column = 0; column < binsX; column++)
+                {
+                    const int i = row * binsX + column;
 
-            // Assume we are the first bin in the row or column
-            double NBxMinus1 = 0;
-            double NByMinus1 = 0;
-            double NBx;
-            double NBy;
+                    double OBx = grid.getUpperX(column);
+                    double OBxMinus1 = grid.getLowerX(column);
+                    double Ux = grid.getUtilization(i);
+                    double NBx;
 
-            if (bin.lowerX != 0)
-            {
-                // We are not the first bin in the row
-                NBxMinus1 = unequalBins.at(i - 1).upperX;
-            }
+                    if (column == binsX - 1)
+                    {
+                        // We are the last bin in the row
+                        NBx = OBx;
+                    }
+                    else
+                    {
+                        // In middle of row
+                        double OBxPlus1 = grid.getUpperX(column + 1);
+                        double UxPlus1 = grid.getUtilization(i + 1);
 
-            if (bin.upperX == chipDimensions.first)
-            {
-                // We are the last bin in the row
-                NBx = bin.upperX;
-            }
-            else
-            {
-                // In middle of row
-                OBxPlus1 = bins.at(i + 1).upperX;
-                UxPlus1 = bins.at(i + 1).utilization;
+                        double top = (OBxMinus1 * (UxPlus1 + SPREADING_SIGMA) + OBxPlus1 * (Ux + SPREADING_SIGMA));
+                        double bottom = (Ux + UxPlus1 + (2 * SPREADING_SIGMA));
 
-                double top = (OBxMinus1 * (UxPlus1 + SPREADING_SIGMA) + OBxPlus1 * (Ux + SPREADING_SIGMA));
-                double bottom = (Ux + UxPlus1 + (2 * SPREADING_SIGMA));
+                        NBx = top / bottom;
+                    }
 
-                NBx = top / bottom;
+                    shiftCoefficients(OBxMinus1, OBx, NBxMinus1, NBx, scaleX[i], offsetX[i]);
+#ifdef DEBUG
+                    std::cout << "Bin " << i << " X: " << OBxMinus1 << " to " << OBx << " -> " << NBxMinus1 << " to " << NBx << std::endl;
+#endif
+                    NBxMinus1 = NBx;
+                }
             }
+        });
 
-            if (bin.lowerY != 0)
+        // Likewise for the Y boundaries of every column
+        this->threadPool->parallelFor(binsX, [&](long firstColumn, long lastColumn)
+        {
+            for (long column = firstColumn; column < lastColumn; column++)
             {
-                // We are not the first bin in the column
-                NByMinus1 = unequalBins.at(i - NUM_BINS).upperY;
-            }
+                // Assume we are the first bin in the column
+                double NByMinus1 = 0;
 
-            if (bin.upperY == chipDimensions.second)
-            {
-                // We are the last bin in the column
-                NBy = bin.upperY;
-            }
-            else
-            {
-                // In middle of column
-                OByPlus1 = bins.at(i + NUM_BINS).upperY;
-                UyPlus1 = bins.at(i + NUM_BINS).utilization;
+                for (int row = 0; row < binsY; row++)
+                {
+                    const int i = row * binsX + column;
 
-                double top = (OByMinus1 * (UyPlus1 + SPREADING_SIGMA) + OByPlus1 * (Uy + SPREADING_SIGMA));
-                double bottom = (Uy + UyPlus1 + (2 * SPREADING_SIGMA));
+                    double OBy = grid.getUpperY(row);
+                    double OByMinus1 = grid.getLowerY(row);
+                    double Uy = grid.getUtilization(i);
+                    double NBy;
 
-                NBy = top / bottom;
-            }
+                    if (row == binsY - 1)
+                    {
+                        // We are the last bin in the column
+                        NBy = OBy;
+                    }
+                    else
+                    {
+                        // In middle of column
+                        double OByPlus1 = grid.getUpperY(row + 1);
+                        double UyPlus1 = grid.getUtilization(i + binsX);
 
-            for (auto &cell : bin.memberCells)
-            {
-                auto cellPos = this->cellLocations.at(cell);
+                        double top = (OByMinus1 * (UyPlus1 + SPREADING_SIGMA) + OByPlus1 * (Uy + SPREADING_SIGMA));
+                        double bottom = (Uy + UyPlus1 + (2 * SPREADING_SIGMA));
 
-                double originalX = cellPos.first;
-                double originalY = cellPos.second;
+                        NBy = top / bottom;
+                    }
 
-                double topX = (NBx * (originalX - OBxMinus1) + NBxMinus1 * (OBx - originalX));
-                double topY = (NBy * (originalY - OByMinus1) + NByMinus1 * (OBy - originalY));
-                double bottomX = (OBx - OBxMinus1);
-                double bottomY = (OBy - OByMinus1);
-                double newCoordX = topX / bottomX;
-                double newCoordY = topY / bottomY;
+                    shiftCoefficients(OByMinus1, OBy, NByMinus1, NBy, scaleY[i], offsetY[i]);
+#ifdef DEBUG
+                    std::cout << "Bin " << i << " Y: " << OByMinus1 << " to " << OBy << " -> " << NByMinus1 << " to " << NBy << std::endl;
+#endif
+                    NByMinus1 = NBy;
+                }
+            }
+        });
 
-                double distanceX = (SPREADING_ALPHA * abs(newCoordX - originalX));
-                double distanceY = (SPREADING_ALPHA * abs(newCoordY - originalY));
+        // The solution vectors hold the cell coordinates as separate X and Y arrays
+        const double *cellX = this->solutionX.data();
+        const double *cellY = this->solutionY.data();
+        const int *cellBins = grid.getCellBins();
+        const VectorKernels &kernels = getVectorKernels();
 
-                // Set direction to move based on where the new coordinate was supposed to be compared to the current
-                if (newCoordX < originalX)
-                {
-                    distanceX = -distanceX;
-                }
+        // Star nodes keep their locations
+        this->spreadedX.assign(this->solutionX.begin(), this->solutionX.end());
+        this->spreadedY.assign(this->solutionY.begin(), this->solutionY.end());
 
-                if (newCoordY < originalY)
-                {
-                    distanceY = -distanceY;
-                }
+        this->threadPool->parallelFor(this->hypergraph.numCells_noPads, [&](long begin, long end)
+        {
+            kernels.gatherAffine(scaleX.data(), offsetX.data(), cellBins + begin, cellX + begin, this->spreadedX.data() + begin, end - begin);
+            kernels.gatherAffine(scaleY.data(), offsetY.data(), cellBins + begin, cellY + begin, this->spreadedY.data() + begin, end - begin);
 
-                spreadedCellLocations.at(cell) = {cellPos.first + distanceX,
-                                                 cellPos.second + distanceY};
+            for (long cell = begin; cell < end; cell++)
+            {
+                this->spreadedCellLocations[cell] = {this->spreadedX[cell], this->spreadedY[cell]};
             }
+        });
+    }
 
-            unequalBins.push_back({NBxMinus1, NBx, NByMinus1, NBy, 0});
-            std::cout << "Bin " << i << "old: (X: " << bin.lowerX << " to " << bin.upperX << ", Y: " << bin.lowerY << " to " << bin.upperY;
-            std::cout << ") new: (X: " << NBxMinus1 << " to " << NBx << ", Y: " << NByMinus1 << " to " << NBy << ")" << std::endl;
+    void AnalyticPlacer::updateBinUtilizations()
+    {
+        // Only movable cells, no I/O pads or star nodes
+        this->binGrid.assignCells(this->cellLocations, this->hypergraph.numCells_noPads, this->hypergraph.vertexSize.data());
+    }
+
+    void AnalyticPlacer::doSpreading(std::string filePrefix)
+    {
+        this->shiftCells();
+
+        if (this->settings.saveFiles)
+        {
+            this->saveSpreadedCellsToDisk(filePrefix + "_spread.kiaPad");
         }
     }
 
-    int AnalyticPlacer::getBinIndex(std::pair<double, double> pos, std::vector<Bin> &binsList)
+    void AnalyticPlacer::doLegalization(std::string filePrefix)
     {
-        int foundBin = -1;
+        const auto chipDimensions = this->calculateChipDimensions();
 
-        for (unsigned int i = 0; i < binsList.size(); i++)
+        std::vector<double> x(this->hypergraph.numCells_noPads);
+        std::vector<double> y(this->hypergraph.numCells_noPads);
+        for (int i = 0; i < this->hypergraph.numCells_noPads; i++)
         {
-            auto bin = binsList.at(i);
+            x[i] = this->spreadedCellLocations[i].first;
+            y[i] = this->spreadedCellLocations[i].second;
+        }
 
-            if (pos.first >= bin.lowerX && pos.first <= bin.upperX
-                && pos.second >= bin.lowerY && pos.second <= bin.upperY)
-            {
-                foundBin = i;
-                break;
-            }
+        // Cells are one row high, so their size is their width in sites
+        std::vector<double> legalX(this->hypergraph.numCells_noPads);
+        std::vector<double> legalY(this->hypergraph.numCells_noPads);
+        Legalizer legalizer(chipDimensions.first, chipDimensions.second);
+
+        const auto startTime = std::chrono::steady_clock::now();
+        const LegalizationStatistics statistics = legalizer.legalize(this->settings.legalization, x.data(), y.data(), this->hypergraph.vertexSize.data(),
+                                                                     this->hypergraph.numCells_noPads,
+                                                                     legalX.data(), legalY.data());
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - startTime;
+
+        std::cout << "Legalized into " << statistics.rows << " rows of width " << statistics.rowWidth << " in " << elapsed.count() * 1000 << " ms"
+                  << " (total displacement " << statistics.totalDisplacement << ", maximum " << statistics.maximumDisplacement << ")" << std::endl;
+        if (statistics.rowWidth > chipDimensions.first)
+        {
+            std::cout << "Warning: the cells do not fit in the chip width of " << chipDimensions.first << ", rows were widened" << std::endl;
+        }
+        if (statistics.cellsOutsideRows > 0)
+        {
+            std::cout << "Warning: " << statistics.cellsOutsideRows << " cells were placed past the end of their row" << std::endl;
         }
 
-        return foundBin;
-    }
+        std::cout << "HPWL (legalized): " << this->calculateHPWL(legalX.data(), legalY.data()) << std::endl;
 
-    // Get the bin a specific point belongs in
-    Bin* AnalyticPlacer::getBin(std::pair<double, double> pos, std::vector<Bin> &binsList)
-    {
-        int index = this->getBinIndex(pos, binsList);
-        if (index < 0)
+        if (this->settings.legalization != LegalizationMode::NONE && this->settings.detailedPasses > 0)
         {
-            return nullptr;
+            const Hypergraph &graph = this->hypergraph;
+            DetailedPlacer detailedPlacer(graph.numCells_noPads, graph.numhyper, graph.cellPinArray.data(), graph.hEdge_idxToFirstEntryInPinArray.data(),
+                                          graph.hyperwts.data(), graph.pinLocations.data(), graph.vertexSize.data(), *this->wirelengthEvaluator,
+                                          this->threadPool);
+
+            const auto detailedStartTime = std::chrono::steady_clock::now();
+            const DetailedPlacementStatistics detailedStatistics = detailedPlacer.place(legalX.data(), legalY.data(), 1.0, this->settings.detailedPasses);
+            const std::chrono::duration<double> detailedElapsed = std::chrono::steady_clock::now() - detailedStartTime;
+
+            std::cout << "Detailed placement: " << detailedStatistics.swaps << " global swaps, " << detailedStatistics.matchedCells
+                      << " cells moved by independent set matching, " << detailedStatistics.reorders << " local reorderings in "
+                      << detailedElapsed.count() * 1000 << " ms" << std::endl;
+            std::cout << "HPWL (detailed placement): " << detailedStatistics.finalHPWL << std::endl;
         }
-        else
+
+        this->legalCellLocations.resize(this->hypergraph.numCells_noPads);
+        for (int i = 0; i < this->hypergraph.numCells_noPads; i++)
         {
-            return &binsList.at(index);
+            this->legalCellLocations[i] = {legalX[i], legalY[i]};
         }
-    }
 
-    void AnalyticPlacer::updateBinUtilizations()
-    {
-        const int cellArea = 1; // Assuming each cell is 1x1
+        if (!this->settings.saveFiles)
+        {
+            return;
+        }
+
+        std::ofstream fout(filePrefix + "_legal.kiaPad");
 
-        // Iterate through each cell, determine which bin it is in and update that bin's area
-        for (unsigned int i = 0; i < cellLocations.size(); i++)
+        for (int i = 0; i < this->hypergraph.numCells_noPads; i++)
         {
-            // Only care about movable cells, no I/O pads or star nodes
-            if (i < numCells_noPads)
-            {
-                {
-                    Bin *bin = getBin(cellLocations.at(i), bins);
-
-                    if (bin != nullptr) {
-                        // Add the cell to this bin
-                        bin->memberCells.push_back(i);
-                    } else {
-                        std::cerr << "Failed to determine bin for cell at " << cellLocations.at(i).first << ", "
-                                  << cellLocations.at(i).second;
-                        std::cerr << " Cell is probably outside the chip area" << std::endl;
-                    }
-                }
-            }
+            fout << i << " " << legalX[i] << " " << legalY[i] << std::endl;
         }
 
-        for (auto &bin : bins)
+        // Now add the I/O pads
+        for (int i = 0; i < this->hypergraph.getPadCount(); i++)
         {
-            double binArea = (bin.upperX - bin.lowerX) * (bin.upperY - bin.lowerY);
-            bin.utilization = bin.memberCells.size() * cellArea / binArea;
+            fout << "p" << i << " " << this->hypergraph.pinLocations[i].x << " " << this->hypergraph.pinLocations[i].y << std::endl;
         }
     }
 
-    void AnalyticPlacer::doSpreading(std::string filePrefix)
+    void AnalyticPlacer::shiftCells()
     {
-        this->spreadedCellLocations.resize(cellLocations.size());
-        this->spreadedCellLocations.clear();
+        // Star nodes keep their locations, I/O pads are not part of the list
+        const long movableCount = std::min<long>(this->hypergraph.numCells_noPads + this->matrixQ->getStarNodeCount(), this->cellLocations.size());
+        this->spreadedCellLocations.assign(this->cellLocations.begin(), this->cellLocations.begin() + movableCount);
 
-        // Only copy movable cell locations to our spreaded cell list
-        for (unsigned int i = 0; i < cellLocations.size(); i++)
+        if (this->settings.spreading == SpreadingMethod::ELECTROSTATIC)
         {
-            // Only care about movable cells, no I/O pads
-            if (i < numCells_noPads + this->matrixQ->getStarNodeCount())
-            {
-                this->spreadedCellLocations.push_back(cellLocations.at(i));
-            }
+            this->calculateElectrostaticSpreading();
+            return;
         }
 
         this->createBins();
@@ -498,7 +846,59 @@ namespace PA3Placement
 
         // Creates the uneqal bins and computes the spreaded cell locations
         this->calculateSpreadedCellLocations();
+    }
+
+    void AnalyticPlacer::calculateElectrostaticSpreading()
+    {
+        const auto chipDimensions = this->calculateChipDimensions();
+        this->density->setChipDimensions(chipDimensions.first, chipDimensions.second);
+
+        const double stepLength = ELECTROSTATIC_STEP_SIZE * std::min(this->density->getBinWidth(), this->density->getBinHeight());
+
+        // Star nodes keep their locations
+        this->spreadedX.assign(this->solutionX.begin(), this->solutionX.end());
+        this->spreadedY.assign(this->solutionY.begin(), this->solutionY.end());
+        std::vector<double> forceX(this->hypergraph.numCells_noPads);
+        std::vector<double> forceY(this->hypergraph.numCells_noPads);
 
-        this->saveSpreadedCellsToDisk(filePrefix + "_spread.kiaPad");
+        for (int step = 0; step < ELECTROSTATIC_STEPS; step++)
+        {
+            const double energy = this->density->update(this->spreadedX.data(), this->spreadedY.data(), this->hypergraph.vertexSize.data(), this->hypergraph.numCells_noPads);
+            const double maximumField = this->density->getMaximumField();
+#ifdef DEBUG
+            std::cout << "Electrostatic spreading step " << step << ": energy " << energy << std::endl;
+#else
+            (void) energy;
+#endif
+            if (maximumField <= 0)
+            {
+                break;
+            }
+
+            this->density->calculateForces(this->spreadedX.data(), this->spreadedY.data(), this->hypergraph.vertexSize.data(), this->hypergraph.numCells_noPads,
+                                           forceX.data(), forceY.data());
+
+            // The force is area times field, cells move along the field so no cell moves further than stepLength
+            const double scale = stepLength / maximumField;
+            this->threadPool->parallelFor(this->hypergraph.numCells_noPads, [&](long begin, long end)
+            {
+                for (long i = begin; i < end; i++)
+                {
+                    if (this->hypergraph.vertexSize[i] > 0)
+                    {
+                        const double x = this->spreadedX[i] + scale * forceX[i] / this->hypergraph.vertexSize[i];
+                        const double y = this->spreadedY[i] + scale * forceY[i] / this->hypergraph.vertexSize[i];
+
+                        this->spreadedX[i] = std::min(std::max(x, 0.0), chipDimensions.first);
+                        this->spreadedY[i] = std::min(std::max(y, 0.0), chipDimensions.second);
+                    }
+                }
+            });
+        }
+
+        for (int i = 0; i < this->hypergraph.numCells_noPads; i++)
+        {
+            this->spreadedCellLocations[i] = {this->spreadedX[i], this->spreadedY[i]};
+        }
     }
 }
@@ -0,0 +1,663 @@
+#include "solver.hpp"
+#include "vectorkernels.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cassert>
+
+namespace PA3Placement
+{
+    /**
+     * Matrices with fewer stored non-zeros than this are always solved on a single thread,
+     * waking the other threads up would cost more than the product itself.
+     */
+    static const long PARALLEL_MIN_NON_ZEROS = 20000;
+
+    // Per-thread partial dot products kept for each column
+    enum PartialSumSlot
+    {
+        SLOT_P_AP,
+        SLOT_R_R,
+        SLOT_R_Z,
+        SLOTS_PER_COLUMN
+    };
+
+    static const int PARTIAL_SLOTS = 2 * SLOTS_PER_COLUMN;
+
+    /**
+     * x += alpha * p, r -= alpha * Ap over the elements [begin, end)
+     * @return r . r over the same elements
+     */
+    static double updateSolutionAndResidual(long begin, long end, double alpha, const double *p, const double *Ap, double *x, double *r)
+    {
+        const VectorKernels &kernels = getVectorKernels();
+
+        kernels.axpy(alpha, p + begin, x + begin, end - begin);
+        return kernels.axpyAndNorm(-alpha, Ap + begin, r + begin, end - begin);
+    }
+
+    /**
+     * p = z + beta * p over the elements [begin, end)
+     */
+    static void updateSearchDirection(long begin, long end, double beta, const double *z, double *p)
+    {
+        getVectorKernels().xpby(z + begin, beta, p + begin, end - begin);
+    }
+
+    bool parsePreconditionerType(const std::string &name, PreconditionerType &type)
+    {
+        if (name == "none")
+        {
+            type = PreconditionerType::NONE;
+        }
+        else if (name == "jacobi")
+        {
+            type = PreconditionerType::JACOBI;
+        }
+        else if (name == "ssor")
+        {
+            type = PreconditionerType::SSOR;
+        }
+        else if (name == "ic0")
+        {
+            type = PreconditionerType::INCOMPLETE_CHOLESKY;
+        }
+        else
+        {
+            return false;
+        }
+
+        return true;
+    }
+
+    double Preconditioner::applyAndDotRows(const double *r, double *z, long begin, long end) const
+    {
+        // M^-1 couples the rows, so z can only be computed as a whole
+        this->apply(r, z);
+
+        double rz = 0;
+        for (long i = begin; i < end; i++)
+        {
+            rz += r[i] * z[i];
+        }
+
+        return rz;
+    }
+
+    double Preconditioner::applyAndDot(const double *r, double *z) const
+    {
+        this->apply(r, z);
+
+        double rz = 0;
+        for (long i = 0; i < this->size; i++)
+        {
+            rz += r[i] * z[i];
+        }
+
+        return rz;
+    }
+
+    void JacobiPreconditioner::setup(const SymmetricSparseMatrix<double> &Q)
+    {
+        this->size = Q.getHeight();
+        this->inverseDiagonal.resize(this->size);
+
+        for (long i = 0; i < this->size; i++)
+        {
+            this->inverseDiagonal[i] = 1.0 / Q.getDiagonal(i);
+        }
+    }
+
+    void JacobiPreconditioner::apply(const double *r, double *z) const
+    {
+        this->applyAndDotRows(r, z, 0, this->size);
+    }
+
+    double JacobiPreconditioner::applyAndDot(const double *r, double *z) const
+    {
+        return this->applyAndDotRows(r, z, 0, this->size);
+    }
+
+    double JacobiPreconditioner::applyAndDotRows(const double *r, double *z, long begin, long end) const
+    {
+        return getVectorKernels().multiplyAndDot(this->inverseDiagonal.data() + begin, r + begin, z + begin, end - begin);
+    }
+
+    SSORPreconditioner::SSORPreconditioner(double omega)
+    {
+        assert(omega > 0 && omega < 2);
+        this->omega = omega;
+    }
+
+    void SSORPreconditioner::setup(const SymmetricSparseMatrix<double> &Q)
+    {
+        this->matrix = &Q;
+        this->size = Q.getHeight();
+        this->scaledInverseDiagonal.resize(this->size);
+
+        for (long i = 0; i < this->size; i++)
+        {
+            this->scaledInverseDiagonal[i] = this->omega / Q.getDiagonal(i);
+        }
+    }
+
+    void SSORPreconditioner::apply(const double *r, double *z) const
+    {
+        const long *rowStart = this->matrix->getRowStart().data();
+        const int *columns = this->matrix->getColumnIndices().data();
+        const double *values = this->matrix->getValues().data();
+        const double *scaledInverseDiagonal = this->scaledInverseDiagonal.data();
+
+        std::copy(r, r + this->size, z);
+
+        // Forward solve (D/w + L) y = r. L is the transpose of the stored upper triangle,
+        // so walk the rows in order and push each finished y[i] into the later rows.
+        for (long i = 0; i < this->size; i++)
+        {
+            const double yi = z[i] * scaledInverseDiagonal[i];
+            z[i] = yi;
+
+            for (long k = rowStart[i] + 1; k < rowStart[i + 1]; k++)
+            {
+                z[columns[k]] -= values[k] * yi;
+            }
+        }
+
+        // Multiply by D/w
+        for (long i = 0; i < this->size; i++)
+        {
+            z[i] /= scaledInverseDiagonal[i];
+        }
+
+        // Backward solve (D/w + U) z = w, later elements of z are already final
+        const double scale = (2.0 - this->omega) / this->omega;
+        for (long i = this->size - 1; i >= 0; i--)
+        {
+            double sum = z[i];
+
+            for (long k = rowStart[i] + 1; k < rowStart[i + 1]; k++)
+            {
+                sum -= values[k] * z[columns[k]];
+            }
+
+            z[i] = sum * scaledInverseDiagonal[i];
+        }
+
+        for (long i = 0; i < this->size; i++)
+        {
+            z[i] *= scale;
+        }
+    }
+
+    void IncompleteCholeskyPreconditioner::setup(const SymmetricSparseMatrix<double> &Q)
+    {
+        this->matrix = &Q;
+        this->size = Q.getHeight();
+
+        const long *rowStart = Q.getRowStart().data();
+        const int *columns = Q.getColumnIndices().data();
+
+        this->factorValues = Q.getValues();
+        this->inverseDiagonal.resize(this->size);
+        double *u = this->factorValues.data();
+
+        // Right-looking factorization: once row i of U is final, subtract its outer product
+        // from the remaining rows, dropping any update outside the sparsity pattern of Q
+        for (long i = 0; i < this->size; i++)
+        {
+            const long start = rowStart[i];
+            const long end = rowStart[i + 1];
+
+            double pivot = u[start];
+            if (pivot <= 0)
+            {
+                // Factorization broke down, fall back to the original diagonal for this row
+                pivot = Q.getDiagonal(i);
+            }
+
+            const double uii = sqrt(pivot);
+            u[start] = uii;
+            this->inverseDiagonal[i] = 1.0 / uii;
+
+            for (long k = start + 1; k < end; k++)
+            {
+                u[k] *= this->inverseDiagonal[i];
+            }
+
+            for (long k = start + 1; k < end; k++)
+            {
+                const int j = columns[k];
+                const long rowJStart = rowStart[j];
+                const long rowJEnd = rowStart[j + 1];
+
+                // Diagonal of row j
+                u[rowJStart] -= u[k] * u[k];
+
+                // Off-diagonal (j, m) for every later column m of row i, if it is in the pattern
+                long search = rowJStart + 1;
+                for (long l = k + 1; l < end && search < rowJEnd; l++)
+                {
+                    const int m = columns[l];
+                    search = std::lower_bound(columns + search, columns + rowJEnd, m) - columns;
+
+                    if (search < rowJEnd && columns[search] == m)
+                    {
+                        u[search] -= u[k] * u[l];
+                    }
+                }
+            }
+        }
+    }
+
+    void IncompleteCholeskyPreconditioner::apply(const double *r, double *z) const
+    {
+        const long *rowStart = this->matrix->getRowStart().data();
+        const int *columns = this->matrix->getColumnIndices().data();
+        const double *u = this->factorValues.data();
+        const double *inverseDiagonal = this->inverseDiagonal.data();
+
+        std::copy(r, r + this->size, z);
+
+        // Forward solve U^T y = r
+        for (long i = 0; i < this->size; i++)
+        {
+            const double yi = z[i] * inverseDiagonal[i];
+            z[i] = yi;
+
+            for (long k = rowStart[i] + 1; k < rowStart[i + 1]; k++)
+            {
+                z[columns[k]] -= u[k] * yi;
+            }
+        }
+
+        // Backward solve U z = y
+        for (long i = this->size - 1; i >= 0; i--)
+        {
+            double sum = z[i];
+
+            for (long k = rowStart[i] + 1; k < rowStart[i + 1]; k++)
+            {
+                sum -= u[k] * z[columns[k]];
+            }
+
+            z[i] = sum * inverseDiagonal[i];
+        }
+    }
+
+    Preconditioner* createPreconditioner(PreconditionerType type, double ssorOmega)
+    {
+        switch (type)
+        {
+            case PreconditionerType::JACOBI:
+                return new JacobiPreconditioner();
+            case PreconditionerType::SSOR:
+                return new SSORPreconditioner(ssorOmega);
+            case PreconditionerType::INCOMPLETE_CHOLESKY:
+                return new IncompleteCholeskyPreconditioner();
+            case PreconditionerType::NONE:
+            default:
+                return nullptr;
+        }
+    }
+
+    std::ostream& operator<<(std::ostream &out, const SolverStatistics &statistics)
+    {
+        out << (statistics.converged ? "converged" : "did not converge") << " after " << statistics.iterations
+            << " iterations in " << statistics.seconds * 1000.0 << " ms (residual norm " << statistics.residualNorm << ")";
+        return out;
+    }
+
+    ConjugateGradientSolver::ConjugateGradientSolver(const SymmetricSparseMatrix<double> &Q, double tolerance, int maxIterations,
+                                                     const Preconditioner *preconditioner, ThreadPool *threadPool)
+        : Q(Q)
+    {
+        this->tolerance = tolerance;
+        this->maxIterations = maxIterations;
+        this->preconditioner = preconditioner;
+        this->threadPool = threadPool;
+        this->columnCount = 0;
+
+        if (threadPool != nullptr && threadPool->getThreadCount() > 1
+            && Q.hasTransposeIndex() && Q.getNonZeroCount() >= PARALLEL_MIN_NON_ZEROS)
+        {
+            this->rowPartition = Q.partitionRows(threadPool->getThreadCount());
+        }
+        else
+        {
+            this->rowPartition = {0, Q.getHeight()};
+        }
+
+        this->partialSums.resize((this->rowPartition.size() - 1) * PARTIAL_SLOTS);
+
+        this->allocateColumn(this->columns[0]);
+    }
+
+    void ConjugateGradientSolver::allocateColumn(ColumnState &column)
+    {
+        const long n = this->Q.getHeight();
+
+        column.r.resize(n);
+        column.p.resize(n);
+        column.Ap.resize(n);
+
+        // Without a preconditioner z is just r
+        if (this->preconditioner != nullptr)
+        {
+            column.z.resize(n);
+        }
+    }
+
+    template <typename Function>
+    void ConjugateGradientSolver::runPartitioned(Function function)
+    {
+        if (this->rowPartition.size() == 2)
+        {
+            function(0, this->rowPartition[0], this->rowPartition[1]);
+        }
+        else
+        {
+            this->threadPool->run([this, &function](int thread) {
+                function(thread, this->rowPartition[thread], this->rowPartition[thread + 1]);
+            });
+        }
+    }
+
+    double ConjugateGradientSolver::sumPartials(int column, int slot) const
+    {
+        // Always summed in thread order, so results do not depend on thread timing
+        double sum = 0;
+        for (size_t thread = 0; thread + 1 < this->rowPartition.size(); thread++)
+        {
+            sum += this->partialSums[thread * PARTIAL_SLOTS + column * SLOTS_PER_COLUMN + slot];
+        }
+
+        return sum;
+    }
+
+    void ConjugateGradientSolver::startColumns(int count, const double *const *b, double *const *x)
+    {
+        // Row products gather from both triangles (vectorized), the full product scatters into y
+        const bool rowProducts = this->Q.hasTransposeIndex();
+        const bool rowRangePreconditioner = (this->preconditioner != nullptr && this->preconditioner->supportsRowRanges());
+
+        this->startTime = std::chrono::steady_clock::now();
+        this->columnCount = count;
+
+        for (int c = 0; c < count; c++)
+        {
+            this->columns[c].x = x[c];
+            this->columns[c].statistics = SolverStatistics();
+        }
+
+        // r = b - Q * x, z = M^-1 * r
+        this->runPartitioned([&](int thread, long begin, long end) {
+            double *partial = &this->partialSums[thread * PARTIAL_SLOTS];
+
+            for (int c = 0; c < count; c++)
+            {
+                ColumnState &column = this->columns[c];
+                double *r = column.r.data();
+                double *Ap = column.Ap.data();
+
+                if (rowProducts)
+                {
+                    this->Q.multiplyRowsAndDot(column.x, Ap, begin, end);
+                }
+                else
+                {
+                    this->Q.multiply(column.x, Ap);
+                }
+
+                double rr = 0;
+                for (long i = begin; i < end; i++)
+                {
+                    r[i] = b[c][i] - Ap[i];
+                    rr += r[i] * r[i];
+                }
+                partial[c * SLOTS_PER_COLUMN + SLOT_R_R] = rr;
+
+                if (rowRangePreconditioner)
+                {
+                    partial[c * SLOTS_PER_COLUMN + SLOT_R_Z] = this->preconditioner->applyAndDotRows(r, column.z.data(), begin, end);
+                }
+            }
+        });
+
+        for (int c = 0; c < count; c++)
+        {
+            ColumnState &column = this->columns[c];
+
+            column.rr = this->sumPartials(c, SLOT_R_R);
+
+            if (this->preconditioner == nullptr)
+            {
+                column.rz = column.rr;
+            }
+            else if (rowRangePreconditioner)
+            {
+                column.rz = this->sumPartials(c, SLOT_R_Z);
+            }
+            else
+            {
+                column.rz = this->preconditioner->applyAndDot(column.r.data(), column.z.data());
+            }
+        }
+
+        // p = z
+        this->runPartitioned([&](int, long begin, long end) {
+            for (int c = 0; c < count; c++)
+            {
+                ColumnState &column = this->columns[c];
+                const double *z = (this->preconditioner != nullptr) ? column.z.data() : column.r.data();
+
+                std::copy(z + begin, z + end, column.p.data() + begin);
+            }
+        });
+
+        for (int c = 0; c < count; c++)
+        {
+            this->columns[c].active = true;
+            if (this->maxIterations <= 0 || sqrt(this->columns[c].rr) < this->tolerance)
+            {
+                this->finishColumn(this->columns[c]);
+            }
+        }
+    }
+
+    void ConjugateGradientSolver::iterate()
+    {
+        // Row products gather from both triangles (vectorized), the full product scatters into y
+        const bool rowProducts = this->Q.hasTransposeIndex();
+        const bool rowRangePreconditioner = (this->preconditioner != nullptr && this->preconditioner->supportsRowRanges());
+
+        int active[2];
+        int activeCount = 0;
+        for (int c = 0; c < this->columnCount; c++)
+        {
+            if (this->columns[c].active)
+            {
+                active[activeCount++] = c;
+            }
+        }
+
+        // Ap = Q * p and p . Ap. With two systems one pass over Q serves both
+        this->runPartitioned([&](int thread, long begin, long end) {
+            double *partial = &this->partialSums[thread * PARTIAL_SLOTS];
+
+            if (activeCount == 2)
+            {
+                ColumnState &first = this->columns[active[0]];
+                ColumnState &second = this->columns[active[1]];
+                double dots[2];
+
+                if (rowProducts)
+                {
+                    this->Q.multiplyPairRowsAndDot(first.p.data(), second.p.data(), first.Ap.data(), second.Ap.data(), begin, end, dots);
+                }
+                else
+                {
+                    this->Q.multiplyPairAndDot(first.p.data(), second.p.data(), first.Ap.data(), second.Ap.data(), dots);
+                }
+
+                partial[active[0] * SLOTS_PER_COLUMN + SLOT_P_AP] = dots[0];
+                partial[active[1] * SLOTS_PER_COLUMN + SLOT_P_AP] = dots[1];
+            }
+            else
+            {
+                ColumnState &column = this->columns[active[0]];
+
+                partial[active[0] * SLOTS_PER_COLUMN + SLOT_P_AP] = rowProducts
+                    ? this->Q.multiplyRowsAndDot(column.p.data(), column.Ap.data(), begin, end)
+                    : this->Q.multiplyAndDot(column.p.data(), column.Ap.data());
+            }
+        });
+
+        double alpha[2];
+        for (int a = 0; a < activeCount; a++)
+        {
+            alpha[a] = this->columns[active[a]].rz / this->sumPartials(active[a], SLOT_P_AP);
+        }
+
+        // x += alpha * p, r -= alpha * Ap, r . r (and z = M^-1 * r, r . z if it can be done by rows)
+        this->runPartitioned([&](int thread, long begin, long end) {
+            double *partial = &this->partialSums[thread * PARTIAL_SLOTS];
+
+            for (int a = 0; a < activeCount; a++)
+            {
+                ColumnState &column = this->columns[active[a]];
+
+                partial[active[a] * SLOTS_PER_COLUMN + SLOT_R_R] = updateSolutionAndResidual(begin, end, alpha[a], column.p.data(), column.Ap.data(),
+                                                                                              column.x, column.r.data());
+
+                if (rowRangePreconditioner)
+                {
+                    partial[active[a] * SLOTS_PER_COLUMN + SLOT_R_Z] = this->preconditioner->applyAndDotRows(column.r.data(), column.z.data(), begin, end);
+                }
+            }
+        });
+
+        int continuing[2];
+        double beta[2];
+        int continuingCount = 0;
+        for (int a = 0; a < activeCount; a++)
+        {
+            ColumnState &column = this->columns[active[a]];
+
+            column.rr = this->sumPartials(active[a], SLOT_R_R);
+            column.statistics.iterations++;
+
+            if (sqrt(column.rr) < this->tolerance || column.statistics.iterations >= this->maxIterations)
+            {
+                this->finishColumn(column);
+                continue;
+            }
+
+            double rzNew;
+            if (this->preconditioner == nullptr)
+            {
+                rzNew = column.rr;
+            }
+            else if (rowRangePreconditioner)
+            {
+                rzNew = this->sumPartials(active[a], SLOT_R_Z);
+            }
+            else
+            {
+                // Triangular solves are sequential, run them on this thread
+                rzNew = this->preconditioner->applyAndDot(column.r.data(), column.z.data());
+            }
+
+            beta[continuingCount] = rzNew / column.rz;
+            continuing[continuingCount++] = active[a];
+            column.rz = rzNew;
+        }
+
+        // p = z + beta * p
+        if (continuingCount > 0)
+        {
+            this->runPartitioned([&](int, long begin, long end) {
+                for (int a = 0; a < continuingCount; a++)
+                {
+                    ColumnState &column = this->columns[continuing[a]];
+                    const double *z = (this->preconditioner != nullptr) ? column.z.data() : column.r.data();
+
+                    updateSearchDirection(begin, end, beta[a], z, column.p.data());
+                }
+            });
+        }
+    }
+
+    void ConjugateGradientSolver::finishColumn(ColumnState &column)
+    {
+        column.active = false;
+        column.statistics.residualNorm = sqrt(column.rr);
+        column.statistics.converged = (column.statistics.residualNorm < this->tolerance);
+        column.statistics.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - this->startTime).count();
+    }
+
+    SolverStatistics ConjugateGradientSolver::solve(const double *b, double *x)
+    {
+        this->startColumns(1, &b, &x);
+
+        while (this->columns[0].active)
+        {
+            this->iterate();
+        }
+
+        return this->columns[0].statistics;
+    }
+
+    void ConjugateGradientSolver::solvePair(const double *b1, const double *b2, double *x1, double *x2, SolverStatistics *statistics)
+    {
+        const double *b[2] = {b1, b2};
+        double *x[2] = {x1, x2};
+
+        if (this->columns[1].r.empty())
+        {
+            this->allocateColumn(this->columns[1]);
+        }
+
+        this->startColumns(2, b, x);
+
+        // Once one system converges the other continues with single column products
+        while (this->columns[0].active || this->columns[1].active)
+        {
+            this->iterate();
+        }
+
+        statistics[0] = this->columns[0].statistics;
+        statistics[1] = this->columns[1].statistics;
+    }
+
+    ColumnMatrix<double> solveMatrixConjugateGradient(double tolerance, int iterations, const SymmetricSparseMatrix<double> &Q, const ColumnMatrix<double> &Dx,
+                                                      const Preconditioner *preconditioner, SolverStatistics *statistics)
+    {
+        assert(Q.getHeight() == Dx.getHeight());
+
+        // Start from x = 0
+        ColumnMatrix<double> x(Q.getHeight(), 0);
+
+        ConjugateGradientSolver solver(Q, tolerance, iterations, preconditioner);
+        SolverStatistics result = solver.solve(Dx.getData(), x.getData());
+
+        if (statistics != nullptr)
+        {
+            *statistics = result;
+        }
+
+        return x;
+    }
+
+    void matrixSolverThread(void *args)
+    {
+        MatrixSolverParams *params = (MatrixSolverParams*) args;
+
+        std::cout << "[Matrix Solver Thread " << params->id << "]: Started." << std::endl;
+
+        *(params->xAnswer) = solveMatrixConjugateGradient(params->tolerance, params->maxIterations, *params->Q, *params->Dx,
+                                                          params->preconditioner, &params->statistics);
+
+        std::cout << "[Matrix Solver Thread " << params->id << "]: Exit." << std::endl;
+    }
+}
@@ -5,86 +5,89 @@
 
 # include<iostream>
 # include<stdio.h>
-# include<map>
-# include<vector>
-#include <string.h>
+# include<stdlib.h>
 
-using namespace std;
+#include "suraj_parser.h"
+#include "mappedfile.hpp"
 
-struct ltstr
+using PA3Placement::MappedFile;
+using PA3Placement::TextCursor;
+
+using PA3Placement::NameTable;
+
+static void printFormatError(const char *fileName, const char *what)
 {
-  bool operator()(const char* s1, const char* s2) const
-  {
-    return strcmp(s1, s2) < 0;
-  }
-};
-
-map <const char *, int, ltstr> nodeNameToNodeNum_map;
-
-int numCellPins, 		// number of all terminals connected to the end points of (hyper) edges
-	numhyper, 			// number of edges and hyperedges
-	numCellsAndPads, 	// total number of movable cells (generall with names starting with a), and I/O pads (generally starting with p)
-	numCells_noPads;	// total number of movable cells
-
-int *cellPinArray;		// array of cell names used as endpoints of (hyper) edges
-						// The size of the array is numCellPins
-
-int *hEdge_idxToFirstEntryInPinArray;
-						// (hyper)edge definitions.
-						// The ith entry of this array is the
-						// index (=j) of the first pin used in the (hyper)edge
-						// The index j means the first pin of the (hyper) edge is the jth
-						// entry in cellPinArray.
-						// The degree of (hyper)edge i is determined
-						// by subtracting the value of element i from the value of element i+1
-						// The size of the array is numhyper+1
-
-int *hyperwts;			// (hy  per) edge weights. The size of the array is numhyper
-int *vertexSize;		// cell and I/O pad sizes. The size of the array is numCellsAndPads
-
-struct SPinLocation {
-	int x, y;
-};
-
-SPinLocation *pinLocations;
-						// The x,y location of the pins. 
-						// The size of the array is (numCellsAndPads - numCells_noPads)
-						// IMPORTANT: the 0th entry in this array, corresponds to p0, which has the cell index numCells_noPads
-						// Similarly, pinLocations[i] corresponds to the (x,y) location of cell i+numCells_noPads.
-						// Conversely, if you want to get the (x,y) location of cell j -- assuming j is the cell number associated with an 
-						// I/O pad -- then j will be the p = (j - numCells_noPads)th I/O pad. pinLocations[p] has the (x,y) coordinate
-						// you have to 
-
-int parseIbmFile(char *inareFileName, char *innetFileName, char *inPadLocationFileName)
+	printf ("ERROR: %s: %s.\n", fileName, what);
+}
+
+static void printUnknownNode(const char *fileName, const char *name, size_t length)
 {
-	char line[80];
-	char vertexname[10],nodedesc[10];
-	char isStartHyperNet;
-	int hyperweight;
-	FILE *innetFile, *inareFile, *inPadLocationFile;
-
-	innetFile = fopen (innetFileName, "r");
-        if (!innetFile) {
+	printf ("ERROR: %s: unknown cell %.*s.\n", fileName, (int) length, name);
+}
+
+// Pins are looked up this many at a time, so the hash table lookups overlap
+static const int PIN_LOOKUP_BATCH = 256;
+
+// Looks up the names of pins [firstPin, firstPin + count) in one batch. Returns false if a name is unknown
+static bool lookupPins(const char *fileName, const NameTable &nodeNameToNodeNum_map, const char *const *names, const size_t *lengths,
+					   int *cellPinArray, int firstPin, int count)
+{
+	nodeNameToNodeNum_map.findBatch(names, lengths, count, cellPinArray + firstPin);
+
+	for (int k = 0; k < count; k++) {
+		if (cellPinArray[firstPin + k] < 0) {
+			printUnknownNode(fileName, names[k], lengths[k]);
+			return false;
+		}
+	}
+	return true;
+}
+
+int parseIbmFile(const char *inareFileName, const char *innetFileName, const char *inPadLocationFileName, PA3Placement::Hypergraph &hypergraph)
+{
+	int &numCellPins = hypergraph.numCellPins;
+	int &numhyper = hypergraph.numhyper;
+	int &numCellsAndPads = hypergraph.numCellsAndPads;
+	int &numCells_noPads = hypergraph.numCells_noPads;
+	NameTable &nodeNameToNodeNum_map = hypergraph.nodeNameToNodeNum_map;
+
+	MappedFile innetFile(innetFileName);
+        if (!innetFile.isOpen()) {
                 printf ("ERROR: Cannot open input file %s.\n", innetFileName);
                 return -1;
         }
-	inareFile = fopen (inareFileName, "r");
-        if (!inareFile) {
+	MappedFile inareFile(inareFileName);
+        if (!inareFile.isOpen()) {
                 printf ("ERROR: Cannot open input file %s.\n", inareFileName);
                 return -1;
         }
-	inPadLocationFile  = fopen (inPadLocationFileName, "r");
-        if (!inPadLocationFile) {
+	MappedFile inPadLocationFile(inPadLocationFileName);
+        if (!inPadLocationFile.isOpen()) {
                 printf ("ERROR: Cannot open input file %s.\n", inPadLocationFileName);
                 return -1;
         }
-	
-	
 
-	fscanf(innetFile,"%*d %d %d %d %d\n",&numCellPins,&numhyper,&numCellsAndPads,&numCells_noPads);
+	// All three files are tokenized in place, names are never copied except into the name table
+	TextCursor net(innetFile);
+	TextCursor are(inareFile);
+	TextCursor pads(inPadLocationFile);
+	const char *name;
+	size_t nameLength;
+
+	int ignored;
+	if (!net.nextInt(ignored) || !net.nextInt(numCellPins) || !net.nextInt(numhyper) || !net.nextInt(numCellsAndPads) || !net.nextInt(numCells_noPads)) {
+		printFormatError(innetFileName, "bad header");
+		return -1;
+	}
+	net.skipLine();
 
     numCells_noPads++;
 
+	if (numCellPins < 0 || numhyper < 0 || numCells_noPads < 0 || numCellsAndPads < numCells_noPads) {
+		printFormatError(innetFileName, "bad header");
+		return -1;
+	}
+
 	cout << "numCellPins, numhyper, numCellsAndPads, numCells_noPads = " << numCellPins << ", " << numhyper << ", " << numCellsAndPads << ", " << numCells_noPads << endl;
 	// numCellPins is the total number of end-points (pins) for hyperedges and edges.
 	// numhyper is the total number of hyperedges + edges
@@ -102,45 +105,94 @@ int parseIbmFile(char *inareFileName, char *innetFileName, char *inPadLocationFi
 
 
 	// Read cell names, create cell name --> cell number map
-	vertexSize = (int *)malloc(numCellsAndPads*sizeof(int));
+	hypergraph.vertexSize.assign(numCellsAndPads, 0);
+	int *vertexSize = hypergraph.vertexSize.data();
+	nodeNameToNodeNum_map.clear();
+	nodeNameToNodeNum_map.reserve(numCellsAndPads);
 
 	for(int i=0; i<numCellsAndPads; i++)
 	{
-		fscanf(inareFile,"%s %d",vertexname,&vertexSize[i]);
-		//printf("\n%s %d",vertexname,vertexSize[i]);
-		nodeNameToNodeNum_map[strdup(vertexname)]=i;
+		if (!are.nextToken(name, nameLength) || !are.nextInt(vertexSize[i])) {
+			printFormatError(inareFileName, "fewer cells than in the .net header");
+			return -1;
+		}
+		nodeNameToNodeNum_map.insert(name, nameLength, i);
 		// if cell name starts with "a", it's a movable cell
 		// and if starts with "p", it is an I/O pad.
 	}
 
 
 	// Read (hyper)edges
-	hEdge_idxToFirstEntryInPinArray = (int *) malloc((numhyper+1)*sizeof(int));
-	cellPinArray = (int *) malloc(numCellPins*sizeof(int));
-	hyperwts = (int *) malloc(numhyper*sizeof(int));
-	if(hEdge_idxToFirstEntryInPinArray==NULL || cellPinArray == NULL || hyperwts == NULL)
-	{
-		printf("\nUnable to allocate memory");
-		return -1;
-	}
+	hypergraph.hEdge_idxToFirstEntryInPinArray.assign(numhyper+1, 0);
+	hypergraph.cellPinArray.assign(numCellPins, 0);
+	hypergraph.hyperwts.assign(numhyper, 0);
+	int *hEdge_idxToFirstEntryInPinArray = hypergraph.hEdge_idxToFirstEntryInPinArray.data();
+	int *cellPinArray = hypergraph.cellPinArray.data();
+	int *hyperwts = hypergraph.hyperwts.data();
 	int hypercount = 0;
 	int pinCount = 0;
-	
-	while (fgets(line, 80, innetFile) != NULL) 
+	const char *pinNames[PIN_LOOKUP_BATCH];
+	size_t pinNameLengths[PIN_LOOKUP_BATCH];
+	int pinBatchStart = 0;
+
+	// Every line is "name s weight" for the first pin of a (hyper)edge and "name l" for the others
+	while (net.nextToken(name, nameLength))
    	{
-		sscanf(line,"%s %c %d",nodedesc,&isStartHyperNet,&hyperweight);
-		if(isStartHyperNet=='s')
+		const char *pinType;
+		size_t pinTypeLength;
+		if (!net.nextTokenOnLine(pinType, pinTypeLength)) {
+			printFormatError(innetFileName, "pin without a type");
+			return -1;
+		}
+
+		if(pinType[0]=='s')
 		{
+			if (hypercount == numhyper) {
+				printFormatError(innetFileName, "more (hyper)edges than in the header");
+				return -1;
+			}
+
+			int hyperweight;
+			if (!net.nextInt(hyperweight)) {
+				printFormatError(innetFileName, "bad (hyper)edge weight");
+				return -1;
+			}
+
 			hEdge_idxToFirstEntryInPinArray[hypercount] = pinCount;
 			hyperwts[hypercount] = hyperweight;
 			++hypercount;
 		}
-		else
+		else if (hypercount == 0)
 		{
-			sscanf(line,"%s %d",nodedesc,&hyperweight);
+			printFormatError(innetFileName, "pin before the first (hyper)edge");
+			return -1;
 		}
-		cellPinArray[pinCount] = nodeNameToNodeNum_map[nodedesc]; 
+		net.skipLine();
+
+		if (pinCount == numCellPins) {
+			printFormatError(innetFileName, "more pins than in the header");
+			return -1;
+		}
+
+		pinNames[pinCount - pinBatchStart] = name;
+		pinNameLengths[pinCount - pinBatchStart] = nameLength;
 		++pinCount;
+
+		if (pinCount - pinBatchStart == PIN_LOOKUP_BATCH) {
+			if (!lookupPins(innetFileName, nodeNameToNodeNum_map, pinNames, pinNameLengths, cellPinArray, pinBatchStart, PIN_LOOKUP_BATCH)) {
+				return -1;
+			}
+			pinBatchStart = pinCount;
+		}
+	}
+
+	if (!lookupPins(innetFileName, nodeNameToNodeNum_map, pinNames, pinNameLengths, cellPinArray, pinBatchStart, pinCount - pinBatchStart)) {
+		return -1;
+	}
+
+	if (pinCount != numCellPins || hypercount != numhyper) {
+		printFormatError(innetFileName, "fewer pins or (hyper)edges than in the header");
+		return -1;
 	}
 	hEdge_idxToFirstEntryInPinArray[hypercount] = numCellPins;
 
@@ -174,22 +226,28 @@ int parseIbmFile(char *inareFileName, char *innetFileName, char *inPadLocationFi
 
 	// Read I/O Pad locations
 	int numPads = numCellsAndPads - numCells_noPads;
-	pinLocations = new SPinLocation[numPads];
+	hypergraph.pinLocations.assign(numPads, SPinLocation());
+	SPinLocation *pinLocations = hypergraph.pinLocations.data();
 	for(int i=0; i<numPads; i++)
 		{
-			char padName[80];
 			int x, y;
-			fscanf(inPadLocationFile,"%s %d %d",padName,&x, &y);
-			int padCellIdx = nodeNameToNodeNum_map[padName];
+			if (!pads.nextToken(name, nameLength) || !pads.nextInt(x) || !pads.nextInt(y)) {
+				printFormatError(inPadLocationFileName, "fewer pads than in the .net header");
+				return -1;
+			}
+
+			int padCellIdx = nodeNameToNodeNum_map.find(name, nameLength);
+			if (padCellIdx < 0) {
+				printUnknownNode(inPadLocationFileName, name, nameLength);
+				return -1;
+			}
+			if (padCellIdx < numCells_noPads) {
+				printFormatError(inPadLocationFileName, "location given for a movable cell");
+				return -1;
+			}
 			pinLocations[padCellIdx-numCells_noPads].x = x;		// pay attention how it's indexed 
 			pinLocations[padCellIdx-numCells_noPads].y = y;
 		}
 
-
-	fclose(inPadLocationFile);
-	fclose(innetFile);
-    fclose(inareFile);
-
 	return 0;
 }
-		
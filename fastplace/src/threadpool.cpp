@@ -0,0 +1,108 @@
+#include "threadpool.hpp"
+
+#include <cassert>
+
+namespace PA3Placement
+{
+    ThreadPool::ThreadPool(int threadCount)
+    {
+        assert(threadCount >= 1);
+
+        // The calling thread is thread 0
+        for (int i = 1; i < threadCount; i++)
+        {
+            this->workers.emplace_back(&ThreadPool::workerLoop, this, i);
+        }
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->stopping = true;
+        }
+        this->wakeCondition.notify_all();
+
+        for (auto &worker : this->workers)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::run(const std::function<void(int)> &task)
+    {
+        if (this->workers.empty())
+        {
+            task(0);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(this->mutex);
+            this->currentTask = &task;
+            this->pendingWorkers = this->workers.size();
+            this->generation++;
+        }
+        this->wakeCondition.notify_all();
+
+        task(0);
+
+        std::unique_lock<std::mutex> lock(this->mutex);
+        this->doneCondition.wait(lock, [this] { return this->pendingWorkers == 0; });
+        this->currentTask = nullptr;
+    }
+
+    void ThreadPool::parallelFor(long count, const std::function<void(long, long)> &function)
+    {
+        const int threads = this->getThreadCount();
+
+        this->run([&](int thread) {
+            const long begin = count * thread / threads;
+            const long end = count * (thread + 1) / threads;
+
+            if (begin < end)
+            {
+                function(begin, end);
+            }
+        });
+    }
+
+    int ThreadPool::getDefaultThreadCount()
+    {
+        const unsigned int hardwareThreads = std::thread::hardware_concurrency();
+        return (hardwareThreads > 0) ? hardwareThreads : 1;
+    }
+
+    void ThreadPool::workerLoop(int threadIndex)
+    {
+        unsigned long lastGeneration = 0;
+
+        while (true)
+        {
+            const std::function<void(int)> *task;
+
+            {
+                std::unique_lock<std::mutex> lock(this->mutex);
+                this->wakeCondition.wait(lock, [this, lastGeneration] {
+                    return this->stopping || this->generation != lastGeneration;
+                });
+
+                if (this->stopping)
+                {
+                    return;
+                }
+
+                lastGeneration = this->generation;
+                task = this->currentTask;
+            }
+
+            (*task)(threadIndex);
+
+            std::lock_guard<std::mutex> lock(this->mutex);
+            if (--this->pendingWorkers == 0)
+            {
+                this->doneCondition.notify_one();
+            }
+        }
+    }
+}
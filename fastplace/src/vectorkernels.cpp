@@ -0,0 +1,934 @@
+#include "vectorkernels.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define X86_VECTOR_KERNELS
+#include <immintrin.h>
+#endif
+
+namespace PA3Placement
+{
+    /*
+     * Scalar kernels, used when nothing better is available and as the reference for the others
+     */
+
+    static double scalarDot(const double *x, const double *y, long n)
+    {
+        double sum = 0;
+        for (long i = 0; i < n; i++)
+        {
+            sum += x[i] * y[i];
+        }
+
+        return sum;
+    }
+
+    static void scalarAxpy(double a, const double *x, double *y, long n)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            y[i] += a * x[i];
+        }
+    }
+
+    static void scalarXpby(const double *x, double b, double *y, long n)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            y[i] = x[i] + b * y[i];
+        }
+    }
+
+    static double scalarAxpyAndNorm(double a, const double *x, double *y, long n)
+    {
+        double sum = 0;
+        for (long i = 0; i < n; i++)
+        {
+            y[i] += a * x[i];
+            sum += y[i] * y[i];
+        }
+
+        return sum;
+    }
+
+    static double scalarMultiplyAndDot(const double *d, const double *x, double *y, long n)
+    {
+        double sum = 0;
+        for (long i = 0; i < n; i++)
+        {
+            y[i] = d[i] * x[i];
+            sum += x[i] * y[i];
+        }
+
+        return sum;
+    }
+
+    static double scalarSparseDot(const double *values, const int *indices, long count, const double *x)
+    {
+        double sum = 0;
+        for (long k = 0; k < count; k++)
+        {
+            sum += values[k] * x[indices[k]];
+        }
+
+        return sum;
+    }
+
+    static void scalarSparseDotPair(const double *values, const int *indices, long count, const double *x1, const double *x2, double *dots)
+    {
+        double sum1 = 0;
+        double sum2 = 0;
+        for (long k = 0; k < count; k++)
+        {
+            sum1 += values[k] * x1[indices[k]];
+            sum2 += values[k] * x2[indices[k]];
+        }
+
+        dots[0] = sum1;
+        dots[1] = sum2;
+    }
+
+    static double scalarSparseRowsAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end, const double *x, double *y)
+    {
+        double dot = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+
+            const double sum = scalarSparseDot(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x)
+                             + scalarSparseDot(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x);
+
+            y[i] = sum;
+            dot += x[i] * sum;
+        }
+
+        return dot;
+    }
+
+    static void scalarSparseRowsPairAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end,
+                                           const double *x1, const double *x2, double *y1, double *y2, double *dots)
+    {
+        double dot1 = 0;
+        double dot2 = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+            double upperSums[2];
+            double lowerSums[2];
+
+            scalarSparseDotPair(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x1, x2, upperSums);
+            scalarSparseDotPair(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x1, x2, lowerSums);
+
+            y1[i] = upperSums[0] + lowerSums[0];
+            y2[i] = upperSums[1] + lowerSums[1];
+            dot1 += x1[i] * y1[i];
+            dot2 += x2[i] * y2[i];
+        }
+
+        dots[0] = dot1;
+        dots[1] = dot2;
+    }
+
+    static void scalarGatherAffine(const double *scale, const double *offset, const int *index, const double *x, double *y, long n)
+    {
+        for (long i = 0; i < n; i++)
+        {
+            y[i] = scale[index[i]] * x[i] + offset[index[i]];
+        }
+    }
+
+    static double scalarEdgeWirelength(const int *from, const int *to, const double *weight, const double *x, const double *y, long n)
+    {
+        double sum = 0;
+        for (long k = 0; k < n; k++)
+        {
+            const double dx = x[from[k]] - x[to[k]];
+            const double dy = y[from[k]] - y[to[k]];
+            sum += weight[k] * (dx * dx + dy * dy);
+        }
+
+        return sum;
+    }
+
+    static const VectorKernels SCALAR_KERNELS = {
+        "scalar",
+        scalarDot,
+        scalarAxpy,
+        scalarXpby,
+        scalarAxpyAndNorm,
+        scalarMultiplyAndDot,
+        scalarSparseRowsAndDot,
+        scalarSparseRowsPairAndDot,
+        scalarGatherAffine,
+        scalarEdgeWirelength
+    };
+
+#ifdef X86_VECTOR_KERNELS
+    /*
+     * SSE2, 2 doubles per register. Sparse products have no gather instruction, so they stay scalar
+     */
+
+    __attribute__((target("sse2")))
+    static inline double horizontalSum(__m128d v)
+    {
+        return _mm_cvtsd_f64(_mm_add_sd(v, _mm_unpackhi_pd(v, v)));
+    }
+
+    __attribute__((target("sse2")))
+    static double sse2Dot(const double *x, const double *y, long n)
+    {
+        __m128d sum = _mm_setzero_pd();
+
+        long i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            sum = _mm_add_pd(sum, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        }
+
+        double result = horizontalSum(sum);
+        for (; i < n; i++)
+        {
+            result += x[i] * y[i];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("sse2")))
+    static void sse2Axpy(double a, const double *x, double *y, long n)
+    {
+        const __m128d va = _mm_set1_pd(a);
+
+        long i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i))));
+        }
+
+        for (; i < n; i++)
+        {
+            y[i] += a * x[i];
+        }
+    }
+
+    __attribute__((target("sse2")))
+    static void sse2Xpby(const double *x, double b, double *y, long n)
+    {
+        const __m128d vb = _mm_set1_pd(b);
+
+        long i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            _mm_storeu_pd(y + i, _mm_add_pd(_mm_loadu_pd(x + i), _mm_mul_pd(vb, _mm_loadu_pd(y + i))));
+        }
+
+        for (; i < n; i++)
+        {
+            y[i] = x[i] + b * y[i];
+        }
+    }
+
+    __attribute__((target("sse2")))
+    static double sse2AxpyAndNorm(double a, const double *x, double *y, long n)
+    {
+        const __m128d va = _mm_set1_pd(a);
+        __m128d sum = _mm_setzero_pd();
+
+        long i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            const __m128d vy = _mm_add_pd(_mm_loadu_pd(y + i), _mm_mul_pd(va, _mm_loadu_pd(x + i)));
+            _mm_storeu_pd(y + i, vy);
+            sum = _mm_add_pd(sum, _mm_mul_pd(vy, vy));
+        }
+
+        double result = horizontalSum(sum);
+        for (; i < n; i++)
+        {
+            y[i] += a * x[i];
+            result += y[i] * y[i];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("sse2")))
+    static double sse2MultiplyAndDot(const double *d, const double *x, double *y, long n)
+    {
+        __m128d sum = _mm_setzero_pd();
+
+        long i = 0;
+        for (; i + 2 <= n; i += 2)
+        {
+            const __m128d vx = _mm_loadu_pd(x + i);
+            const __m128d vy = _mm_mul_pd(_mm_loadu_pd(d + i), vx);
+            _mm_storeu_pd(y + i, vy);
+            sum = _mm_add_pd(sum, _mm_mul_pd(vx, vy));
+        }
+
+        double result = horizontalSum(sum);
+        for (; i < n; i++)
+        {
+            y[i] = d[i] * x[i];
+            result += x[i] * y[i];
+        }
+
+        return result;
+    }
+
+    static const VectorKernels SSE2_KERNELS = {
+        "sse2",
+        sse2Dot,
+        sse2Axpy,
+        sse2Xpby,
+        sse2AxpyAndNorm,
+        sse2MultiplyAndDot,
+        scalarSparseRowsAndDot,
+        scalarSparseRowsPairAndDot,
+        scalarGatherAffine,
+        scalarEdgeWirelength
+    };
+
+    /*
+     * AVX2 with FMA, 4 doubles per register, sparse products use gather loads
+     */
+
+    __attribute__((target("avx2,fma")))
+    static inline double horizontalSum(__m256d v)
+    {
+        const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(v), _mm256_extractf128_pd(v, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+    }
+
+    /**
+     * Gathers base[index[0..3]]. The masked form with a zeroed source keeps GCC from
+     * warning about the undefined source register of _mm256_i32gather_pd.
+     */
+    __attribute__((target("avx2,fma")))
+    static inline __m256d gather(const double *base, __m128i index)
+    {
+        const __m256d all = _mm256_castsi256_pd(_mm256_set1_epi64x(-1));
+        return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, all, 8);
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2Dot(const double *x, const double *y, long n)
+    {
+        // Two accumulators to hide the latency of the FMA
+        __m256d sum0 = _mm256_setzero_pd();
+        __m256d sum1 = _mm256_setzero_pd();
+
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+            sum1 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4), sum1);
+        }
+        for (; i + 4 <= n; i += 4)
+        {
+            sum0 = _mm256_fmadd_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i), sum0);
+        }
+
+        double result = horizontalSum(_mm256_add_pd(sum0, sum1));
+        for (; i < n; i++)
+        {
+            result += x[i] * y[i];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2Axpy(double a, const double *x, double *y, long n)
+    {
+        const __m256d va = _mm256_set1_pd(a);
+
+        long i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm256_storeu_pd(y + i, _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        }
+
+        for (; i < n; i++)
+        {
+            y[i] += a * x[i];
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2Xpby(const double *x, double b, double *y, long n)
+    {
+        const __m256d vb = _mm256_set1_pd(b);
+
+        long i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            _mm256_storeu_pd(y + i, _mm256_fmadd_pd(vb, _mm256_loadu_pd(y + i), _mm256_loadu_pd(x + i)));
+        }
+
+        for (; i < n; i++)
+        {
+            y[i] = x[i] + b * y[i];
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2AxpyAndNorm(double a, const double *x, double *y, long n)
+    {
+        const __m256d va = _mm256_set1_pd(a);
+        __m256d sum = _mm256_setzero_pd();
+
+        long i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m256d vy = _mm256_fmadd_pd(va, _mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i));
+            _mm256_storeu_pd(y + i, vy);
+            sum = _mm256_fmadd_pd(vy, vy, sum);
+        }
+
+        double result = horizontalSum(sum);
+        for (; i < n; i++)
+        {
+            y[i] += a * x[i];
+            result += y[i] * y[i];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2MultiplyAndDot(const double *d, const double *x, double *y, long n)
+    {
+        __m256d sum = _mm256_setzero_pd();
+
+        long i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m256d vx = _mm256_loadu_pd(x + i);
+            const __m256d vy = _mm256_mul_pd(_mm256_loadu_pd(d + i), vx);
+            _mm256_storeu_pd(y + i, vy);
+            sum = _mm256_fmadd_pd(vx, vy, sum);
+        }
+
+        double result = horizontalSum(sum);
+        for (; i < n; i++)
+        {
+            y[i] = d[i] * x[i];
+            result += x[i] * y[i];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2SparseDot(const double *values, const int *indices, long count, const double *x)
+    {
+        __m256d sum = _mm256_setzero_pd();
+
+        long k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + k));
+            sum = _mm256_fmadd_pd(_mm256_loadu_pd(values + k), gather(x, index), sum);
+        }
+
+        double result = horizontalSum(sum);
+        for (; k < count; k++)
+        {
+            result += values[k] * x[indices[k]];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2SparseDotPair(const double *values, const int *indices, long count, const double *x1, const double *x2, double *dots)
+    {
+        __m256d sum1 = _mm256_setzero_pd();
+        __m256d sum2 = _mm256_setzero_pd();
+
+        long k = 0;
+        for (; k + 4 <= count; k += 4)
+        {
+            const __m128i index = _mm_loadu_si128(reinterpret_cast<const __m128i*>(indices + k));
+            const __m256d v = _mm256_loadu_pd(values + k);
+            sum1 = _mm256_fmadd_pd(v, gather(x1, index), sum1);
+            sum2 = _mm256_fmadd_pd(v, gather(x2, index), sum2);
+        }
+
+        double result1 = horizontalSum(sum1);
+        double result2 = horizontalSum(sum2);
+        for (; k < count; k++)
+        {
+            result1 += values[k] * x1[indices[k]];
+            result2 += values[k] * x2[indices[k]];
+        }
+
+        dots[0] = result1;
+        dots[1] = result2;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2SparseRowsAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end, const double *x, double *y)
+    {
+        double dot = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+
+            const double sum = avx2SparseDot(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x)
+                             + avx2SparseDot(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x);
+
+            y[i] = sum;
+            dot += x[i] * sum;
+        }
+
+        return dot;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2SparseRowsPairAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end,
+                                         const double *x1, const double *x2, double *y1, double *y2, double *dots)
+    {
+        double dot1 = 0;
+        double dot2 = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+            double upperSums[2];
+            double lowerSums[2];
+
+            avx2SparseDotPair(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x1, x2, upperSums);
+            avx2SparseDotPair(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x1, x2, lowerSums);
+
+            y1[i] = upperSums[0] + lowerSums[0];
+            y2[i] = upperSums[1] + lowerSums[1];
+            dot1 += x1[i] * y1[i];
+            dot2 += x2[i] * y2[i];
+        }
+
+        dots[0] = dot1;
+        dots[1] = dot2;
+    }
+
+    __attribute__((target("avx2,fma")))
+    static void avx2GatherAffine(const double *scale, const double *offset, const int *index, const double *x, double *y, long n)
+    {
+        long i = 0;
+        for (; i + 4 <= n; i += 4)
+        {
+            const __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i*>(index + i));
+            _mm256_storeu_pd(y + i, _mm256_fmadd_pd(gather(scale, group), _mm256_loadu_pd(x + i), gather(offset, group)));
+        }
+        for (; i < n; i++)
+        {
+            y[i] = scale[index[i]] * x[i] + offset[index[i]];
+        }
+    }
+
+    __attribute__((target("avx2,fma")))
+    static double avx2EdgeWirelength(const int *from, const int *to, const double *weight, const double *x, const double *y, long n)
+    {
+        __m256d sum = _mm256_setzero_pd();
+
+        long k = 0;
+        for (; k + 4 <= n; k += 4)
+        {
+            const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(from + k));
+            const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(to + k));
+            const __m256d dx = _mm256_sub_pd(gather(x, a), gather(x, b));
+            const __m256d dy = _mm256_sub_pd(gather(y, a), gather(y, b));
+            const __m256d squared = _mm256_fmadd_pd(dx, dx, _mm256_mul_pd(dy, dy));
+            sum = _mm256_fmadd_pd(_mm256_loadu_pd(weight + k), squared, sum);
+        }
+
+        double result = horizontalSum(sum);
+        for (; k < n; k++)
+        {
+            const double dx = x[from[k]] - x[to[k]];
+            const double dy = y[from[k]] - y[to[k]];
+            result += weight[k] * (dx * dx + dy * dy);
+        }
+
+        return result;
+    }
+
+    static const VectorKernels AVX2_KERNELS = {
+        "avx2",
+        avx2Dot,
+        avx2Axpy,
+        avx2Xpby,
+        avx2AxpyAndNorm,
+        avx2MultiplyAndDot,
+        avx2SparseRowsAndDot,
+        avx2SparseRowsPairAndDot,
+        avx2GatherAffine,
+        avx2EdgeWirelength
+    };
+
+    /*
+     * AVX-512, 8 doubles per register. Tails are handled with masked loads/stores instead of scalar loops
+     */
+
+    __attribute__((target("avx512f")))
+    static inline __mmask8 tailMask(long remaining)
+    {
+        return static_cast<__mmask8>((1u << remaining) - 1);
+    }
+
+    /**
+     * Gathers base[index[0..7]], see the AVX2 gather for why the masked form is used
+     */
+    __attribute__((target("avx512f")))
+    static inline __m512d gather(const double *base, __m256i index)
+    {
+        return _mm512_mask_i32gather_pd(_mm512_setzero_pd(), 0xFF, index, base, 8);
+    }
+
+    /**
+     * Sum of all elements. Replaces _mm512_reduce_add_pd, which extracts the halves with an
+     * undefined source register and trips -Wuninitialized the same way the gathers do.
+     */
+    __attribute__((target("avx512f")))
+    static inline double horizontalSum(__m512d v)
+    {
+        const __m256d low = _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, v, 0);
+        const __m256d high = _mm512_mask_extractf64x4_pd(_mm256_setzero_pd(), 0xF, v, 1);
+        const __m256d quad = _mm256_add_pd(low, high);
+        const __m128d sum = _mm_add_pd(_mm256_castpd256_pd128(quad), _mm256_extractf128_pd(quad, 1));
+        return _mm_cvtsd_f64(_mm_add_sd(sum, _mm_unpackhi_pd(sum, sum)));
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512Dot(const double *x, const double *y, long n)
+    {
+        __m512d sum0 = _mm512_setzero_pd();
+        __m512d sum1 = _mm512_setzero_pd();
+
+        long i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), sum0);
+            sum1 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i + 8), _mm512_loadu_pd(y + i + 8), sum1);
+        }
+        for (; i + 8 <= n; i += 8)
+        {
+            sum0 = _mm512_fmadd_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i), sum0);
+        }
+        if (i < n)
+        {
+            const __mmask8 mask = tailMask(n - i);
+            sum1 = _mm512_fmadd_pd(_mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i), sum1);
+        }
+
+        return horizontalSum(_mm512_add_pd(sum0, sum1));
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512Axpy(double a, const double *x, double *y, long n)
+    {
+        const __m512d va = _mm512_set1_pd(a);
+
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm512_storeu_pd(y + i, _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+        }
+        if (i < n)
+        {
+            const __mmask8 mask = tailMask(n - i);
+            _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512Xpby(const double *x, double b, double *y, long n)
+    {
+        const __m512d vb = _mm512_set1_pd(b);
+
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            _mm512_storeu_pd(y + i, _mm512_fmadd_pd(vb, _mm512_loadu_pd(y + i), _mm512_loadu_pd(x + i)));
+        }
+        if (i < n)
+        {
+            const __mmask8 mask = tailMask(n - i);
+            _mm512_mask_storeu_pd(y + i, mask, _mm512_fmadd_pd(vb, _mm512_maskz_loadu_pd(mask, y + i), _mm512_maskz_loadu_pd(mask, x + i)));
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512AxpyAndNorm(double a, const double *x, double *y, long n)
+    {
+        const __m512d va = _mm512_set1_pd(a);
+        __m512d sum = _mm512_setzero_pd();
+
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m512d vy = _mm512_fmadd_pd(va, _mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i));
+            _mm512_storeu_pd(y + i, vy);
+            sum = _mm512_fmadd_pd(vy, vy, sum);
+        }
+        if (i < n)
+        {
+            const __mmask8 mask = tailMask(n - i);
+            const __m512d vy = _mm512_fmadd_pd(va, _mm512_maskz_loadu_pd(mask, x + i), _mm512_maskz_loadu_pd(mask, y + i));
+            _mm512_mask_storeu_pd(y + i, mask, vy);
+            sum = _mm512_fmadd_pd(vy, vy, sum);
+        }
+
+        return horizontalSum(sum);
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512MultiplyAndDot(const double *d, const double *x, double *y, long n)
+    {
+        __m512d sum = _mm512_setzero_pd();
+
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m512d vx = _mm512_loadu_pd(x + i);
+            const __m512d vy = _mm512_mul_pd(_mm512_loadu_pd(d + i), vx);
+            _mm512_storeu_pd(y + i, vy);
+            sum = _mm512_fmadd_pd(vx, vy, sum);
+        }
+        if (i < n)
+        {
+            const __mmask8 mask = tailMask(n - i);
+            const __m512d vx = _mm512_maskz_loadu_pd(mask, x + i);
+            const __m512d vy = _mm512_mul_pd(_mm512_maskz_loadu_pd(mask, d + i), vx);
+            _mm512_mask_storeu_pd(y + i, mask, vy);
+            sum = _mm512_fmadd_pd(vx, vy, sum);
+        }
+
+        return horizontalSum(sum);
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512SparseDot(const double *values, const int *indices, long count, const double *x)
+    {
+        __m512d sum = _mm512_setzero_pd();
+
+        long k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k));
+            sum = _mm512_fmadd_pd(_mm512_loadu_pd(values + k), gather(x, index), sum);
+        }
+
+        // Most CSR rows here are shorter than a register, finish them off without masked gathers
+        double result = horizontalSum(sum);
+        for (; k < count; k++)
+        {
+            result += values[k] * x[indices[k]];
+        }
+
+        return result;
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512SparseDotPair(const double *values, const int *indices, long count, const double *x1, const double *x2, double *dots)
+    {
+        __m512d sum1 = _mm512_setzero_pd();
+        __m512d sum2 = _mm512_setzero_pd();
+
+        long k = 0;
+        for (; k + 8 <= count; k += 8)
+        {
+            const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(indices + k));
+            const __m512d v = _mm512_loadu_pd(values + k);
+            sum1 = _mm512_fmadd_pd(v, gather(x1, index), sum1);
+            sum2 = _mm512_fmadd_pd(v, gather(x2, index), sum2);
+        }
+
+        double result1 = horizontalSum(sum1);
+        double result2 = horizontalSum(sum2);
+        for (; k < count; k++)
+        {
+            result1 += values[k] * x1[indices[k]];
+            result2 += values[k] * x2[indices[k]];
+        }
+
+        dots[0] = result1;
+        dots[1] = result2;
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512SparseRowsAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end, const double *x, double *y)
+    {
+        double dot = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+
+            const double sum = avx512SparseDot(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x)
+                             + avx512SparseDot(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x);
+
+            y[i] = sum;
+            dot += x[i] * sum;
+        }
+
+        return dot;
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512SparseRowsPairAndDot(const CompressedRows &upper, const CompressedRows &lower, long begin, long end,
+                                           const double *x1, const double *x2, double *y1, double *y2, double *dots)
+    {
+        double dot1 = 0;
+        double dot2 = 0;
+
+        for (long i = begin; i < end; i++)
+        {
+            const long upperStart = upper.rowStart[i];
+            const long lowerStart = lower.rowStart[i];
+            double upperSums[2];
+            double lowerSums[2];
+
+            avx512SparseDotPair(upper.values + upperStart, upper.columnIndices + upperStart, upper.rowStart[i + 1] - upperStart, x1, x2, upperSums);
+            avx512SparseDotPair(lower.values + lowerStart, lower.columnIndices + lowerStart, lower.rowStart[i + 1] - lowerStart, x1, x2, lowerSums);
+
+            y1[i] = upperSums[0] + lowerSums[0];
+            y2[i] = upperSums[1] + lowerSums[1];
+            dot1 += x1[i] * y1[i];
+            dot2 += x2[i] * y2[i];
+        }
+
+        dots[0] = dot1;
+        dots[1] = dot2;
+    }
+
+    __attribute__((target("avx512f")))
+    static void avx512GatherAffine(const double *scale, const double *offset, const int *index, const double *x, double *y, long n)
+    {
+        long i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            const __m256i group = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(index + i));
+            _mm512_storeu_pd(y + i, _mm512_fmadd_pd(gather(scale, group), _mm512_loadu_pd(x + i), gather(offset, group)));
+        }
+        // Masked index loads need AVX-512VL, the few remaining elements are not worth it
+        for (; i < n; i++)
+        {
+            y[i] = scale[index[i]] * x[i] + offset[index[i]];
+        }
+    }
+
+    __attribute__((target("avx512f")))
+    static double avx512EdgeWirelength(const int *from, const int *to, const double *weight, const double *x, const double *y, long n)
+    {
+        __m512d sum = _mm512_setzero_pd();
+
+        long k = 0;
+        for (; k + 8 <= n; k += 8)
+        {
+            const __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(from + k));
+            const __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(to + k));
+            const __m512d dx = _mm512_sub_pd(gather(x, a), gather(x, b));
+            const __m512d dy = _mm512_sub_pd(gather(y, a), gather(y, b));
+            const __m512d squared = _mm512_fmadd_pd(dx, dx, _mm512_mul_pd(dy, dy));
+            sum = _mm512_fmadd_pd(_mm512_loadu_pd(weight + k), squared, sum);
+        }
+
+        double result = horizontalSum(sum);
+        for (; k < n; k++)
+        {
+            const double dx = x[from[k]] - x[to[k]];
+            const double dy = y[from[k]] - y[to[k]];
+            result += weight[k] * (dx * dx + dy * dy);
+        }
+
+        return result;
+    }
+
+    static const VectorKernels AVX512_KERNELS = {
+        "avx512",
+        avx512Dot,
+        avx512Axpy,
+        avx512Xpby,
+        avx512AxpyAndNorm,
+        avx512MultiplyAndDot,
+        avx512SparseRowsAndDot,
+        avx512SparseRowsPairAndDot,
+        avx512GatherAffine,
+        avx512EdgeWirelength
+    };
+#endif
+
+    /**
+     * @return The kernels with the given name if this CPU supports them, otherwise nullptr
+     */
+    static const VectorKernels* findSupportedKernels(const std::string &name)
+    {
+        if (name == "scalar")
+        {
+            return &SCALAR_KERNELS;
+        }
+
+#ifdef X86_VECTOR_KERNELS
+        // May run during static initialization, before the runtime sets up the CPU feature flags
+        __builtin_cpu_init();
+
+        if (name == "sse2" && __builtin_cpu_supports("sse2"))
+        {
+            return &SSE2_KERNELS;
+        }
+        if (name == "avx2" && __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        {
+            return &AVX2_KERNELS;
+        }
+        if (name == "avx512" && __builtin_cpu_supports("avx512f"))
+        {
+            return &AVX512_KERNELS;
+        }
+#endif
+
+        return nullptr;
+    }
+
+    static const VectorKernels* findBestKernels()
+    {
+        for (const char *name : {"avx512", "avx2", "sse2"})
+        {
+            const VectorKernels *kernels = findSupportedKernels(name);
+            if (nullptr != kernels)
+            {
+                return kernels;
+            }
+        }
+
+        return &SCALAR_KERNELS;
+    }
+
+    // Picked before main runs, so threads never see it change
+    static const VectorKernels *activeKernels = findBestKernels();
+
+    const VectorKernels& getVectorKernels()
+    {
+        return *activeKernels;
+    }
+
+    bool selectVectorKernels(const std::string &name)
+    {
+        const VectorKernels *kernels = (name == "auto") ? findBestKernels() : findSupportedKernels(name);
+        if (nullptr == kernels)
+        {
+            return false;
+        }
+
+        activeKernels = kernels;
+        return true;
+    }
+}
@@ -0,0 +1,139 @@
+#include "wirelength.hpp"
+#include "vectorkernels.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PA3Placement
+{
+    // Edges or hyperedges summed by one task
+    static const int WIRELENGTH_BLOCK_SIZE = 4096;
+
+    WirelengthEvaluator::WirelengthEvaluator(const QMatrix &matrixQ, int numCellsNoPads, int numHyperedges, const int *cellPinArray,
+                                             const int *hEdgesToFirstMemberCellArray, const int *hEdgeWeights, const SPinLocation *pinLocations,
+                                             ThreadPool *threadPool)
+    {
+        this->numCellsNoPads = numCellsNoPads;
+        this->numHyperedges = numHyperedges;
+        this->cellPinArray = cellPinArray;
+        this->hEdgesToFirstMemberCellArray = hEdgesToFirstMemberCellArray;
+        this->hEdgeWeights = hEdgeWeights;
+        this->pinLocations = pinLocations;
+        this->threadPool = threadPool;
+
+        // Every connection between two movable nodes is stored once in the upper triangle of Q, with the negated
+        // connection weight. The first entry of each row is the diagonal.
+        const auto &rowStart = matrixQ.getRowStart();
+        const auto &columnIndices = matrixQ.getColumnIndices();
+        const auto &values = matrixQ.getValues();
+
+        const long edgeCount = rowStart[matrixQ.getHeight()] - matrixQ.getHeight();
+        this->edgeFrom.reserve(edgeCount);
+        this->edgeTo.reserve(edgeCount);
+        this->edgeWeight.reserve(edgeCount);
+
+        for (long row = 0; row < matrixQ.getHeight(); row++)
+        {
+            for (long k = rowStart[row] + 1; k < rowStart[row + 1]; k++)
+            {
+                this->edgeFrom.push_back(static_cast<int>(row));
+                this->edgeTo.push_back(columnIndices[k]);
+                this->edgeWeight.push_back(-values[k]);
+            }
+        }
+
+        const long blocks = (std::max<long>(this->edgeWeight.size(), numHyperedges) + WIRELENGTH_BLOCK_SIZE - 1) / WIRELENGTH_BLOCK_SIZE;
+        this->blockSums.resize(blocks);
+    }
+
+    void WirelengthEvaluator::parallelFor(long count, const std::function<void(long, long)> &function) const
+    {
+        if (this->threadPool != nullptr)
+        {
+            this->threadPool->parallelFor(count, function);
+        }
+        else
+        {
+            function(0, count);
+        }
+    }
+
+    double WirelengthEvaluator::sumBlocks(long count, const std::function<double(long, long)> &blockSum)
+    {
+        const long blocks = (count + WIRELENGTH_BLOCK_SIZE - 1) / WIRELENGTH_BLOCK_SIZE;
+
+        this->parallelFor(blocks, [&](long firstBlock, long lastBlock)
+        {
+            for (long block = firstBlock; block < lastBlock; block++)
+            {
+                const long begin = block * WIRELENGTH_BLOCK_SIZE;
+                this->blockSums[block] = blockSum(begin, std::min(count, begin + WIRELENGTH_BLOCK_SIZE));
+            }
+        });
+
+        double sum = 0;
+        for (long block = 0; block < blocks; block++)
+        {
+            sum += this->blockSums[block];
+        }
+
+        return sum;
+    }
+
+    double WirelengthEvaluator::calculateQuadraticWirelength(const double *x, const double *y)
+    {
+        const VectorKernels &kernels = getVectorKernels();
+
+        return this->sumBlocks(this->getEdgeCount(), [&](long begin, long end)
+        {
+            return kernels.edgeWirelength(this->edgeFrom.data() + begin, this->edgeTo.data() + begin, this->edgeWeight.data() + begin, x, y, end - begin);
+        });
+    }
+
+    double WirelengthEvaluator::calculateHPWL(const double *x, const double *y)
+    {
+        return this->sumBlocks(this->numHyperedges, [&](long firstNet, long lastNet)
+        {
+            double sum = 0;
+
+            for (long net = firstNet; net < lastNet; net++)
+            {
+                double minX = INFINITY;
+                double maxX = -INFINITY;
+                double minY = INFINITY;
+                double maxY = -INFINITY;
+
+                for (int j = this->hEdgesToFirstMemberCellArray[net]; j < this->hEdgesToFirstMemberCellArray[net + 1]; j++)
+                {
+                    const int cell = this->cellPinArray[j];
+                    double pinX;
+                    double pinY;
+
+                    if (cell < this->numCellsNoPads)
+                    {
+                        pinX = x[cell];
+                        pinY = y[cell];
+                    }
+                    else
+                    {
+                        // I/O pad
+                        pinX = this->pinLocations[cell - this->numCellsNoPads].x;
+                        pinY = this->pinLocations[cell - this->numCellsNoPads].y;
+                    }
+
+                    minX = std::min(minX, pinX);
+                    maxX = std::max(maxX, pinX);
+                    minY = std::min(minY, pinY);
+                    maxY = std::max(maxY, pinY);
+                }
+
+                if (minX <= maxX)
+                {
+                    sum += this->hEdgeWeights[net] * ((maxX - minX) + (maxY - minY));
+                }
+            }
+
+            return sum;
+        });
+    }
+}
@@ -2,6 +2,7 @@
 #define SFQPLACE_GROUPING_HPP
 
 #include "netlist.hpp"
+#include "netlistgraph.hpp"
 #include <ostream>
 
 struct SubgraphEdge {
@@ -28,7 +29,7 @@ class Subgraph {
          * X and Y dimensions from the original netlist placement information
          * for all cells in this subgraph (and by extension this logic level)
          */
-        void calcMinMaxCellDistances(Netlist &netlist);
+        void calcMinMaxCellDistances(const NetlistGraph &netlistGraph);
 
         void addVertex(const SubgraphVertex &vert);
         void addEdge(int origin, int target, double weight);
@@ -55,11 +56,17 @@ class Subgraph {
         std::unordered_map<int, SubgraphVertex> graph;
         std::unordered_set<SubgraphEdge*> edges;
 
-        void findMaxDistance(Netlist &netlist);
+        void findMaxDistance(const NetlistGraph &netlistGraph);
 };
 
 std::ostream& operator<<(std::ostream &out, const Subgraph &subgraph);
 
-void doGrouping(Netlist &netlist);
+/**
+ * Groups the placed netlist into supercells and places them.
+ *
+ * @param graph Compact view of the placed netlist, used by all passes that traverse it
+ * @param saveFiles Also write the supercell hypergraph and its placement to supercells.* files
+ */
+void doGrouping(Netlist &netlist, const NetlistGraph &graph, bool saveFiles = false);
 
 #endif //SFQPLACE_GROUPING_HPP
@@ -0,0 +1,42 @@
+#ifndef SFQPLACE_LEVELIZATION_HPP
+#define SFQPLACE_LEVELIZATION_HPP
+
+#include <vector>
+
+#include "netlistgraph.hpp"
+#include "threadpool.hpp"
+
+/**
+ * Logic levels of every node of a NetlistGraph: nodes without fan-in are on
+ * level 0, every other node is one level above its highest fan-in.
+ */
+struct Levelization {
+    // Logic level of every node, by NetlistGraph index
+    std::vector<int> levels;
+
+    // All nodes bucketed by level, in index order within a level
+    std::vector<int> order;
+    // The nodes of level l are order[levelOffsets[l]] up to (not including) order[levelOffsets[l + 1]]
+    std::vector<int> levelOffsets;
+
+    int getLevelCount(void) const { return (int) this->levelOffsets.size() - 1; };
+
+    const int* levelBegin(int level) const { return this->order.data() + this->levelOffsets[level]; };
+    const int* levelEnd(int level) const { return this->order.data() + this->levelOffsets[level + 1]; };
+    int getLevelSize(int level) const { return this->levelOffsets[level + 1] - this->levelOffsets[level]; };
+};
+
+/**
+ * Levelizes the graph one level at a time (level-synchronous Kahn's algorithm).
+ * Every frontier is split over the threads, which release the fan-out of their
+ * nodes by decrementing atomic in-degree counters. A node released while
+ * processing level l is on level l + 1.
+ *
+ * Nodes on a combinational loop are never released, they get one level above
+ * their highest released fan-in.
+ *
+ * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+ */
+Levelization levelize(const NetlistGraph &graph, PA3Placement::ThreadPool *threadPool = nullptr);
+
+#endif // SFQPLACE_LEVELIZATION_HPP
@@ -0,0 +1,44 @@
+#ifndef SFQPLACE_NEIGHBORHOOD_HPP
+#define SFQPLACE_NEIGHBORHOOD_HPP
+
+#include <vector>
+
+#include "netlistgraph.hpp"
+#include "threadpool.hpp"
+
+/**
+ * The bounded-level neighborhood of every movable cell of a NetlistGraph, computed once.
+ *
+ * The neighborhood of a node are all nodes reachable from it through fan-in and fan-out
+ * connections without leaving the logic levels within maxSearchLevel of its own level.
+ * The node itself is not part of it. I/O pads have an empty neighborhood.
+ *
+ * The neighborhoods are stored in CSR form as sorted index arrays, so two of them can be
+ * intersected or merged in linear time.
+ */
+class NeighborhoodCache {
+public:
+    /**
+     * Runs one breadth first search per cell, in parallel. Every thread marks visited
+     * nodes with the number of its current search (an epoch) instead of clearing a
+     * visited set for every search.
+     *
+     * @param levels Logic level of every node, by NetlistGraph index
+     * @param threadPool Threads to run on, or nullptr to run on the calling thread. Not owned.
+     */
+    NeighborhoodCache(const NetlistGraph &graph, const std::vector<int> &levels, int maxSearchLevel,
+                      PA3Placement::ThreadPool *threadPool = nullptr);
+
+    const int* neighborsBegin(int node) const { return this->neighbors.data() + this->offsets[node]; };
+    const int* neighborsEnd(int node) const { return this->neighbors.data() + this->offsets[node + 1]; };
+    int getNeighborCount(int node) const { return this->offsets[node + 1] - this->offsets[node]; };
+
+    long getTotalNeighborCount(void) const { return this->neighbors.size(); };
+
+private:
+    // numNodes + 1 entries, the last one is the size of neighbors
+    std::vector<long> offsets;
+    std::vector<int> neighbors;
+};
+
+#endif // SFQPLACE_NEIGHBORHOOD_HPP
@@ -2,13 +2,20 @@
 #define SFQPLACE_NETLIST_HPP
 
 #include <functional>
+#include <set>
 #include <string>
 #include <unordered_set>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include <CGAL/Exact_predicates_exact_constructions_kernel.h>
 #include <CGAL/Polygon_2.h>
 
+namespace PA3Placement {
+    struct Hypergraph;
+}
+
 static const std::string ISCAS85_NODE_TYPE_INPUT = "inpt";
 static const std::string ISCAS85_NODE_TYPE_FANOUT_BRANCH = "from";
 static const std::string NODE_TYPE_OUTPUT = "otpt";
@@ -48,6 +55,9 @@ public:
      * Reads a given netlist in the ISCAS '85 format.
      * If the file cannot be read this function will return false.
      * Otherwise, a successful load will return true.
+     *
+     * The file is memory mapped and tokenized in place. Fanout branches are
+     * eliminated and output pads are added while the nodes are created.
      */
     bool loadFromDisk(const std::string &filename);
 
@@ -70,6 +80,23 @@ public:
      */
     bool saveHypergraphFile(const std::string &outFilePrefix, bool genPadFile);
 
+    /**
+     * Converts the netlist directly into the hypergraph placed by FastPlace, the same one
+     * parseIbmFile would read from the files written by saveHypergraphFile(prefix, true).
+     *
+     * Movable cells are numbered by their hypergraphId, followed by the input pads and then
+     * the output pads.
+     */
+    void buildHypergraph(PA3Placement::Hypergraph &hypergraph);
+
+    /**
+     * Stores the placement computed by FastPlace for a hypergraph built by buildHypergraph.
+     *
+     * @param cellLocations Location of every movable cell, indexed by hypergraphId
+     *                      (e.g. AnalyticPlacer::getSpreadCellLocations())
+     */
+    void applyPlacement(const std::vector<std::pair<double, double>> &cellLocations);
+
     /**
      * Calculates the distance in terms of logic levels between two nodes.
      *
@@ -85,6 +112,14 @@ private:
 
     void hypergraphWriteNode(const NetlistNode &node, std::ostream &areaFile, std::ostream &graphFile);
 
+    /**
+     * Assigns hypergraph IDs and splits the nodes in the order they are placed in:
+     * movable cells by hypergraphId, then input pads and output pads.
+     */
+    void orderHypergraphNodes(std::vector<int> &gateCells,
+                              std::set<int, std::greater<int>> &inPads,
+                              std::set<int, std::greater<int>> &outPads);
+
     /**
      * Generates a .kiaPad file with auto-spaced pad locations for the given set of
      * cell IDs.
@@ -93,22 +128,43 @@ private:
                          const std::set<int, std::greater<int>> &inPads,
                          const std::set<int, std::greater<int>> &outPads);
 
-    /**
-     * Iterates through the netlist removing "fanout branches",
-     * a special type of node defined by the ISCAS85 format, but useless.
-     */
-    void eliminateFanoutBranches(void);
-
     /**
      * Assigns a "hypergraphId" to each node that does not skip numbers,
      * used to create the hypergraph netlist format.
      */
     void consolidateIds(void);
 
+    // A node line of the ISCAS file, before the nodes are created
+    struct LoadedNode {
+        int id;
+        // Name in the mapped file
+        const char *name;
+        size_t nameLength;
+        // Index in nodeTypes
+        int type;
+        // Fanin IDs, as written in the file (may be fanout branches)
+        int firstFanIn;
+        int numFanIn;
+    };
+
+    // Every distinct node type read, each stored once
+    std::vector<std::string> nodeTypes;
+
     /**
-     * Adds output pad nodes to any cell with zero fan out.
+     * Returns the index of the node type in nodeTypes, adding it if it is new
+     */
+    int internNodeType(const char *type, size_t length);
+
+    /**
+     * Creates the nodes read by loadFromDisk in one pass: "fanout branches", a special
+     * type of node defined by the ISCAS85 format but useless, are replaced by direct
+     * connections to the node they branch from, and output pad nodes are added to any
+     * cell with zero fan out.
+     *
+     * @param branches (fanout branch ID, ID of the node it branches from) pairs
      */
-    void addOutputs(void);
+    void buildNodes(const std::vector<LoadedNode> &nodes, const std::vector<int> &fanInIds,
+                    const std::vector<std::pair<int, int>> &branches, int maxId);
 };
 
 std::ostream& operator<<(std::ostream &out, const Netlist &netlist);
@@ -0,0 +1,86 @@
+#ifndef SFQPLACE_NETLISTGRAPH_HPP
+#define SFQPLACE_NETLISTGRAPH_HPP
+
+#include <cstdint>
+#include <vector>
+
+#include "netlist.hpp"
+
+enum class NodeType : uint8_t {
+    GATE,
+    INPUT,
+    OUTPUT,
+    FANOUT_BRANCH
+};
+
+/**
+ * Read-only compact view of a Netlist for the passes that traverse it.
+ *
+ * Nodes get dense indices 0 .. getNodeCount() - 1 in increasing order of their
+ * ISCAS IDs. The fan-in and fan-out lists are stored in CSR form (one offset
+ * array and one flat index array each, every list sorted), and the placement is
+ * stored as separate X and Y arrays. Traversals only touch these flat arrays
+ * instead of hashing node IDs and following pointers through the map.
+ *
+ * The view is a snapshot: it does not change if the netlist is modified later.
+ */
+class NetlistGraph {
+public:
+    explicit NetlistGraph(const Netlist &netlist);
+
+    int getNodeCount(void) const { return this->ids.size(); };
+
+    /**
+     * Returns the index of the node with the given ISCAS ID, or -1 if there is none.
+     */
+    int getIndex(int id) const {
+        return (id >= 0 && id < (int) this->indices.size()) ? this->indices[id] : -1;
+    };
+
+    int getId(int index) const { return this->ids[index]; };
+    NodeType getType(int index) const { return this->types[index]; };
+
+    bool isPad(int index) const {
+        return this->types[index] == NodeType::INPUT || this->types[index] == NodeType::OUTPUT;
+    };
+
+    // Fan-in of node i: faninBegin(i) up to (not including) faninEnd(i)
+    const int* faninBegin(int index) const { return this->fanins.data() + this->faninOffsets[index]; };
+    const int* faninEnd(int index) const { return this->fanins.data() + this->faninOffsets[index + 1]; };
+    int getFaninCount(int index) const { return this->faninOffsets[index + 1] - this->faninOffsets[index]; };
+
+    // Fan-out of node i: fanoutBegin(i) up to (not including) fanoutEnd(i)
+    const int* fanoutBegin(int index) const { return this->fanouts.data() + this->fanoutOffsets[index]; };
+    const int* fanoutEnd(int index) const { return this->fanouts.data() + this->fanoutOffsets[index + 1]; };
+    int getFanoutCount(int index) const { return this->fanoutOffsets[index + 1] - this->fanoutOffsets[index]; };
+
+    bool isPlaced(int index) const { return this->placed[index] != 0; };
+    double getX(int index) const { return this->x[index]; };
+    double getY(int index) const { return this->y[index]; };
+
+private:
+    // Index --> ISCAS ID
+    std::vector<int> ids;
+    // ISCAS ID --> index, -1 for IDs without a node
+    std::vector<int> indices;
+    std::vector<NodeType> types;
+
+    // numNodes + 1 entries each, the last one is the total number of connections
+    std::vector<int> faninOffsets;
+    std::vector<int> fanins;
+    std::vector<int> fanoutOffsets;
+    std::vector<int> fanouts;
+
+    std::vector<char> placed;
+    std::vector<double> x;
+    std::vector<double> y;
+
+    /**
+     * Fills offsets and targets with the lists returned by getList for every node, as indices
+     */
+    void buildAdjacency(const Netlist &netlist,
+                        const std::unordered_set<int>& (*getList)(const NetlistNode &node),
+                        std::vector<int> &offsets, std::vector<int> &targets);
+};
+
+#endif // SFQPLACE_NETLISTGRAPH_HPP
@@ -9,7 +9,10 @@
 
 class SupercellsPlacer {
 public:
-    SupercellsPlacer(Netlist *originalNetlist, std::unordered_map<int, Subgraph*> *subgraphs);
+    /**
+     * @param saveFiles Write the supercell hypergraph and its placement to supercells.* files
+     */
+    SupercellsPlacer(Netlist *originalNetlist, std::unordered_map<int, Subgraph*> *subgraphs, bool saveFiles = false);
 
     void process();
 
@@ -17,6 +20,7 @@ public:
 private:
     Netlist *originalNetlist;
     Netlist supercellNetlist;
+    bool saveFiles;
     std::unordered_map<int, Subgraph*> *subgraphs;
 
     std::unordered_map<int, std::unordered_set<int>> supercells;
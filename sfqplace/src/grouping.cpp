@@ -12,12 +12,16 @@
 #include <queue>
 #include <cmath>
 #include <algorithm>
+#include <atomic>
 #include <fstream>
 
 #include <CGAL/Min_circle_2.h>
 #include <CGAL/convex_hull_2.h>
 
 #include "netlist.hpp"
+#include "levelization.hpp"
+#include "neighborhood.hpp"
+#include "netlistgraph.hpp"
 #include "partitioning.hpp"
 #include "supercells.hpp"
 #include "util.hpp"
@@ -31,9 +35,10 @@ static const int NORMALIZATION_FACTOR = MAX_SEARCH_LEVEL;
 // TODO: what use for Beta?
 static const int DISTANCE_NORMALIZATION_FACTOR = 2;
 
-// Map from level to all gates at that level
+// Map from level to all gates (IDs) at that level
 map<int, vector<int>> levelToNodes;
-unordered_map<int, int> nodeLevelMap;
+// Logic level of every node by NetlistGraph index, and the nodes bucketed by level
+Levelization levelization;
 
 unordered_map<int, Subgraph*> subgraphs;
 
@@ -41,11 +46,11 @@ unordered_map<int, Subgraph*> subgraphs;
  * Makes a subgraph from the main Netlist. Only adds nodes
  * of the specified logic level to the map
  */
-static Subgraph* makeSubgraph(Netlist &netlist, int logicLevel) {
-    Subgraph *graph = nullptr;
+static Subgraph* makeSubgraph(const NetlistGraph &graph, int logicLevel) {
+    Subgraph *subgraph = nullptr;
 
     if (levelToNodes.find(logicLevel) != levelToNodes.end()) {
-        graph = new Subgraph(logicLevel);
+        subgraph = new Subgraph(logicLevel);
 
         // Add verticies from all nodes at this logic level
         for (const int gateID : levelToNodes.at(logicLevel)) {
@@ -53,13 +58,13 @@ static Subgraph* makeSubgraph(Netlist &netlist, int logicLevel) {
             vert.id = gateID;
 
             // Only work with moveable cells in the subgraph
-            if (!netlist.at(gateID).isPrimaryInput && !netlist.at(gateID).isPrimaryOutput) {
-                graph->addVertex(vert);
+            if (!graph.isPad(graph.getIndex(gateID))) {
+                subgraph->addVertex(vert);
             }
         }
     }
 
-    return graph;
+    return subgraph;
 }
 
 static double euclidean_distance(const Point& a, const Point& b)
@@ -75,21 +80,22 @@ Subgraph::~Subgraph() {
     }
 }
 
-void Subgraph::calcMinMaxCellDistances(Netlist &netlist) {
+void Subgraph::calcMinMaxCellDistances(const NetlistGraph &netlistGraph) {
     // Find minimum distance between all points
     // TODO: This is brute force method. Update this to a faster
     // version if necessary
     this->minCellDistance = std::numeric_limits<double>::max();
 
     for (const auto &[id1, v1] : this->graph) {
-        if (netlist.at(id1).placement.isPlaced) {
+        const int node1 = netlistGraph.getIndex(id1);
+
+        if (netlistGraph.isPlaced(node1)) {
             for (const auto &[id2, v2] : this->graph) {
-                NetlistNode &node1 = netlist.at(id1);
-                NetlistNode &node2 = netlist.at(id2);
+                const int node2 = netlistGraph.getIndex(id2);
 
-                if (id2 != id1 && node2.placement.isPlaced) {
-                    double dist = sqrt(pow(node1.placement.p.x() - node2.placement.p.x(), 2) +
-                                       pow(node1.placement.p.y() - node2.placement.p.y(), 2));
+                if (id2 != id1 && netlistGraph.isPlaced(node2)) {
+                    double dist = sqrt(pow(netlistGraph.getX(node1) - netlistGraph.getX(node2), 2) +
+                                       pow(netlistGraph.getY(node1) - netlistGraph.getY(node2), 2));
 
                     this->minCellDistance = std::min(this->minCellDistance, dist);
                 }
@@ -97,7 +103,7 @@ void Subgraph::calcMinMaxCellDistances(Netlist &netlist) {
         }
     }
 
-    this->findMaxDistance(netlist);
+    this->findMaxDistance(netlistGraph);
 
     // Workaround to division by zero in distance graph processing
     // We need these two values to be different
@@ -107,14 +113,16 @@ void Subgraph::calcMinMaxCellDistances(Netlist &netlist) {
     }
 }
 
-void Subgraph::findMaxDistance(Netlist &netlist) {
+void Subgraph::findMaxDistance(const NetlistGraph &netlistGraph) {
     std::vector<Point> hull;
     std::vector<Point> points;
 
     // Gather all cells with placement info
     for (const auto &[id, v] : this->graph) {
-        if (netlist.at(id).placement.isPlaced) {
-            points.push_back(netlist.at(id).placement.p);
+        const int node = netlistGraph.getIndex(id);
+
+        if (netlistGraph.isPlaced(node)) {
+            points.push_back(Point(netlistGraph.getX(node), netlistGraph.getY(node)));
         }
     }
 
@@ -215,126 +223,163 @@ std::ostream& operator<<(std::ostream &out, const Subgraph &subgraph) {
     return out;
 }
 
-std::unordered_set<NetlistNode*> findNeighbors(Netlist &netlist, int baseNode, int maxSearchLevel) {
-    std::unordered_set<NetlistNode*> neighbors;
-    std::queue<NetlistNode*> Q;
-
-    Q.push(&netlist.at(baseNode));
+void computeLogicLevels(const NetlistGraph &graph, PA3Placement::ThreadPool *threadPool) {
+    levelization = levelize(graph, threadPool);
 
-    while(!Q.empty()) {
-        int levelDiff;
-        NetlistNode *front = Q.front();
-        Q.pop();
-
-        levelDiff = abs(nodeLevelMap[front->id] - nodeLevelMap[baseNode]);
-        if (levelDiff <= maxSearchLevel) {
-            // Base node is not a neighbor of itself
-            if (front->id != baseNode) {
-                neighbors.insert(front);
-            }
+    levelToNodes.clear();
+    for (int level = 0; level < levelization.getLevelCount(); level++) {
+        if (levelization.getLevelSize(level) > 0) {
+            vector<int> &nodes = levelToNodes[level];
 
-            // Foreach child node
-            for (const int child : front->fanOutList) {
-                if (abs(nodeLevelMap.at(child) - nodeLevelMap.at(baseNode)) <= maxSearchLevel
-                        && neighbors.find(&netlist.at(child)) == neighbors.end()) {
-                    Q.push(&netlist.at(child));
-                }
-            }
-            
-            // Foreach parent node
-            for (const int parent : front->fanInList) {
-                if (abs(nodeLevelMap.at(parent) - nodeLevelMap.at(baseNode)) <= maxSearchLevel
-                        && neighbors.find(&netlist.at(parent)) == neighbors.end()) {
-                    Q.push(&netlist.at(parent));
-                }
+            nodes.reserve(levelization.getLevelSize(level));
+            for (const int *node = levelization.levelBegin(level); node != levelization.levelEnd(level); node++) {
+                nodes.push_back(graph.getId(*node));
             }
         }
     }
 
-    return neighbors;
+    std::cout << graph.getNodeCount() << " nodes on " << levelization.getLevelCount() << " logic levels" << std::endl;
 }
 
-void computeLogicLevels(Netlist &netlist) {
-    unordered_map<int, int> inDegree;
-    for (const auto &[id, gate] : netlist) {
-        inDegree[id] = gate.fanInList.size();
-        nodeLevelMap[id] = 0;
-    }
+// Super-cell ID assignment: cellID -> groupID
+unordered_map<int, int> superCellMap;
 
-    queue<int> q;
-    for (const auto &[id, deg] : inDegree)
-        if (deg == 0) q.push(id);
+/**
+ * Per thread work arrays of addLevelConnectivity, reused for every level
+ */
+struct ConnectivityWorkspace {
+    // Inverted list of every neighbor of the level, by NetlistGraph index
+    vector<int> groupOf;
 
-    while (!q.empty()) {
-        int u = q.front(); q.pop();
-        int uLevel = nodeLevelMap[u];
-        for (int v : netlist[u].fanOutList) {
-            nodeLevelMap[v] = max(nodeLevelMap[v], uLevel + 1);
-            if (--inDegree[v] == 0) q.push(v);
+    // Weight accumulated for every cell of the level, and the cells with a nonzero weight
+    vector<double> weights;
+    vector<int> touched;
+};
+
+/**
+ * Adds the connectivity edges of one logic level to its subgraph. Two cells are connected once
+ * for every neighbor they share, with weight NORMALIZATION_FACTOR / (level difference to that
+ * neighbor) in each direction of the pair.
+ *
+ * Instead of testing every pair of cells, the neighborhoods are inverted (neighbor --> cells of this
+ * level that have it), so only pairs that share a neighbor are ever looked at. The weights of the
+ * pairs of cell u are then summed in a dense accumulator over the cells of the level.
+ */
+static void addLevelConnectivity(const NetlistGraph &graph, const NeighborhoodCache &neighborhoods,
+                                 int level, const vector<int> &nodes, Subgraph &subgraph,
+                                 ConnectivityWorkspace &workspace) {
+    // Edges to I/O pads are not part of the subgraph. Cells are in index order.
+    vector<int> cells;
+    for (const int id : nodes) {
+        const int node = graph.getIndex(id);
+        if (!graph.isPad(node)) {
+            cells.push_back(node);
         }
     }
 
-    for (const auto &[id, level] : nodeLevelMap) {
-        std::cout << "Node: " << id << ", level: " << level << std::endl;
-        levelToNodes[level].push_back(id);
+    // (neighbor, cell position) for every cell of the level and every one of its neighbors,
+    // sorted into one group of cells per neighbor
+    vector<pair<int, int>> sharers;
+    for (int u = 0; u < (int) cells.size(); u++) {
+        for (const int *neighbor = neighborhoods.neighborsBegin(cells[u]); neighbor != neighborhoods.neighborsEnd(cells[u]); neighbor++) {
+            sharers.push_back({*neighbor, u});
+        }
     }
-}
-
-// Super-cell ID assignment: cellID -> groupID
-unordered_map<int, int> superCellMap;
-
-void connectivityGraphProcessing(Netlist &netlist) {
-    for (const auto &[level, nodes] : levelToNodes) {
-        for (const int u : nodes) {
-            for (const int v : nodes) {
-                if (u != v) {
-                    std::unordered_set<NetlistNode*> uNeighbors;
-                    std::unordered_set<NetlistNode*> vNeighbors;
-                    std::unordered_set<NetlistNode*> commonNeighbors;
+    sort(sharers.begin(), sharers.end());
+
+    // The cells of group g are groupCells[groupOffsets[g]] up to groupCells[groupOffsets[g + 1]]
+    vector<int> groupOffsets;
+    vector<int> groupCells(sharers.size());
+    vector<double> groupWeights;
+    for (size_t k = 0; k < sharers.size(); k++) {
+        const int neighbor = sharers[k].first;
+
+        if (k == 0 || sharers[k - 1].first != neighbor) {
+            // A neighbor on the same level counts like one a level away
+            const int levelDiff = max(1, abs(level - levelization.levels[neighbor]));
+
+            workspace.groupOf[neighbor] = groupOffsets.size();
+            groupOffsets.push_back(k);
+            // Once for (u, v) and once for (v, u)
+            groupWeights.push_back(2.0 * NORMALIZATION_FACTOR / levelDiff);
+        }
+        groupCells[k] = sharers[k].second;
+    }
+    groupOffsets.push_back(sharers.size());
+    vector<pair<int, int>>().swap(sharers);
+
+    workspace.weights.assign(cells.size(), 0);
+    for (int u = 0; u < (int) cells.size(); u++) {
+        workspace.touched.clear();
+
+        // Every v > u sharing a neighbor with u
+        for (const int *neighbor = neighborhoods.neighborsBegin(cells[u]); neighbor != neighborhoods.neighborsEnd(cells[u]); neighbor++) {
+            const int group = workspace.groupOf[*neighbor];
+            const int *groupBegin = groupCells.data() + groupOffsets[group];
+            const int *groupEnd = groupCells.data() + groupOffsets[group + 1];
+            const double weight = groupWeights[group];
+
+            for (const int *v = upper_bound(groupBegin, groupEnd, u); v != groupEnd; v++) {
+                if (workspace.weights[*v] == 0) {
+                    workspace.touched.push_back(*v);
+                }
+                workspace.weights[*v] += weight;
+            }
+        }
 
-                    NetlistNode *uNode = &netlist.at(u);
-                    NetlistNode *vNode = &netlist.at(v);
+        sort(workspace.touched.begin(), workspace.touched.end());
+        for (const int v : workspace.touched) {
+            subgraph.addEdge(graph.getId(cells[u]), graph.getId(cells[v]), workspace.weights[v]);
+            workspace.weights[v] = 0;
+        }
+    }
+}
 
-                    // TODO: cache neighbors for each node ahead of time
-                    uNeighbors = findNeighbors(netlist, uNode->id, MAX_SEARCH_LEVEL);
-                    vNeighbors = findNeighbors(netlist, vNode->id, MAX_SEARCH_LEVEL);
+void connectivityGraphProcessing(const NetlistGraph &graph, PA3Placement::ThreadPool *threadPool) {
+    // Neighbors of every cell, computed once instead of for every pair it is part of
+    const NeighborhoodCache neighborhoods(graph, levelization.levels, MAX_SEARCH_LEVEL, threadPool);
+    std::cout << "Found " << neighborhoods.getTotalNeighborCount() << " neighbors within "
+              << MAX_SEARCH_LEVEL << " logic levels" << std::endl;
 
-                    commonNeighbors = uNeighbors;
-                    commonNeighbors.merge(vNeighbors);
+    // Every level only adds edges to its own subgraph, so the levels are processed in parallel
+    vector<const pair<const int, vector<int>>*> levels;
+    for (const auto &levelNodes : levelToNodes) {
+        levels.push_back(&levelNodes);
+    }
 
-                    for (const auto &neighbor : commonNeighbors) {
-                        if (u != neighbor->id && v != neighbor->id) {
-                            int levelDiff = abs(nodeLevelMap[u] - nodeLevelMap[neighbor->id]);
-                            double edgeWeight = NORMALIZATION_FACTOR / (levelDiff * 1.0);
+    atomic<size_t> nextLevel(0);
+    auto worker = [&](int) {
+        ConnectivityWorkspace workspace;
+        workspace.groupOf.resize(graph.getNodeCount());
 
-                            subgraphs.at(level)->addEdge(u, v, edgeWeight);
-#if 0
-                            std::cout << "Edge Weight added between " << u << " (" << nodeLevelMap[u] << ")";
-                            std::cout << " and " << neighbor->id << " (" << nodeLevelMap[neighbor->id] << ")";
-                            std::cout << " is " << edgeWeight;
-                            std::cout << " (v is " << v << ")" << std::endl;
-#endif
-                        }
-                    }
-                }
-            }
+        for (size_t i = nextLevel++; i < levels.size(); i = nextLevel++) {
+            const auto &[level, nodes] = *levels[i];
+            addLevelConnectivity(graph, neighborhoods, level, nodes, *subgraphs.at(level), workspace);
         }
+    };
+
+    if (threadPool == nullptr || threadPool->getThreadCount() == 1) {
+        worker(0);
+    } else {
+        threadPool->run(worker);
     }
 }
 
-void distanceGraphProcessing(Netlist &netlist) {
+void distanceGraphProcessing(const NetlistGraph &graph) {
     for (const auto &[level, subgraph] : subgraphs) {
         // TODO: is Ximin and Ximax only X/Y dimension or euclidean distance?
 
         for (const auto &[id, vertex] : subgraph->getVertices()) {
             for (const auto &[id2, vertex2] : subgraph->getVertices()) {
-                if (id != id2 && netlist.at(id).placement.isPlaced 
-                        && netlist.at(id2).placement.isPlaced) {
+                const int u = graph.getIndex(id);
+                const int v = graph.getIndex(id2);
+
+                if (id != id2 && graph.isPlaced(u) && graph.isPlaced(v)) {
                     // Calculate distance between cells
-                    double Xu = netlist.at(id).placement.p.x();
-                    double Xv = netlist.at(id2).placement.p.y();
-                    double Yu = netlist.at(id).placement.p.x();
-                    double Yv = netlist.at(id2).placement.p.y();
+                    double Xu = graph.getX(u);
+                    double Xv = graph.getY(v);
+                    double Yu = graph.getX(u);
+                    double Yv = graph.getY(v);
 
                     double Wx = DISTANCE_NORMALIZATION_FACTOR * (
                             1 - ((abs(Xu - Xv) - subgraph->getMinCellDistance())
@@ -381,29 +426,31 @@ void writeGroupingToFile(const string &filename) {
     cout << "Super-cell mapping written to " << filename << endl;
 }
 
-void doGrouping(Netlist &netlist) {
+void doGrouping(Netlist &netlist, const NetlistGraph &graph, bool saveFiles) {
     // Dummy parser: insert gate parsing code here or link to your existing parser
     // Example: parsingCircuitFile("b15_1.isc", netlist);
 
+    PA3Placement::ThreadPool threadPool(PA3Placement::ThreadPool::getDefaultThreadCount());
+
     std::cout << "Computing Logic levels..." << std::endl;
-    computeLogicLevels(netlist);
+    computeLogicLevels(graph, &threadPool);
 
 
     // Create the subgraphs for each logic level
     for (const auto &[level, nodes] : levelToNodes) {
         std::cout << "Creating subgraph for level " << level << std::endl;
-        subgraphs[level] = makeSubgraph(netlist, level);
+        subgraphs[level] = makeSubgraph(graph, level);
     }
 
     std::cout << "Running connectivity-based graph processing" << std::endl;
 
     // Run connectivity-based graph processing step
-    connectivityGraphProcessing(netlist);
+    connectivityGraphProcessing(graph, &threadPool);
 
     // Calculate min/max cell distances
     for (const auto &[level, subgraph] : subgraphs) {
         std::cout << "Calculating min/max cell distances for subgraph " << level << std::endl;
-        subgraph->calcMinMaxCellDistances(netlist);
+        subgraph->calcMinMaxCellDistances(graph);
     }
 
 #if 0
@@ -412,13 +459,13 @@ void doGrouping(Netlist &netlist) {
 
     // Run Distance-based Graph Processing step
     std::cout << "Running distance-based graph processing" << std::endl;
-    distanceGraphProcessing(netlist);
+    distanceGraphProcessing(graph);
 
 #if 0
     std::cout << "Subgraph 3 (Distance Processed)" << std::endl << *(subgraphs.at(3)) << std::endl;
 #endif
 
-    SupercellsPlacer supercells(&netlist, &subgraphs);
+    SupercellsPlacer supercells(&netlist, &subgraphs, saveFiles);
     supercells.process();
     supercells.displaySupercells(std::cout);
 }
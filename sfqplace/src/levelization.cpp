@@ -0,0 +1,108 @@
+#include "levelization.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+// Frontiers smaller than this are processed on the calling thread, waking the
+// threads would take longer than the frontier itself
+static const int PARALLEL_FRONTIER_SIZE = 4096;
+
+Levelization levelize(const NetlistGraph &graph, PA3Placement::ThreadPool *threadPool) {
+    const int count = graph.getNodeCount();
+    const int threadCount = (threadPool != nullptr) ? threadPool->getThreadCount() : 1;
+
+    Levelization result;
+    // -1 until the node is released
+    result.levels.assign(count, -1);
+
+    // Fan-ins of every node that have not been processed yet
+    std::unique_ptr<std::atomic<int>[]> inDegrees(new std::atomic<int>[count]);
+    std::vector<int> frontier;
+
+    for (int i = 0; i < count; i++) {
+        inDegrees[i].store(graph.getFaninCount(i), std::memory_order_relaxed);
+        if (graph.getFaninCount(i) == 0) {
+            result.levels[i] = 0;
+            frontier.push_back(i);
+        }
+    }
+
+    // Nodes released by every thread while processing the current frontier
+    std::vector<std::vector<int>> released(threadCount);
+
+    // Processes frontier[begin, end): the last fan-in of a node to be processed releases it.
+    // Only the counters are shared, and the pool's join orders everything else.
+    auto processFrontier = [&](int thread, long begin, long end) {
+        std::vector<int> &next = released[thread];
+
+        for (long k = begin; k < end; k++) {
+            const int u = frontier[k];
+
+            for (const int *v = graph.fanoutBegin(u); v != graph.fanoutEnd(u); v++) {
+                if (inDegrees[*v].fetch_sub(1, std::memory_order_relaxed) == 1) {
+                    next.push_back(*v);
+                }
+            }
+        }
+    };
+
+    int maxLevel = frontier.empty() ? -1 : 0;
+    for (int level = 0; !frontier.empty(); level++) {
+        const long size = frontier.size();
+
+        if (threadCount == 1 || size < PARALLEL_FRONTIER_SIZE) {
+            processFrontier(0, 0, size);
+        } else {
+            threadPool->run([&](int thread) {
+                processFrontier(thread, size * thread / threadCount, size * (thread + 1) / threadCount);
+            });
+        }
+
+        frontier.clear();
+        for (std::vector<int> &next : released) {
+            for (const int v : next) {
+                result.levels[v] = level + 1;
+            }
+            frontier.insert(frontier.end(), next.begin(), next.end());
+            next.clear();
+        }
+
+        if (!frontier.empty()) {
+            maxLevel = level + 1;
+        }
+    }
+
+    // Nodes on combinational loops are never released (their counter stays above zero). Like the
+    // serial traversal they get one level above the highest fan-in that was.
+    for (int i = 0; i < count; i++) {
+        if (inDegrees[i].load(std::memory_order_relaxed) > 0) {
+            int level = 0;
+            for (const int *u = graph.faninBegin(i); u != graph.faninEnd(i); u++) {
+                if (inDegrees[*u].load(std::memory_order_relaxed) == 0) {
+                    level = std::max(level, result.levels[*u] + 1);
+                }
+            }
+
+            result.levels[i] = level;
+            maxLevel = std::max(maxLevel, level);
+        }
+    }
+
+    // Bucket the nodes by level with a counting sort, which keeps index order within a level
+    result.levelOffsets.assign(maxLevel + 2, 0);
+    for (int i = 0; i < count; i++) {
+        result.levelOffsets[result.levels[i] + 1]++;
+    }
+    for (int level = 0; level <= maxLevel; level++) {
+        result.levelOffsets[level + 1] += result.levelOffsets[level];
+    }
+
+    std::vector<int> positions(result.levelOffsets.begin(), result.levelOffsets.end() - 1);
+    result.order.resize(count);
+    for (int i = 0; i < count; i++) {
+        result.order[positions[result.levels[i]]++] = i;
+    }
+
+    return result;
+}
@@ -1,71 +1,67 @@
 // Based on fastplace main.cpp
+#include <cstdio>
 #include <iostream>
 #include <cstring>
 #include <ostream>
 
-#include "suraj_parser.h"
 #include "placer.hpp"
 #include "netlist.hpp"
+#include "netlistgraph.hpp"
 #include "grouping.hpp"
 
 
 int main(int argv, char *argc[])
 {
-    char inareFileName[100];
-    char innetFileName[100];
     char iniscasFileName[100];
-    char inPadLocationFileName[100];
+    // Write the intermediate hypergraph and placement files, e.g. to inspect them or run PA3 on them
+    bool saveFiles = false;
 
-    if (argv!=2) {
+    if (argv == 3 && strcmp(argc[2], "--save-files") == 0) {
+        saveFiles = true;
+    } else if (argv != 2) {
         std::cout << "Please provide a circuit file name with no extension." << std::endl;
+        std::cout << "Usage: sfqplace [circuit] [--save-files]" << std::endl;
         return 1;
     }
 
-    strcpy (inareFileName, argc[1]);
-    strcat(inareFileName, ".are");
-    strcpy(innetFileName,argc[1]);
-    strcat(innetFileName,".net");
     strcpy(iniscasFileName, argc[1]);
     strcat(iniscasFileName, ".isc");
-    strcpy(inPadLocationFileName,argc[1]);
-    strcat(inPadLocationFileName,".kiaPad");
 
     std::cout << "Reading ISCAS circuit file " << iniscasFileName << std::endl;
 
     Netlist *netlist = new Netlist();
     netlist->loadFromDisk(iniscasFileName);
-    
-    std::cout << "Converting to hypergraph format." << std::endl;
-    netlist->saveHypergraphFile(argc[1], true);
 
-    std::cout << "Feeding hypergraph to FastPlace" << std::endl;
-    int success = parseIbmFile(inareFileName, innetFileName, inPadLocationFileName);
-    if (success == -1) {
-        cout << "Error reading input file(s)" << endl;
-        return 0;
+    if (saveFiles) {
+        std::cout << "Saving hypergraph files." << std::endl;
+        netlist->saveHypergraphFile(argc[1], true);
     }
 
-    printf("\nNumber of vertices,hyper = %d %d\n",numCellsAndPads,numhyper);
+    std::cout << "Converting to hypergraph format." << std::endl;
+    PA3Placement::Hypergraph hypergraph;
+    netlist->buildHypergraph(hypergraph);
+
+    printf("\nNumber of vertices,hyper = %d %d\n",hypergraph.numCellsAndPads,hypergraph.numhyper);
 
-    PA3Placement::AnalyticPlacer placer;
+    PA3Placement::PlacerSettings settings;
+    settings.saveFiles = saveFiles;
+    // Grouping starts from the spread placement, legalizing it would be wasted work
+    settings.legalization = PA3Placement::LegalizationMode::NONE;
+    settings.detailedPasses = 0;
+    PA3Placement::AnalyticPlacer placer(hypergraph, settings);
 
     std::cout << "Invoking FastPlace" << std::endl;
     placer.doPlacement(argc[1]);
 
     std::cout << "Loading initial Placement data" << std::endl;
-
-    // Placement is saved in "xx_spread.kiaPad"
-    netlist->loadPlacementKiaPad(std::string(argc[1]) + "_spread");
+    netlist->applyPlacement(placer.getSpreadCellLocations());
 
     std::cout << "NETLIST OBJECT DUMP:" << std::endl;
     std::cout << *netlist << std::endl;
 
-    doGrouping(*netlist);
+    // All passes from here on traverse the compact graph instead of the node map
+    NetlistGraph graph(*netlist);
+    doGrouping(*netlist, graph, saveFiles);
 
     delete netlist;
-
-    free(pinLocations);
-    free(hEdge_idxToFirstEntryInPinArray);
-    free(cellPinArray);
-    free(hyperwts);
 }
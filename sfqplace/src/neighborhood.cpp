@@ -0,0 +1,112 @@
+#include "neighborhood.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+
+// Nodes handed to a thread at a time. Neighborhood sizes vary a lot,
+// so the threads take blocks from a shared counter until none are left.
+static const int NEIGHBORHOOD_BLOCK_SIZE = 256;
+
+/**
+ * Breadth first search state of one thread, reused for every search
+ */
+struct NeighborhoodSearch {
+    // visitMarks[node] == epoch if node was visited by the current search
+    std::vector<unsigned int> visitMarks;
+    unsigned int epoch = 0;
+    std::vector<int> queue;
+};
+
+/**
+ * Appends the sorted neighborhood of baseNode to out
+ */
+static void findNeighborhood(const NetlistGraph &graph, const std::vector<int> &levels, int maxSearchLevel,
+                             int baseNode, NeighborhoodSearch &search, std::vector<int> &out) {
+    if (++search.epoch == 0) {
+        // The epoch wrapped around, old marks could look current
+        std::fill(search.visitMarks.begin(), search.visitMarks.end(), 0);
+        search.epoch = 1;
+    }
+
+    const int baseLevel = levels[baseNode];
+    const size_t first = out.size();
+
+    search.queue.clear();
+    search.queue.push_back(baseNode);
+    search.visitMarks[baseNode] = search.epoch;
+
+    for (size_t head = 0; head < search.queue.size(); head++) {
+        const int front = search.queue[head];
+
+        // Base node is not a neighbor of itself
+        if (front != baseNode) {
+            out.push_back(front);
+        }
+
+        // Foreach child node
+        for (const int *child = graph.fanoutBegin(front); child != graph.fanoutEnd(front); child++) {
+            if (abs(levels[*child] - baseLevel) <= maxSearchLevel && search.visitMarks[*child] != search.epoch) {
+                search.visitMarks[*child] = search.epoch;
+                search.queue.push_back(*child);
+            }
+        }
+
+        // Foreach parent node
+        for (const int *parent = graph.faninBegin(front); parent != graph.faninEnd(front); parent++) {
+            if (abs(levels[*parent] - baseLevel) <= maxSearchLevel && search.visitMarks[*parent] != search.epoch) {
+                search.visitMarks[*parent] = search.epoch;
+                search.queue.push_back(*parent);
+            }
+        }
+    }
+
+    std::sort(out.begin() + first, out.end());
+}
+
+NeighborhoodCache::NeighborhoodCache(const NetlistGraph &graph, const std::vector<int> &levels, int maxSearchLevel,
+                                     PA3Placement::ThreadPool *threadPool) {
+    const int count = graph.getNodeCount();
+    const int blockCount = (count + NEIGHBORHOOD_BLOCK_SIZE - 1) / NEIGHBORHOOD_BLOCK_SIZE;
+    const int threadCount = (threadPool != nullptr) ? threadPool->getThreadCount() : 1;
+
+    // Neighborhoods of every block, concatenated in block order afterwards
+    std::vector<std::vector<int>> blockNeighbors(blockCount);
+    std::vector<int> neighborCounts(count, 0);
+    std::atomic<int> nextBlock(0);
+
+    auto worker = [&](int) {
+        NeighborhoodSearch search;
+        search.visitMarks.assign(count, 0);
+
+        for (int block = nextBlock++; block < blockCount; block = nextBlock++) {
+            std::vector<int> &out = blockNeighbors[block];
+            const int end = std::min(count, (block + 1) * NEIGHBORHOOD_BLOCK_SIZE);
+
+            for (int node = block * NEIGHBORHOOD_BLOCK_SIZE; node < end; node++) {
+                if (!graph.isPad(node)) {
+                    const size_t before = out.size();
+                    findNeighborhood(graph, levels, maxSearchLevel, node, search, out);
+                    neighborCounts[node] = out.size() - before;
+                }
+            }
+        }
+    };
+
+    if (threadCount == 1 || blockCount == 1) {
+        worker(0);
+    } else {
+        threadPool->run(worker);
+    }
+
+    this->offsets.assign(count + 1, 0);
+    for (int node = 0; node < count; node++) {
+        this->offsets[node + 1] = this->offsets[node] + neighborCounts[node];
+    }
+
+    this->neighbors.reserve(this->offsets[count]);
+    for (std::vector<int> &out : blockNeighbors) {
+        this->neighbors.insert(this->neighbors.end(), out.begin(), out.end());
+        std::vector<int>().swap(out);
+    }
+}
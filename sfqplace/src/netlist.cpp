@@ -1,6 +1,10 @@
 #include "netlist.hpp"
 #include "suraj_parser.h"
+#include "hypergraph.hpp"
+#include "mappedfile.hpp"
+#include "nametable.hpp"
 
+#include <algorithm>
 #include <climits>
 #include <functional>
 #include <iostream>
@@ -10,110 +14,227 @@
 #include <queue>
 #include <sstream>
 #include <string>
+#include <string_view>
 
 static const int DEFAULT_CHIP_WIDTH = 6;
 static const int DEFAULT_CHIP_HEIGHT = 6;
 static const int DEFAULT_CELL_AREA = 4;
 
+using PA3Placement::MappedFile;
+using PA3Placement::NameTable;
+using PA3Placement::TextCursor;
+
+/**
+ * Parses a whole token as a decimal integer
+ */
+static bool parseInt(const char *token, size_t length, int &value) {
+    TextCursor cursor(token, token + length);
+    return cursor.nextInt(value);
+}
+
 bool Netlist::loadFromDisk(const std::string &filename) {
-    // Modified ChatGPT generated code
-    
-    bool status = true;
-    std::ifstream file(filename);
+    MappedFile file(filename.c_str());
 
-    if (!file.is_open()) {
+    if (!file.isOpen()) {
         std::cerr << "ISCAS85 Parser: Error opening file: " << filename << std::endl;
-        status = false;
-    } else {
-        std::string line;
-        std::unordered_map<std::string, int> nodeNamesToIds;
+        return false;
+    }
 
-        this->nextId = 0;
+    TextCursor cursor(file);
+    const char *token;
+    size_t length;
+
+    // Nodes are only read here, they are created once the file is done
+    std::vector<LoadedNode> nodes;
+    std::vector<int> fanInIds;
+    // Fanout branch ID --> ID of the node it branches from
+    std::vector<std::pair<int, int>> branches;
+    // Node name --> ID, names are copied once into the table's arena
+    NameTable nodeNamesToIds;
+    int maxId = -1;
+
+    nodes.reserve(file.getSize() / 64);
+    fanInIds.reserve(file.getSize() / 16);
+    nodeNamesToIds.reserve(file.getSize() / 32);
+
+    while (cursor.nextToken(token, length)) {
+        if (token[0] == '*') {
+            // Skip comments
+            cursor.skipLine();
+            continue;
+        }
 
-        while (std::getline(file, line)) {
-            if (!line.empty() && line[0] != '*') { // Skip comments
-                std::istringstream iss(line);
-                NetlistNode currentNode;
-                int numFanOut, numFanIn;
+        LoadedNode node;
+        const char *type;
+        size_t typeLength;
 
-                // Read in node ID
-                iss >> currentNode.id;
+        // "id name type", the ID is the token already read
+        if (!parseInt(token, length, node.id) || node.id < 0
+                || !cursor.nextToken(node.name, node.nameLength) || !cursor.nextToken(type, typeLength)) {
+            std::cerr << "ISCAS85 Parser: Bad node line in " << filename << std::endl;
+            return false;
+        }
 
-                if (currentNode.id >= this->nextId) {
-                    this->nextId = currentNode.id + 1;
-                }
+        maxId = std::max(maxId, node.id);
+        nodeNamesToIds.insert(node.name, node.nameLength, node.id);
 
-                // Check if this node is already in the netlist
-                if (this->find(currentNode.id) != this->end()) {
-                    // Obtain existing data (fanout list?)
-                    currentNode = this->at(currentNode.id);
+        if (std::string_view(type, typeLength) == ISCAS85_NODE_TYPE_FANOUT_BRANCH) {
+            // fanout branch type is special: "id name from fanInName faults..."
+            if (!cursor.nextToken(token, length)) {
+                std::cerr << "ISCAS85 Parser: Fanout branch " << node.id << " without a source in " << filename << std::endl;
+                return false;
+            }
+
+            const int source = nodeNamesToIds.find(token, length);
+            if (source < 0) {
+                std::cerr << "ISCAS85 Parser: Fanout branch " << node.id << " of unknown node "
+                          << std::string_view(token, length) << " in " << filename << std::endl;
+                return false;
+            }
+
+            branches.push_back({node.id, source});
+            // Ignore faults
+            cursor.skipLine();
+        } else {
+            int numFanOut, numFanIn;
+
+            // "id name type numFanOut numFanIn faults..." followed by a line of fanin IDs
+            if (!cursor.nextInt(numFanOut) || !cursor.nextInt(numFanIn) || numFanIn < 0) {
+                std::cerr << "ISCAS85 Parser: Bad fanout/fanin count for node " << node.id << " in " << filename << std::endl;
+                return false;
+            }
+            // Ignore faults
+            cursor.skipLine();
+
+            node.type = internNodeType(type, typeLength);
+            node.firstFanIn = fanInIds.size();
+            node.numFanIn = numFanIn;
+
+            for (int i = 0; i < numFanIn; i++) {
+                int fanInId;
+                if (!cursor.nextInt(fanInId)) {
+                    std::cerr << "ISCAS85 Parser: Missing fanin of node " << node.id << " in " << filename << std::endl;
+                    return false;
                 }
+                fanInIds.push_back(fanInId);
+            }
 
-                iss >> currentNode.name >> currentNode.nodeType;
+            nodes.push_back(node);
+        }
+    }
 
-                // Associate the name to the ID 
-                nodeNamesToIds[currentNode.name] = currentNode.id;
+    this->buildNodes(nodes, fanInIds, branches, maxId);
 
-                if (ISCAS85_NODE_TYPE_FANOUT_BRANCH == currentNode.nodeType) {
-                    // fanout branch type is special
-                    std::string fanInNodeName;
-                    iss >> fanInNodeName;
+    return true;
+}
 
-                    std::string fault;
-                    while (iss >> fault) {
-                        // Ignore faults
-                    }
+int Netlist::internNodeType(const char *type, size_t length) {
+    // There are only a handful of node types, a linear search is enough
+    const std::string_view name(type, length);
 
-                    // Link the fanout node to this fanout branch
-                    this->at(nodeNamesToIds.at(fanInNodeName)).fanOutList.insert(currentNode.id);
-                    // Add the originating fanout node to our fanin list
-                    currentNode.fanInList.insert(nodeNamesToIds.at(fanInNodeName));
-                } else {
-                    iss >> numFanOut >> numFanIn;
-
-                    if (ISCAS85_NODE_TYPE_INPUT == currentNode.nodeType) {
-                        currentNode.isPrimaryInput = true;
-                    }
-                    
-                    std::string fault;
-                    while (iss >> fault) {
-                        // Ignore faults
-                    }
-                    
-                    if (numFanIn > 0) {
-                        std::getline(file, line);
-
-                        std::istringstream fanin_stream(line);
-                        int fanin_node;
-
-                        while (fanin_stream >> fanin_node) {
-                            currentNode.fanInList.insert(fanin_node);
-
-                            // Look up the fanin node and add us to it's fanout list
-                            if (this->find(fanin_node) != this->end()) {
-                                // Fanin Node already in the netlist, add us to it
-                                this->at(fanin_node).fanOutList.insert(currentNode.id);
-                            } else {
-                                // Fanin Node not already in the netlist
-                                NetlistNode fanInNode;
-                                fanInNode.id = fanin_node;
-                                fanInNode.fanOutList.insert(currentNode.id);
-                            }
-                        }
-                    }
-                }
+    for (int i = 0; i < (int) this->nodeTypes.size(); i++) {
+        if (this->nodeTypes[i] == name) {
+            return i;
+        }
+    }
 
-                (*this)[currentNode.id] = currentNode;
-            }
+    this->nodeTypes.emplace_back(name);
+    return this->nodeTypes.size() - 1;
+}
+
+void Netlist::buildNodes(const std::vector<LoadedNode> &nodes, const std::vector<int> &fanInIds,
+                         const std::vector<std::pair<int, int>> &branches, int maxId) {
+    // Fanout branches are eliminated: every connection to a branch goes to the node it branches from.
+    // sources[id] is the node a connection to ID id ends at, -1 for unknown IDs
+    std::vector<int> sources(maxId + 1, -1);
+    std::vector<NetlistNode*> nodesById(maxId + 1, nullptr);
+    // Index in nodes of the line that created node id, later lines with the same ID are ignored
+    std::vector<int> declarations(maxId + 1, -1);
+
+    for (const LoadedNode &node : nodes) {
+        sources[node.id] = node.id;
+    }
+    for (const auto &[branch, source] : branches) {
+        sources[branch] = source;
+    }
+
+    // Branches of branches: follow them to the stem. A chain cannot be longer than the number of
+    // branches, anything longer is a cycle of branches (IDs declared twice) and has no stem.
+    for (const auto &[branch, source] : branches) {
+        int stem = source;
+        for (size_t steps = 0; stem >= 0 && sources[stem] != stem; steps++) {
+            stem = (steps < branches.size()) ? sources[stem] : -1;
         }
+        sources[branch] = stem;
+    }
 
-        // Add output "pads" for any cell that has a zero fanout
-        this->addOutputs();
+    this->clear();
+    this->hyperIdMappings.clear();
+    this->nextId = maxId + 1;
+    this->reserve(nodes.size() + nodes.size() / 4);
+
+    for (int k = 0; k < (int) nodes.size(); k++) {
+        const LoadedNode &node = nodes[k];
+        NetlistNode netlistNode;
+        netlistNode.id = node.id;
+        netlistNode.name.assign(node.name, node.nameLength);
+        netlistNode.nodeType = this->nodeTypes[node.type];
+        netlistNode.isPrimaryInput = (ISCAS85_NODE_TYPE_INPUT == netlistNode.nodeType);
+        netlistNode.placement.isPlaced = false;
+
+        auto inserted = this->emplace(node.id, std::move(netlistNode));
+        if (!inserted.second) {
+            std::cerr << "ISCAS85 Parser: Node " << node.id << " declared twice, keeping the first" << std::endl;
+        } else {
+            nodesById[node.id] = &inserted.first->second;
+            declarations[node.id] = k;
+        }
+    }
 
-        file.close();
+    // Link every node to its (branch eliminated) fanins
+    for (int k = 0; k < (int) nodes.size(); k++) {
+        const LoadedNode &node = nodes[k];
+        if (declarations[node.id] != k) {
+            continue;
+        }
+
+        NetlistNode *netlistNode = nodesById[node.id];
+        netlistNode->fanInList.reserve(node.numFanIn);
+        for (int i = node.firstFanIn; i < node.firstFanIn + node.numFanIn; i++) {
+            const int fanIn = (fanInIds[i] >= 0 && fanInIds[i] <= maxId) ? sources[fanInIds[i]] : -1;
+
+            if (fanIn < 0 || nodesById[fanIn] == nullptr) {
+                std::cerr << "ISCAS85 Parser: Node " << node.id << " has unknown fanin " << fanInIds[i] << std::endl;
+            } else {
+                netlistNode->fanInList.insert(fanIn);
+                nodesById[fanIn]->fanOutList.insert(node.id);
+            }
+        }
     }
 
-    return status;
+    // Add output "pads" for any cell that has a zero fanout, in file order
+    for (int k = 0; k < (int) nodes.size(); k++) {
+        const LoadedNode &node = nodes[k];
+        NetlistNode *netlistNode = nodesById[node.id];
+
+        if (declarations[node.id] == k && netlistNode->fanOutList.empty() && netlistNode->nodeType != NODE_TYPE_OUTPUT) {
+            NetlistNode outputNode;
+
+            outputNode.id = this->nextId++;
+
+            // Add a new output node (represents an I/O pad)
+            // and connect the cell to it
+            outputNode.isPrimaryOutput = true;
+            outputNode.fanInList.insert(node.id);
+            outputNode.name = std::to_string(outputNode.id) + "OUT";
+            outputNode.nodeType = NODE_TYPE_OUTPUT;
+            outputNode.placement.isPlaced = false;
+
+            netlistNode->fanOutList.insert(outputNode.id);
+
+            this->emplace(outputNode.id, std::move(outputNode));
+        }
+    }
 }
 
 bool Netlist::loadPlacementKiaPad(const std::string &filePrefix) {
@@ -176,7 +297,10 @@ bool Netlist::saveHypergraphFile(const std::string &outputFilename, bool genPadF
 
     // Assign "hyperId" to each node
     // Removes gaps in the id space, parser may not work without it
-    this->consolidateIds();
+    std::vector<int> gateCells;
+    std::set<int, std::greater<int>> inPadCells;
+    std::set<int, std::greater<int>> outPadCells;
+    this->orderHypergraphNodes(gateCells, inPadCells, outPadCells);
 
     if (!outFile.is_open() || !areaFile.is_open()) {
         std::cerr << "Error opening output file: " << outputFilename << std::endl;
@@ -185,21 +309,8 @@ bool Netlist::saveHypergraphFile(const std::string &outputFilename, bool genPadF
         int totalEndpoints = 0;
         int totalCells = this->size();
         std::unordered_set<int> uniqueHyperedges;
-        std::unordered_set<int> gateCells;
-        std::set<int, std::greater<int>> inPadCells;
-        std::set<int, std::greater<int>> outPadCells;
-        
-        for (const auto &pair : *this) {
-            std::cout << "Node " << pair.first << "type: " << pair.second.nodeType << std::endl;
-
-            if (!pair.second.isPrimaryInput && !pair.second.isPrimaryOutput) {
-                gateCells.insert(pair.first);
-            } else if (pair.second.isPrimaryInput) {
-                inPadCells.insert(pair.first);
-            } else {
-                outPadCells.insert(pair.first);
-            }
 
+        for (const auto &pair : *this) {
             if (!pair.second.fanOutList.empty()) {
                 totalEndpoints += pair.second.fanOutList.size() + 1;
                 uniqueHyperedges.insert(pair.first);
@@ -235,6 +346,70 @@ bool Netlist::saveHypergraphFile(const std::string &outputFilename, bool genPadF
     return status;
 }
 
+void Netlist::buildHypergraph(PA3Placement::Hypergraph &hypergraph) {
+    std::vector<int> gateCells;
+    std::set<int, std::greater<int>> inPadCells;
+    std::set<int, std::greater<int>> outPadCells;
+    this->orderHypergraphNodes(gateCells, inPadCells, outPadCells);
+
+    // Node ID --> cell number in the hypergraph
+    std::unordered_map<int, int> cellNumbers;
+    std::vector<int> cellOrder(gateCells);
+    cellOrder.insert(cellOrder.end(), inPadCells.begin(), inPadCells.end());
+    cellOrder.insert(cellOrder.end(), outPadCells.begin(), outPadCells.end());
+    cellNumbers.reserve(cellOrder.size());
+    for (int i = 0; i < (int) cellOrder.size(); i++) {
+        cellNumbers[cellOrder[i]] = i;
+    }
+
+    hypergraph.numCellsAndPads = cellOrder.size();
+    hypergraph.numCells_noPads = gateCells.size();
+    hypergraph.vertexSize.assign(hypergraph.numCellsAndPads, 0);
+    std::fill(hypergraph.vertexSize.begin(), hypergraph.vertexSize.begin() + hypergraph.numCells_noPads, DEFAULT_CELL_AREA);
+    hypergraph.nodeNameToNodeNum_map.clear();
+
+    // Every node with a fanout drives one (hyper)edge: the node itself followed by its fanout
+    hypergraph.cellPinArray.clear();
+    hypergraph.hEdge_idxToFirstEntryInPinArray.clear();
+    hypergraph.hyperwts.clear();
+    for (const int id : cellOrder) {
+        const NetlistNode &node = this->at(id);
+
+        if (!node.fanOutList.empty()) {
+            hypergraph.hEdge_idxToFirstEntryInPinArray.push_back(hypergraph.cellPinArray.size());
+            hypergraph.hyperwts.push_back(1);
+            hypergraph.cellPinArray.push_back(cellNumbers.at(id));
+
+            for (const int fanoutNode : node.fanOutList) {
+                hypergraph.cellPinArray.push_back(cellNumbers.at(fanoutNode));
+            }
+        }
+    }
+    hypergraph.numhyper = hypergraph.hyperwts.size();
+    hypergraph.numCellPins = hypergraph.cellPinArray.size();
+    hypergraph.hEdge_idxToFirstEntryInPinArray.push_back(hypergraph.numCellPins);
+
+    // Same pad locations as generatePadFile: inputs along the bottom, outputs along the top
+    hypergraph.pinLocations.clear();
+    hypergraph.pinLocations.reserve(inPadCells.size() + outPadCells.size());
+    for (int x = 0; x < (int) inPadCells.size(); x++) {
+        hypergraph.pinLocations.push_back({x, 1});
+    }
+    for (int x = 0; x < (int) outPadCells.size(); x++) {
+        hypergraph.pinLocations.push_back({x, DEFAULT_CHIP_HEIGHT});
+    }
+}
+
+void Netlist::applyPlacement(const std::vector<std::pair<double, double>> &cellLocations) {
+    for (const auto &[hypergraphId, id] : this->hyperIdMappings) {
+        if (hypergraphId < (int) cellLocations.size()) {
+            NetlistNode &node = this->at(id);
+            node.placement.isPlaced = true;
+            node.placement.p = Point(cellLocations[hypergraphId].first, cellLocations[hypergraphId].second);
+        }
+    }
+}
+
 int Netlist::levelsBetween(int startId, int endId) {
     int levels = -1;
 
@@ -296,7 +471,8 @@ void Netlist::hypergraphWriteNode(const NetlistNode &node, std::ostream &areaFil
         graphFile << prefix << node.hypergraphId << " s 1\n";
 
         for (int fanoutNode : node.fanOutList) {
-            std::string fanoutPrefix = (this->at(fanoutNode).isPrimaryInput) ? "p" : "a";
+            const NetlistNode &fanout = this->at(fanoutNode);
+            std::string fanoutPrefix = (fanout.isPrimaryInput || fanout.isPrimaryOutput) ? "p" : "a";
             graphFile << fanoutPrefix << this->at(fanoutNode).hypergraphId << " l\n";
         }
     }
@@ -338,63 +514,22 @@ bool Netlist::generatePadFile(const std::string &outFilePrefix,
     return success;
 }
 
-void Netlist::eliminateFanoutBranches(void) {
-    unordered_set<int> fanoutBranches;
-
-    for (const auto &pair : *this) {
-        const NetlistNode &node = pair.second;
-
-        if (ISCAS85_NODE_TYPE_FANOUT_BRANCH == node.nodeType) {
-            // Eliminate this node 
-            fanoutBranches.insert(pair.first);
-
-            // Fanout branches have a fanin and fanout of 1, so set is only 1 element
-            int fanInNode = *(node.fanInList.begin());
-            int fanOutNode = *(node.fanOutList.begin());
-
-            // Manipulate fanin, fanout lists of these two nodes to link them together
-
-            // Disconnect us from fanInNode's fanOut list
-            this->at(fanInNode).fanOutList.erase(node.id);
-            this->at(fanInNode).fanOutList.insert(fanOutNode);
-
-            // Disconnect us from fanOutNode's fanIn list
-            this->at(fanOutNode).fanInList.erase(node.id);
-            this->at(fanOutNode).fanInList.insert(fanInNode);
-        }
-    }
-
-    for (const auto &it : fanoutBranches) {
-        this->erase(it);
-    }
-}
-
-void Netlist::addOutputs(void) {
-    stringstream outputNodeName;
-
-    // First eliminate fanout branches
-    this->eliminateFanoutBranches();
-
-    // Iterate and find nodes with zero fanOut
-    for (auto &pair : *this) {
-        if (pair.second.fanOutList.empty() && pair.second.nodeType != NODE_TYPE_OUTPUT) {
-            NetlistNode outputNode;
-
-            outputNode.id = this->nextId++;
-
-            outputNodeName.clear();
-            outputNodeName << outputNode.id << "OUT";
-
-            // Add a new output node (represents an I/O pad)
-            // and connect the cell to it
-            outputNode.isPrimaryOutput = true;
-            outputNode.fanInList.insert(pair.first);
-            outputNode.name = outputNodeName.str();
-            outputNode.nodeType = NODE_TYPE_OUTPUT;
+void Netlist::orderHypergraphNodes(std::vector<int> &gateCells,
+                                   std::set<int, std::greater<int>> &inPads,
+                                   std::set<int, std::greater<int>> &outPads) {
+    this->consolidateIds();
 
-            pair.second.fanOutList.insert(outputNode.id);
+    gateCells.assign(this->hyperIdMappings.size(), 0);
+    inPads.clear();
+    outPads.clear();
 
-            (*this)[outputNode.id] = outputNode;
+    for (const auto &pair : *this) {
+        if (pair.second.isPrimaryInput) {
+            inPads.insert(pair.first);
+        } else if (pair.second.isPrimaryOutput) {
+            outPads.insert(pair.first);
+        } else {
+            gateCells[pair.second.hypergraphId] = pair.first;
         }
     }
 }
@@ -403,6 +538,7 @@ void Netlist::consolidateIds(void) {
     int moveableCellCounter = 0;
     int padCounter = 1;
 
+    this->hyperIdMappings.clear();
     for (auto &pair : *this) {
         if (pair.second.isPrimaryInput || pair.second.isPrimaryOutput) {
             pair.second.hypergraphId = padCounter++;
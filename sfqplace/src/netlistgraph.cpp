@@ -0,0 +1,99 @@
+#include "netlistgraph.hpp"
+
+#include <algorithm>
+
+static const std::unordered_set<int>& getFanInList(const NetlistNode &node) {
+    return node.fanInList;
+}
+
+static const std::unordered_set<int>& getFanOutList(const NetlistNode &node) {
+    return node.fanOutList;
+}
+
+static NodeType classifyNode(const NetlistNode &node) {
+    if (node.isPrimaryInput) {
+        return NodeType::INPUT;
+    } else if (node.isPrimaryOutput) {
+        return NodeType::OUTPUT;
+    } else if (ISCAS85_NODE_TYPE_FANOUT_BRANCH == node.nodeType) {
+        return NodeType::FANOUT_BRANCH;
+    }
+
+    return NodeType::GATE;
+}
+
+NetlistGraph::NetlistGraph(const Netlist &netlist) {
+    int maxId = -1;
+
+    this->ids.reserve(netlist.size());
+    for (const auto &pair : netlist) {
+        this->ids.push_back(pair.first);
+        maxId = std::max(maxId, pair.first);
+    }
+    std::sort(this->ids.begin(), this->ids.end());
+
+    this->indices.assign(maxId + 1, -1);
+    for (int i = 0; i < (int) this->ids.size(); i++) {
+        this->indices[this->ids[i]] = i;
+    }
+
+    const int count = this->ids.size();
+    this->types.resize(count);
+    this->placed.resize(count);
+    this->x.resize(count);
+    this->y.resize(count);
+
+    for (int i = 0; i < count; i++) {
+        const NetlistNode &node = netlist.at(this->ids[i]);
+
+        this->types[i] = classifyNode(node);
+        this->placed[i] = node.placement.isPlaced;
+        this->x[i] = this->placed[i] ? node.placement.p.x() : 0;
+        this->y[i] = this->placed[i] ? node.placement.p.y() : 0;
+    }
+
+    this->buildAdjacency(netlist, getFanInList, this->faninOffsets, this->fanins);
+    this->buildAdjacency(netlist, getFanOutList, this->fanoutOffsets, this->fanouts);
+}
+
+void NetlistGraph::buildAdjacency(const Netlist &netlist,
+                                  const std::unordered_set<int>& (*getList)(const NetlistNode &node),
+                                  std::vector<int> &offsets, std::vector<int> &targets) {
+    const int count = this->ids.size();
+
+    offsets.assign(count + 1, 0);
+    for (int i = 0; i < count; i++) {
+        offsets[i + 1] = offsets[i] + getList(netlist.at(this->ids[i])).size();
+    }
+
+    targets.resize(offsets[count]);
+    for (int i = 0; i < count; i++) {
+        int position = offsets[i];
+
+        // Connections to IDs without a node (not part of the netlist) are dropped
+        for (const int id : getList(netlist.at(this->ids[i]))) {
+            const int index = this->getIndex(id);
+            if (index >= 0) {
+                targets[position++] = index;
+            }
+        }
+
+        // Sorted lists make every traversal independent of the hash set order
+        std::sort(targets.begin() + offsets[i], targets.begin() + position);
+        std::fill(targets.begin() + position, targets.begin() + offsets[i + 1], -1);
+    }
+
+    // Compact away the slots of dropped connections
+    int position = 0;
+    for (int i = 0; i < count; i++) {
+        const int begin = offsets[i];
+        const int end = offsets[i + 1];
+
+        offsets[i] = position;
+        for (int k = begin; k < end && targets[k] >= 0; k++) {
+            targets[position++] = targets[k];
+        }
+    }
+    offsets[count] = position;
+    targets.resize(position);
+}
@@ -1,13 +1,15 @@
 #include "supercells.hpp"
 #include "partitioning.hpp"
+#include "placer.hpp"
 
 #include <unordered_map>
 
 static const int GROUP_SIZE_K = 4;
 
-SupercellsPlacer::SupercellsPlacer(Netlist *ogNet, std::unordered_map<int, Subgraph*> *subgraphs) {
+SupercellsPlacer::SupercellsPlacer(Netlist *ogNet, std::unordered_map<int, Subgraph*> *subgraphs, bool saveFiles) {
     this->originalNetlist = ogNet;
     this->subgraphs = subgraphs;
+    this->saveFiles = saveFiles;
 }
 
 void SupercellsPlacer::process() {
@@ -51,17 +53,25 @@ void SupercellsPlacer::process() {
     std::cout << "Creating supercell netlist" << std::endl;
     this->createSupercellNetlist();
 
-    // Write FastPlace-format input files for this supercell netlist
-    this->supercellNetlist.saveHypergraphFile("supercells", true);
+    if (this->saveFiles) {
+        // Write FastPlace-format input files for this supercell netlist
+        this->supercellNetlist.saveHypergraphFile("supercells", true);
+    }
+
+    // Place the supercells with FastPlace in this process
+    PA3Placement::Hypergraph hypergraph;
+    this->supercellNetlist.buildHypergraph(hypergraph);
 
-    // Invoke FastPlace 
-    // run khmetis via system call feeding it options and the temporary input file
-    // then read the output file partition data and return number of partitions
-    std::string cmd = "./PA3 supercells";
-    std::cout << "Running FastPlace with command: " << cmd << std::endl;
+    PA3Placement::PlacerSettings settings;
+    settings.saveFiles = this->saveFiles;
+    // As for the cell placement, only the spread locations are used
+    settings.legalization = PA3Placement::LegalizationMode::NONE;
+    settings.detailedPasses = 0;
+    PA3Placement::AnalyticPlacer placer(hypergraph, settings);
 
-    int ret = system(cmd.c_str());
-    std::cout << "FastPlace finished with code: " << ret << std::endl;
+    std::cout << "Running FastPlace on the supercell netlist" << std::endl;
+    placer.doPlacement("supercells");
+    this->supercellNetlist.applyPlacement(placer.getSpreadCellLocations());
 }
 
 void SupercellsPlacer::createSupercell(int id, Subgraph &subgraph) {